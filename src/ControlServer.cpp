@@ -0,0 +1,269 @@
+#include "ControlServer.h"
+
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <utility>
+
+#include "JobQueue.h"
+
+namespace {
+constexpr int kConnectTimeoutMs = 1000;
+constexpr int kReplyTimeoutMs = 5000;
+constexpr qint64 kMaxLineBytes = 64 * 1024;
+
+QJsonObject failure(const QString &message) {
+    return {{QStringLiteral("ok"), false}, {QStringLiteral("error"), message}};
+}
+
+QByteArray encodeLine(const QJsonObject &object) {
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+}
+
+ControlServer::ControlServer(JobQueue *queue, QObject *parent)
+    : QObject(parent),
+      queue(queue),
+      server(new QLocalServer(this)) {
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+    connect(queue, &JobQueue::jobProgress, this, [this](int id, const ProgressEvent &event) {
+        lastProgress.insert(id, event);
+    });
+    connect(queue, &JobQueue::jobFinished, this, [this](int id) { lastProgress.remove(id); });
+}
+
+QString ControlServer::serverName() {
+    const QByteArray home = QDir::homePath().toUtf8();
+    return QStringLiteral("yt-dlp-gui-") + QString::fromLatin1(QCryptographicHash::hash(home, QCryptographicHash::Sha1).toHex().left(12));
+}
+
+QList<QJsonObject> ControlServer::requestsFromArguments(const QStringList &arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Queue downloads in the running yt-dlp GUI, or start it."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("urls"), QStringLiteral("URLs to queue."), QStringLiteral("[urls...]"));
+    const QCommandLineOption formatOption({QStringLiteral("f"), QStringLiteral("format")}, QStringLiteral("yt-dlp format selector."),
+                                          QStringLiteral("selector"));
+    const QCommandLineOption audioOption({QStringLiteral("x"), QStringLiteral("audio-only")}, QStringLiteral("Download audio only."));
+    const QCommandLineOption audioFormatOption(QStringLiteral("audio-format"), QStringLiteral("Convert audio to this format."),
+                                               QStringLiteral("format"));
+    const QCommandLineOption outputOption({QStringLiteral("P"), QStringLiteral("output-dir")}, QStringLiteral("Output directory."),
+                                          QStringLiteral("dir"));
+    const QCommandLineOption priorityOption(QStringLiteral("priority"), QStringLiteral("low, normal or high."), QStringLiteral("priority"));
+    const QCommandLineOption listOption(QStringLiteral("list"), QStringLiteral("Print the running instance's jobs."));
+    const QCommandLineOption cancelOption(QStringLiteral("cancel"), QStringLiteral("Cancel a job by id."), QStringLiteral("id"));
+    parser.addOptions({formatOption, audioOption, audioFormatOption, outputOption, priorityOption, listOption, cancelOption});
+    parser.process(arguments);
+
+    QList<QJsonObject> requests;
+    for (const QString &url : parser.positionalArguments()) {
+        QJsonObject request{{QStringLiteral("cmd"), QStringLiteral("submit")}, {QStringLiteral("url"), url}};
+        if (parser.isSet(formatOption)) {
+            request.insert(QStringLiteral("format"), parser.value(formatOption));
+        }
+        if (parser.isSet(audioOption)) {
+            request.insert(QStringLiteral("audioOnly"), true);
+        }
+        if (parser.isSet(audioFormatOption)) {
+            request.insert(QStringLiteral("audioFormat"), parser.value(audioFormatOption));
+        }
+        if (parser.isSet(outputOption)) {
+            request.insert(QStringLiteral("outputDir"), QDir(parser.value(outputOption)).absolutePath());
+        }
+        if (parser.isSet(priorityOption)) {
+            request.insert(QStringLiteral("priority"), parser.value(priorityOption));
+        }
+        requests << request;
+    }
+    if (parser.isSet(cancelOption)) {
+        requests << QJsonObject{{QStringLiteral("cmd"), QStringLiteral("cancel")}, {QStringLiteral("id"), parser.value(cancelOption).toInt()}};
+    }
+    if (parser.isSet(listOption)) {
+        requests << QJsonObject{{QStringLiteral("cmd"), QStringLiteral("list")}};
+    }
+    return requests;
+}
+
+// The arguments are parsed only once a running instance answers; otherwise the caller starts the GUI and parses them itself.
+bool ControlServer::forward(const QStringList &arguments) {
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(kConnectTimeoutMs)) {
+        return false;
+    }
+
+    QList<QJsonObject> outgoing = requestsFromArguments(arguments);
+    if (outgoing.isEmpty()) {
+        outgoing << QJsonObject{{QStringLiteral("cmd"), QStringLiteral("show")}};
+    }
+    for (const QJsonObject &request : outgoing) {
+        socket.write(encodeLine(request));
+    }
+    socket.flush();
+
+    qsizetype replies = 0;
+    while (replies < outgoing.size()) {
+        if (!socket.canReadLine() && !socket.waitForReadyRead(kReplyTimeoutMs)) {
+            break;
+        }
+        while (socket.canReadLine()) {
+            const QByteArray line = socket.readLine();
+            std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+            ++replies;
+        }
+    }
+    std::fflush(stdout);
+    socket.disconnectFromServer();
+    return true;
+}
+
+bool ControlServer::listen() {
+    const QString name = serverName();
+    QString lockDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (lockDir.isEmpty()) {
+        lockDir = QDir::tempPath();
+    }
+    // Two instances starting together must not both decide the socket is stale and remove each other's.
+    QLockFile lock(QDir(lockDir).filePath(name + QStringLiteral(".lock")));
+    if (!lock.tryLock(kReplyTimeoutMs)) {
+        return false;
+    }
+    if (server->listen(name)) {
+        return true;
+    }
+    if (server->serverError() != QAbstractSocket::AddressInUseError) {
+        return false;
+    }
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(kConnectTimeoutMs)) {
+        probe.disconnectFromServer();
+        return false;
+    }
+    // Nobody answers on the name, so the socket is a leftover from a crash.
+    QLocalServer::removeServer(name);
+    return server->listen(name);
+}
+
+void ControlServer::setSubmitHandler(SubmitHandler handler) {
+    submitHandler = std::move(handler);
+}
+
+QJsonObject ControlServer::handleRequest(const QJsonObject &request) {
+    const QString cmd = request.value(QStringLiteral("cmd")).toString();
+    QJsonObject reply;
+
+    if (cmd == QStringLiteral("submit")) {
+        if (!submitHandler) {
+            return failure(QStringLiteral("submissions are not accepted"));
+        }
+        QString error;
+        const int id = submitHandler(request, &error);
+        if (id <= 0) {
+            return failure(error.isEmpty() ? QStringLiteral("submission rejected") : error);
+        }
+        reply.insert(QStringLiteral("id"), id);
+    } else if (cmd == QStringLiteral("list")) {
+        QJsonArray list;
+        for (int id : queue->jobIds()) {
+            if (const Job *job = queue->job(id)) {
+                list.append(describe(*job, false));
+            }
+        }
+        reply.insert(QStringLiteral("jobs"), list);
+    } else if (cmd == QStringLiteral("progress")) {
+        const Job *job = queue->job(request.value(QStringLiteral("id")).toInt());
+        if (!job) {
+            return failure(QStringLiteral("unknown job"));
+        }
+        reply.insert(QStringLiteral("job"), describe(*job, true));
+    } else if (cmd == QStringLiteral("cancel")) {
+        const int id = request.value(QStringLiteral("id")).toInt();
+        if (!queue->job(id)) {
+            return failure(QStringLiteral("unknown job"));
+        }
+        queue->cancel(id);
+    } else if (cmd == QStringLiteral("show")) {
+        emit activationRequested();
+    } else {
+        return failure(QStringLiteral("unknown command: %1").arg(cmd));
+    }
+
+    reply.insert(QStringLiteral("ok"), true);
+    return reply;
+}
+
+void ControlServer::onNewConnection() {
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    }
+}
+
+void ControlServer::onReadyRead(QLocalSocket *socket) {
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        QJsonObject reply;
+        if (!doc.isObject()) {
+            reply = failure(QStringLiteral("invalid JSON: %1").arg(error.errorString()));
+        } else {
+            const QJsonObject request = doc.object();
+            reply = handleRequest(request);
+            if (request.contains(QStringLiteral("tag"))) {
+                reply.insert(QStringLiteral("tag"), request.value(QStringLiteral("tag")));
+            }
+        }
+        socket->write(encodeLine(reply));
+    }
+    if (socket->bytesAvailable() > kMaxLineBytes) {
+        socket->write(encodeLine(failure(QStringLiteral("request too long"))));
+        socket->disconnectFromServer();
+    }
+}
+
+QJsonObject ControlServer::describe(const Job &job, bool withProgress) const {
+    QJsonObject object{
+        {QStringLiteral("id"), job.id},
+        {QStringLiteral("url"), job.spec.url},
+        {QStringLiteral("label"), job.spec.label},
+        {QStringLiteral("state"), jobStateName(job.state)},
+        {QStringLiteral("priority"), jobPriorityName(job.spec.priority)},
+        {QStringLiteral("percent"), job.percent},
+    };
+    if (!job.outputPath.isEmpty()) {
+        object.insert(QStringLiteral("output"), job.outputPath);
+    }
+    if (!withProgress) {
+        return object;
+    }
+    object.insert(QStringLiteral("attempt"), job.attempt);
+    if (job.failure != FailureKind::None) {
+        object.insert(QStringLiteral("failure"), failureKindName(job.failure));
+    }
+    const auto it = lastProgress.constFind(job.id);
+    if (it != lastProgress.constEnd()) {
+        if (it->bytesPerSecond >= 0.0) {
+            object.insert(QStringLiteral("bytesPerSecond"), it->bytesPerSecond);
+        }
+        if (it->fragmentCount > 0) {
+            object.insert(QStringLiteral("fragment"), it->fragment);
+            object.insert(QStringLiteral("fragmentCount"), it->fragmentCount);
+        }
+        object.insert(QStringLiteral("line"), it->line);
+    }
+    return object;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+#include "ProcessWorker.h"
+
+class JobQueue;
+class QLocalServer;
+class QLocalSocket;
+struct Job;
+
+class ControlServer : public QObject {
+    Q_OBJECT
+
+public:
+    using SubmitHandler = std::function<int(const QJsonObject &request, QString *error)>;
+
+    explicit ControlServer(JobQueue *queue, QObject *parent = nullptr);
+
+    static QString serverName();
+    static QList<QJsonObject> requestsFromArguments(const QStringList &arguments);
+    static bool forward(const QStringList &arguments);
+
+    bool listen();
+    void setSubmitHandler(SubmitHandler handler);
+    QJsonObject handleRequest(const QJsonObject &request);
+
+signals:
+    void activationRequested();
+
+private slots:
+    void onNewConnection();
+
+private:
+    void onReadyRead(QLocalSocket *socket);
+    QJsonObject describe(const Job &job, bool withProgress) const;
+
+    JobQueue *queue;
+    QLocalServer *server;
+    SubmitHandler submitHandler;
+    QHash<int, ProgressEvent> lastProgress;
+};
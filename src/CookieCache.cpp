@@ -0,0 +1,235 @@
+#include "CookieCache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcessEnvironment>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QTemporaryFile>
+
+namespace {
+const QByteArray kNetscapeHeader = QByteArrayLiteral("# Netscape HTTP Cookie File\n");
+const QFileDevice::Permissions kPrivateFile = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+const QFileDevice::Permissions kPrivateDir = QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner;
+const int kDefaultTtlMinutes = 60;
+
+QDateTime newestOf(const QDateTime &a, const QDateTime &b) {
+    if (!a.isValid()) {
+        return b;
+    }
+    return b.isValid() && b > a ? b : a;
+}
+
+// SQLite commits land in the -wal file first, so it changes before the main database does.
+QDateTime databaseModified(const QString &path) {
+    const QFileInfo main(path);
+    if (!main.exists()) {
+        return QDateTime();
+    }
+    const QFileInfo wal(path + QStringLiteral("-wal"));
+    return newestOf(main.lastModified(), wal.exists() ? wal.lastModified() : QDateTime());
+}
+}
+
+CookieCache::CookieCache()
+    : directory(QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath(QStringLiteral("cookies"))) {}
+
+QList<CookieStore> CookieCache::cookieStores() {
+    const QString sysname = QSysInfo::productType().toLower();
+    const QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    const QString home = QDir::homePath();
+    const QString local = env.value(QStringLiteral("LOCALAPPDATA"));
+    const QString appdata = env.value(QStringLiteral("APPDATA"));
+
+    auto resolvePath = [](const QString &base, const QString &suffix) -> QString {
+        if (base.isEmpty()) {
+            return QString();
+        }
+        return QDir(base).filePath(suffix);
+    };
+
+    if (sysname.contains(QStringLiteral("windows"))) {
+        return {
+            {QStringLiteral("chrome"),
+             {resolvePath(local, QStringLiteral("Google/Chrome/User Data/Default/Network/Cookies")),
+              resolvePath(local, QStringLiteral("Google/Chrome/User Data/Default/Cookies"))}},
+            {QStringLiteral("edge"),
+             {resolvePath(local, QStringLiteral("Microsoft/Edge/User Data/Default/Network/Cookies")),
+              resolvePath(local, QStringLiteral("Microsoft/Edge/User Data/Default/Cookies"))}},
+            {QStringLiteral("brave"),
+             {resolvePath(local, QStringLiteral("BraveSoftware/Brave-Browser/User Data/Default/Network/Cookies")),
+              resolvePath(local, QStringLiteral("BraveSoftware/Brave-Browser/User Data/Default/Cookies"))}},
+            {QStringLiteral("chromium"),
+             {resolvePath(local, QStringLiteral("Chromium/User Data/Default/Network/Cookies")),
+              resolvePath(local, QStringLiteral("Chromium/User Data/Default/Cookies"))}},
+            {QStringLiteral("opera"),
+             {resolvePath(appdata, QStringLiteral("Opera Software/Opera Stable/Network/Cookies")),
+              resolvePath(appdata, QStringLiteral("Opera Software/Opera Stable/Cookies"))}},
+            {QStringLiteral("firefox"),
+             {resolvePath(appdata, QStringLiteral("Mozilla/Firefox/Profiles"))}},
+        };
+    }
+    if (sysname.contains(QStringLiteral("osx")) || sysname.contains(QStringLiteral("macos"))) {
+        const QString appSup = QDir(home).filePath(QStringLiteral("Library/Application Support"));
+        return {
+            {QStringLiteral("safari"), {QDir(home).filePath(QStringLiteral("Library/Cookies/Cookies.binarycookies"))}},
+            {QStringLiteral("chrome"), {resolvePath(appSup, QStringLiteral("Google/Chrome/Default/Cookies"))}},
+            {QStringLiteral("brave"), {resolvePath(appSup, QStringLiteral("BraveSoftware/Brave-Browser/Default/Cookies"))}},
+            {QStringLiteral("edge"), {resolvePath(appSup, QStringLiteral("Microsoft Edge/Default/Cookies"))}},
+            {QStringLiteral("firefox"), {resolvePath(appSup, QStringLiteral("Firefox/Profiles"))}},
+            {QStringLiteral("chromium"), {resolvePath(appSup, QStringLiteral("Chromium/Default/Cookies"))}},
+            {QStringLiteral("opera"), {resolvePath(appSup, QStringLiteral("com.operasoftware.Opera/Cookies"))}},
+        };
+    }
+    const QString cfg = QDir(home).filePath(QStringLiteral(".config"));
+    return {
+        {QStringLiteral("chrome"), {resolvePath(cfg, QStringLiteral("google-chrome/Default/Cookies"))}},
+        {QStringLiteral("chromium"), {resolvePath(cfg, QStringLiteral("chromium/Default/Cookies"))}},
+        {QStringLiteral("brave"), {resolvePath(cfg, QStringLiteral("BraveSoftware/Brave-Browser/Default/Cookies"))}},
+        {QStringLiteral("edge"), {resolvePath(cfg, QStringLiteral("microsoft-edge/Default/Cookies"))}},
+        {QStringLiteral("firefox"), {QDir(home).filePath(QStringLiteral(".mozilla/firefox"))}},
+        {QStringLiteral("opera"), {resolvePath(cfg, QStringLiteral("opera/Cookies")), resolvePath(cfg, QStringLiteral("opera-stable/Cookies"))}},
+        {QStringLiteral("vivaldi"), {resolvePath(cfg, QStringLiteral("vivaldi/Default/Cookies"))}},
+    };
+}
+
+bool CookieCache::isEnabled() const {
+    return settings.value(QStringLiteral("cookies/cacheJar"), true).toBool();
+}
+
+std::optional<QString> CookieCache::freshJar(const QString &browser) const {
+    if (!isEnabled() || browser.isEmpty()) {
+        return std::nullopt;
+    }
+    const QString path = jarPath(browser);
+    if (!QFileInfo::exists(path)) {
+        return std::nullopt;
+    }
+
+    const int ttlMinutes = settings.value(QStringLiteral("cookies/cacheTtlMinutes"), kDefaultTtlMinutes).toInt();
+    const qint64 exportedAt = settings.value(settingsKey(browser, QStringLiteral("exportedAt")), 0).toLongLong();
+    const qint64 ageMs = QDateTime::currentMSecsSinceEpoch() - exportedAt;
+    if (exportedAt <= 0 || ageMs < 0 || ageMs > qint64(ttlMinutes) * 60 * 1000) {
+        return std::nullopt;
+    }
+
+    const qint64 recorded = settings.value(settingsKey(browser, QStringLiteral("sourceMtime")), 0).toLongLong();
+    const QDateTime current = sourceModified(browser);
+    if (!current.isValid() || current.toMSecsSinceEpoch() != recorded) {
+        return std::nullopt;
+    }
+    return path;
+}
+
+QString CookieCache::prepareExport(const QString &browser) {
+    if (!isEnabled() || browser.isEmpty() || !ensureDirectory()) {
+        return QString();
+    }
+    const QString path = exportPath(browser);
+    QFile file(path);
+    // Create the file owner-only before yt-dlp writes a single cookie into it.
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QString();
+    }
+    file.setPermissions(kPrivateFile);
+    file.write(kNetscapeHeader);
+    file.close();
+    // The source is stamped now: a browser write during extraction must invalidate this export.
+    settings.setValue(settingsKey(browser, QStringLiteral("pendingMtime")), sourceModified(browser).toMSecsSinceEpoch());
+    return path;
+}
+
+void CookieCache::commitExport(const QString &browser) {
+    const QString source = exportPath(browser);
+    if (!QFileInfo::exists(source)) {
+        return;
+    }
+    const QString target = jarPath(browser);
+    QFile::remove(target);
+    if (!QFile::rename(source, target)) {
+        QFile::remove(source);
+        return;
+    }
+    QFile::setPermissions(target, kPrivateFile);
+    settings.setValue(settingsKey(browser, QStringLiteral("exportedAt")), QDateTime::currentMSecsSinceEpoch());
+    settings.setValue(settingsKey(browser, QStringLiteral("sourceMtime")),
+                      settings.value(settingsKey(browser, QStringLiteral("pendingMtime"))));
+    settings.remove(settingsKey(browser, QStringLiteral("pendingMtime")));
+}
+
+void CookieCache::discardExport(const QString &browser) {
+    QFile::remove(exportPath(browser));
+    settings.remove(settingsKey(browser, QStringLiteral("pendingMtime")));
+}
+
+void CookieCache::invalidate(const QString &browser) {
+    QFile::remove(jarPath(browser));
+    settings.remove(QStringLiteral("cookies/cache/%1").arg(browser));
+}
+
+QString CookieCache::checkout(const QString &browser) {
+    const std::optional<QString> jar = freshJar(browser);
+    if (!jar || !ensureDirectory()) {
+        return QString();
+    }
+    QFile source(jar.value());
+    if (!source.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    // yt-dlp saves the jar back on exit, so concurrent jobs each get their own copy.
+    QTemporaryFile copy(QDir(directory).filePath(QStringLiteral("job-XXXXXX.txt")));
+    copy.setAutoRemove(false);
+    if (!copy.open()) {
+        return QString();
+    }
+    copy.setPermissions(kPrivateFile);
+    if (copy.write(source.readAll()) < 0) {
+        copy.remove();
+        return QString();
+    }
+    return copy.fileName();
+}
+
+QString CookieCache::jarPath(const QString &browser) const {
+    return QDir(directory).filePath(browser + QStringLiteral(".txt"));
+}
+
+QString CookieCache::exportPath(const QString &browser) const {
+    return QDir(directory).filePath(browser + QStringLiteral(".txt.new"));
+}
+
+QString CookieCache::settingsKey(const QString &browser, const QString &field) const {
+    return QStringLiteral("cookies/cache/%1/%2").arg(browser, field);
+}
+
+QDateTime CookieCache::sourceModified(const QString &browser) const {
+    QDateTime newest;
+    for (const CookieStore &store : cookieStores()) {
+        if (store.browser != browser) {
+            continue;
+        }
+        for (const QString &path : store.paths) {
+            if (path.isEmpty()) {
+                continue;
+            }
+            const QFileInfo info(path);
+            if (!info.isDir()) {
+                newest = newestOf(newest, databaseModified(path));
+                continue;
+            }
+            const QDir profiles(path);
+            for (const QString &profile : profiles.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+                newest = newestOf(newest, databaseModified(profiles.filePath(profile + QStringLiteral("/cookies.sqlite"))));
+            }
+        }
+    }
+    return newest;
+}
+
+bool CookieCache::ensureDirectory() const {
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
+    return QFile::setPermissions(directory, kPrivateDir);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <optional>
+
+#include <QDateTime>
+#include <QList>
+#include <QSettings>
+#include <QString>
+#include <QStringList>
+
+struct CookieStore {
+    QString browser;
+    QStringList paths;
+};
+
+class CookieCache {
+public:
+    CookieCache();
+
+    static QList<CookieStore> cookieStores();
+
+    bool isEnabled() const;
+    std::optional<QString> freshJar(const QString &browser) const;
+    QString prepareExport(const QString &browser);
+    void commitExport(const QString &browser);
+    void discardExport(const QString &browser);
+    void invalidate(const QString &browser);
+    QString checkout(const QString &browser);
+
+private:
+    QString jarPath(const QString &browser) const;
+    QString exportPath(const QString &browser) const;
+    QString settingsKey(const QString &browser, const QString &field) const;
+    QDateTime sourceModified(const QString &browser) const;
+    bool ensureDirectory() const;
+
+    QSettings settings;
+    QString directory;
+};
@@ -0,0 +1,302 @@
+#include "DedupStore.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStorageInfo>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef Q_OS_MACOS
+#include <sys/clonefile.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+constexpr int kHashThreads = 2;
+constexpr qint64 kHashChunkBytes = 1024 * 1024;
+const QString kTempSuffix = QStringLiteral(".dedup-tmp");
+
+QByteArray hashFile(const QString &path, const std::atomic_bool &stopping) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Blake2b_256);
+    QByteArray chunk(kHashChunkBytes, Qt::Uninitialized);
+    while (!stopping.load()) {
+        const qint64 read = file.read(chunk.data(), chunk.size());
+        if (read < 0) {
+            return QByteArray();
+        }
+        if (read == 0) {
+            return hash.result();
+        }
+        hash.addData(QByteArrayView(chunk.constData(), read));
+    }
+    return QByteArray();
+}
+
+bool sameInode(const QString &a, const QString &b) {
+#ifdef Q_OS_UNIX
+    struct stat sa;
+    struct stat sb;
+    if (::stat(QFile::encodeName(a).constData(), &sa) != 0 || ::stat(QFile::encodeName(b).constData(), &sb) != 0) {
+        return false;
+    }
+    return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#else
+    Q_UNUSED(a);
+    Q_UNUSED(b);
+    return false;
+#endif
+}
+
+bool cloneFile(const QString &source, const QString &target) {
+#if defined(Q_OS_LINUX)
+    const int in = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    const int out = ::open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+    const bool cloned = ::ioctl(out, FICLONE, in) == 0;
+    ::close(out);
+    ::close(in);
+    if (!cloned) {
+        ::unlink(QFile::encodeName(target).constData());
+    }
+    return cloned;
+#elif defined(Q_OS_MACOS)
+    return ::clonefile(QFile::encodeName(source).constData(), QFile::encodeName(target).constData(), 0) == 0;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(target);
+    return false;
+#endif
+}
+
+bool hardLink(const QString &source, const QString &target) {
+#if defined(Q_OS_UNIX)
+    return ::link(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+#elif defined(Q_OS_WIN)
+    return CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(target).utf16()),
+                           reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(source).utf16()), nullptr);
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(target);
+    return false;
+#endif
+}
+
+bool replaceFile(const QString &from, const QString &to) {
+#if defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(to).utf16()), MOVEFILE_REPLACE_EXISTING);
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+// Builds the link next to the duplicate and renames it over, so the duplicate is never missing.
+// A hardlink makes the two paths one file, so editing either changes both; it is only used when allowed.
+QString replaceWithLink(const QString &original, const QString &duplicate, bool allowHardlink) {
+    const QString temp = duplicate + kTempSuffix;
+    QFile::remove(temp);
+    QString method;
+    if (cloneFile(original, temp)) {
+        QFile::setPermissions(temp, QFile::permissions(duplicate));
+        method = QStringLiteral("reflink");
+    } else if (allowHardlink && hardLink(original, temp)) {
+        method = QStringLiteral("hardlink");
+    } else {
+        return QString();
+    }
+    if (!replaceFile(temp, duplicate)) {
+        QFile::remove(temp);
+        return QString();
+    }
+    return method;
+}
+}
+
+DedupStore::DedupStore(QObject *parent)
+    : QObject(parent),
+      stopping(false),
+      indexPath(QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath(QStringLiteral("dedup-index.tsv"))),
+      allowHardlinks(false),
+      pendingTasks(0),
+      runReclaimed(0),
+      runLinked(0) {
+    pool.setMaxThreadCount(kHashThreads);
+    pool.setObjectName(QStringLiteral("dedup-hash"));
+    load();
+}
+
+DedupStore::~DedupStore() {
+    stopping = true;
+    pool.waitForDone();
+}
+
+void DedupStore::setAllowHardlinks(bool allowed) {
+    allowHardlinks = allowed;
+}
+
+void DedupStore::add(const QString &path, int jobId) {
+    const QFileInfo info(path);
+    if (!info.isFile() || info.size() == 0) {
+        return;
+    }
+    const QString canonical = info.canonicalFilePath();
+    const qint64 size = info.size();
+
+    QList<Entry> &group = bySize[size];
+    group.removeIf([&](const Entry &entry) { return entry.path == canonical || !isCurrent(entry); });
+
+    QStringList toHash{canonical};
+    for (const Entry &entry : group) {
+        if (entry.hash.isEmpty()) {
+            toHash << entry.path;
+        }
+    }
+    const bool unique = group.isEmpty();
+    group.append(Entry{canonical, size, info.lastModified().toMSecsSinceEpoch(), QByteArray()});
+    if (unique) {
+        // Nothing else has this size, so there is nothing to compare against yet.
+        save();
+        return;
+    }
+
+    ++pendingTasks;
+    pool.start([this, jobId, canonical, size, toHash]() {
+        QHash<QString, QByteArray> hashes;
+        for (const QString &file : toHash) {
+            const QByteArray hash = hashFile(file, stopping);
+            if (stopping.load()) {
+                return;
+            }
+            if (!hash.isEmpty()) {
+                hashes.insert(file, hash);
+            }
+        }
+        QMetaObject::invokeMethod(this, [this, jobId, canonical, size, hashes]() {
+            onHashed(jobId, canonical, size, hashes);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DedupStore::onHashed(int jobId, const QString &path, qint64 size, const QHash<QString, QByteArray> &hashes) {
+    for (auto it = hashes.constBegin(); it != hashes.constEnd(); ++it) {
+        if (Entry *entry = find(size, it.key())) {
+            entry->hash = it.value();
+        }
+    }
+
+    Entry *added = find(size, path);
+    if (!added || added->hash.isEmpty() || !isCurrent(*added)) {
+        finishTask();
+        return;
+    }
+    const QByteArray device = QStorageInfo(path).device();
+    for (const Entry &entry : bySize.value(size)) {
+        if (entry.path == path || entry.hash != added->hash || !isCurrent(entry)) {
+            continue;
+        }
+        if (sameInode(entry.path, path)) {
+            break;
+        }
+        if (QStorageInfo(entry.path).device() != device) {
+            continue;
+        }
+        const QString method = replaceWithLink(entry.path, path, allowHardlinks);
+        if (method.isEmpty()) {
+            continue;
+        }
+        added->modifiedMs = QFileInfo(path).lastModified().toMSecsSinceEpoch();
+        runReclaimed += size;
+        ++runLinked;
+        emit deduplicated(jobId, path, entry.path, size, method);
+        break;
+    }
+    finishTask();
+}
+
+void DedupStore::finishTask() {
+    if (--pendingTasks > 0) {
+        return;
+    }
+    save();
+    emit runFinished(runReclaimed, runLinked);
+    runReclaimed = 0;
+    runLinked = 0;
+}
+
+bool DedupStore::isCurrent(const Entry &entry) const {
+    const QFileInfo info(entry.path);
+    return info.isFile() && info.size() == entry.size && info.lastModified().toMSecsSinceEpoch() == entry.modifiedMs;
+}
+
+DedupStore::Entry *DedupStore::find(qint64 size, const QString &path) {
+    const auto group = bySize.find(size);
+    if (group == bySize.end()) {
+        return nullptr;
+    }
+    for (Entry &entry : *group) {
+        if (entry.path == path) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void DedupStore::load() {
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QStringList parts = in.readLine().split(QLatin1Char('\t'));
+        if (parts.size() != 4) {
+            continue;
+        }
+        Entry entry{parts.at(3), parts.at(0).toLongLong(), parts.at(1).toLongLong(), QByteArray::fromHex(parts.at(2).toLatin1())};
+        if (entry.size > 0 && !entry.path.isEmpty()) {
+            bySize[entry.size].append(entry);
+        }
+    }
+}
+
+void DedupStore::save() const {
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return;
+    }
+    QTextStream out(&file);
+    for (const QList<Entry> &group : bySize) {
+        for (const Entry &entry : group) {
+            out << entry.size << '\t' << entry.modifiedMs << '\t' << QString::fromLatin1(entry.hash.toHex()) << '\t' << entry.path << '\n';
+        }
+    }
+    out.flush();
+    file.commit();
+}
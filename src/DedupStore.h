@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+class DedupStore : public QObject {
+    Q_OBJECT
+
+public:
+    explicit DedupStore(QObject *parent = nullptr);
+    ~DedupStore() override;
+
+    void setAllowHardlinks(bool allowed);
+    void add(const QString &path, int jobId);
+
+signals:
+    void deduplicated(int jobId, const QString &path, const QString &original, qint64 bytes, const QString &method);
+    void runFinished(qint64 bytesReclaimed, int filesLinked);
+
+private:
+    struct Entry {
+        QString path;
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+        QByteArray hash;
+    };
+
+    void load();
+    void save() const;
+    bool isCurrent(const Entry &entry) const;
+    Entry *find(qint64 size, const QString &path);
+    void onHashed(int jobId, const QString &path, qint64 size, const QHash<QString, QByteArray> &hashes);
+    void finishTask();
+
+    QThreadPool pool;
+    std::atomic_bool stopping;
+    QString indexPath;
+    bool allowHardlinks;
+    QHash<qint64, QList<Entry>> bySize;
+    int pendingTasks;
+    qint64 runReclaimed;
+    int runLinked;
+};
@@ -0,0 +1,237 @@
+#include "FormatModel.h"
+
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QStringBuilder>
+#include <QStringList>
+#include <QVariant>
+#include <algorithm>
+
+bool FormatRow::isVideo() const {
+    return (vcodec.isEmpty() ? QStringLiteral("none") : vcodec) != QStringLiteral("none") && height.value_or(0) > 0;
+}
+
+bool FormatRow::isAudio() const {
+    return (acodec.isEmpty() ? QStringLiteral("none") : acodec) != QStringLiteral("none") && height.value_or(0) == 0;
+}
+
+bool FormatRow::isProgressive() const {
+    const auto v = vcodec.isEmpty() ? QStringLiteral("none") : vcodec;
+    const auto a = acodec.isEmpty() ? QStringLiteral("none") : acodec;
+    return v != QStringLiteral("none") && a != QStringLiteral("none") && height.value_or(0) > 0;
+}
+
+QString FormatRow::videoLabel() const {
+    QStringList parts;
+    parts << fid;
+    if (height) {
+        parts << QString::number(height.value()) % QLatin1String("p");
+    }
+    if (!vcodec.isEmpty() && vcodec != QStringLiteral("none")) {
+        parts << vcodec;
+    }
+    if (fps) {
+        parts << QString::number(static_cast<int>(fps.value())) % QLatin1String("fps");
+    }
+    if (tbr) {
+        parts << QLatin1String("~") % QString::number(tbr.value(), 'f', 1) % QLatin1String(" Mb/s");
+    }
+    if (!ext.isEmpty()) {
+        parts << ext;
+    }
+    if (!formatNote.isEmpty()) {
+        parts << formatNote;
+    }
+    return parts.join(QLatin1String(" | "));
+}
+
+QString FormatRow::audioLabel() const {
+    QStringList parts;
+    parts << fid;
+    if (!acodec.isEmpty() && acodec != QStringLiteral("none")) {
+        parts << acodec;
+    }
+    if (tbr) {
+        double rate = tbr.value();
+        if (rate < 5.0) {
+            rate *= 1000.0;
+        }
+        parts << QLatin1String("~") % QString::number(static_cast<int>(rate)) % QLatin1String(" kb/s");
+    }
+    if (!ext.isEmpty()) {
+        parts << ext;
+    }
+    if (!formatNote.isEmpty()) {
+        parts << formatNote;
+    }
+    return parts.join(QLatin1String(" | "));
+}
+
+void FormatStore::clear() {
+    rows.clear();
+    videos.clear();
+    audios.clear();
+    pool.clear();
+}
+
+QString FormatStore::intern(const QString &value) {
+    if (value.isEmpty()) {
+        return QString();
+    }
+    const auto it = pool.constFind(value);
+    if (it != pool.constEnd()) {
+        return *it;
+    }
+    pool.insert(value);
+    return value;
+}
+
+void FormatStore::populate(const QJsonArray &formats) {
+    clear();
+    rows.reserve(formats.size());
+
+    const QString none = intern(QStringLiteral("none"));
+    for (const QJsonValue &value : formats) {
+        if (!value.isObject()) {
+            continue;
+        }
+        const QJsonObject f = value.toObject();
+
+        const QJsonValue idValue = f.value(QStringLiteral("format_id"));
+        const QString fid = idValue.isString() ? idValue.toString() : idValue.toVariant().toString();
+        if (fid.isEmpty()) {
+            continue;
+        }
+
+        FormatRow row;
+        row.fid = fid;
+        row.ext = intern(f.value(QStringLiteral("ext")).toString());
+        const QString vcodec = f.value(QStringLiteral("vcodec")).toString();
+        row.vcodec = vcodec.isEmpty() ? none : intern(vcodec);
+        const QString acodec = f.value(QStringLiteral("acodec")).toString();
+        row.acodec = acodec.isEmpty() ? none : intern(acodec);
+        const QJsonValue height = f.value(QStringLiteral("height"));
+        if (!height.isNull() && !height.isUndefined()) {
+            row.height = height.toInt();
+        }
+        const QJsonValue fps = f.value(QStringLiteral("fps"));
+        if (!fps.isNull() && !fps.isUndefined()) {
+            row.fps = fps.toDouble();
+        }
+        const QJsonValue tbr = f.value(QStringLiteral("tbr"));
+        if (!tbr.isNull() && !tbr.isUndefined()) {
+            row.tbr = tbr.toDouble();
+        }
+        row.formatNote = intern(f.value(QStringLiteral("format_note")).toString());
+        row.protocol = intern(f.value(QStringLiteral("protocol")).toString());
+        for (const QString &key : {QStringLiteral("filesize"), QStringLiteral("filesize_approx")}) {
+            const QJsonValue size = f.value(key);
+            if (size.isDouble() && size.toDouble() > 0.0) {
+                row.filesize = static_cast<qint64>(size.toDouble());
+                break;
+            }
+        }
+
+        const int index = static_cast<int>(rows.size());
+        if (row.isVideo()) {
+            videos.append(index);
+        } else if (row.isAudio()) {
+            audios.append(index);
+        }
+        rows.append(std::move(row));
+    }
+
+    std::sort(videos.begin(), videos.end(), [this](int ia, int ib) {
+        const FormatRow &a = rows.at(ia);
+        const FormatRow &b = rows.at(ib);
+        const int ah = a.height.value_or(0);
+        const int bh = b.height.value_or(0);
+        if (ah == bh) {
+            return a.tbr.value_or(0.0) > b.tbr.value_or(0.0);
+        }
+        return ah > bh;
+    });
+
+    std::sort(audios.begin(), audios.end(), [this](int ia, int ib) {
+        return rows.at(ia).tbr.value_or(0.0) > rows.at(ib).tbr.value_or(0.0);
+    });
+}
+
+int FormatStore::size() const {
+    return static_cast<int>(rows.size());
+}
+
+const FormatRow &FormatStore::at(int index) const {
+    return rows.at(index);
+}
+
+int FormatStore::indexOf(const QString &fid) const {
+    for (int i = 0; i < rows.size(); ++i) {
+        if (rows.at(i).fid == fid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const QList<int> &FormatStore::videoOrder() const {
+    return videos;
+}
+
+const QList<int> &FormatStore::audioOrder() const {
+    return audios;
+}
+
+FormatListModel::FormatListModel(const FormatStore &store, Kind kind, QObject *parent)
+    : QAbstractListModel(parent),
+      store(store),
+      kind(kind) {
+}
+
+const QList<int> &FormatListModel::order() const {
+    return kind == Kind::Video ? store.videoOrder() : store.audioOrder();
+}
+
+int FormatListModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return static_cast<int>(order().size());
+}
+
+QVariant FormatListModel::data(const QModelIndex &index, int role) const {
+    const FormatRow *row = index.isValid() ? rowAt(index.row()) : nullptr;
+    if (!row) {
+        return QVariant();
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        if (kind == Kind::Audio) {
+            return row->audioLabel();
+        }
+        return row->isProgressive() ? row->videoLabel() + QStringLiteral(" [with audio]") : row->videoLabel();
+    case Qt::UserRole:
+        return row->fid;
+    case StoreIndexRole:
+        return order().at(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+const FormatRow *FormatListModel::rowAt(int row) const {
+    const QList<int> &indices = order();
+    if (row < 0 || row >= indices.size()) {
+        return nullptr;
+    }
+    return &store.at(indices.at(row));
+}
+
+void FormatListModel::beginReload() {
+    beginResetModel();
+}
+
+void FormatListModel::endReload() {
+    endResetModel();
+}
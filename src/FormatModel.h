@@ -0,0 +1,72 @@
+#pragma once
+
+#include <optional>
+
+#include <QAbstractListModel>
+#include <QJsonArray>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+struct FormatRow {
+    QString fid;
+    QString ext;
+    QString vcodec;
+    QString acodec;
+    std::optional<int> height;
+    std::optional<double> fps;
+    std::optional<double> tbr;
+    QString formatNote;
+    QString protocol;
+    std::optional<qint64> filesize;
+
+    bool isVideo() const;
+    bool isAudio() const;
+    bool isProgressive() const;
+    QString videoLabel() const;
+    QString audioLabel() const;
+};
+
+class FormatStore {
+public:
+    void clear();
+    void populate(const QJsonArray &formats);
+
+    int size() const;
+    const FormatRow &at(int index) const;
+    int indexOf(const QString &fid) const;
+    const QList<int> &videoOrder() const;
+    const QList<int> &audioOrder() const;
+
+private:
+    QString intern(const QString &value);
+
+    QList<FormatRow> rows;
+    QList<int> videos;
+    QList<int> audios;
+    QSet<QString> pool;
+};
+
+class FormatListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum class Kind { Video, Audio };
+    enum Roles { StoreIndexRole = Qt::UserRole + 1 };
+
+    FormatListModel(const FormatStore &store, Kind kind, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    const FormatRow *rowAt(int row) const;
+    // Bracket every change to the shared store, so views never see its new rows under the old count.
+    void beginReload();
+    void endReload();
+
+private:
+    const QList<int> &order() const;
+
+    const FormatStore &store;
+    const Kind kind;
+};
@@ -0,0 +1,83 @@
+#include "FragmentTuner.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kMaxConcurrency = 32;
+constexpr double kSmoothing = 0.5;
+constexpr double kGainMargin = 0.1;
+}
+
+bool FragmentTuner::isFragmented(const QString &protocol) {
+    return !keyOf(protocol).isEmpty();
+}
+
+QString FragmentTuner::keyOf(const QString &protocol) {
+    const QString p = protocol.toLower();
+    if (p.contains(QStringLiteral("dash"))) {
+        return QStringLiteral("dash");
+    }
+    if (p.contains(QStringLiteral("m3u8"))) {
+        return QStringLiteral("hls");
+    }
+    if (p.contains(QStringLiteral("ism"))) {
+        return QStringLiteral("ism");
+    }
+    if (p.contains(QStringLiteral("f4m"))) {
+        return QStringLiteral("f4m");
+    }
+    return QString();
+}
+
+int FragmentTuner::defaultConcurrency(const QString &protocol) {
+    const QString key = keyOf(protocol);
+    if (key == QStringLiteral("dash")) {
+        return 8;
+    }
+    if (key == QStringLiteral("hls") || key == QStringLiteral("ism")) {
+        return 4;
+    }
+    if (key == QStringLiteral("f4m")) {
+        return 2;
+    }
+    return 1;
+}
+
+int FragmentTuner::concurrencyFor(const QString &protocol) const {
+    const auto it = entries.constFind(keyOf(protocol));
+    if (it == entries.constEnd()) {
+        return defaultConcurrency(protocol);
+    }
+    return it->current;
+}
+
+void FragmentTuner::record(const QString &protocol, int concurrency, double bytesPerSecond) {
+    const QString key = keyOf(protocol);
+    if (key.isEmpty() || concurrency <= 0 || bytesPerSecond <= 0.0) {
+        return;
+    }
+    Entry &entry = entries[key];
+    const auto known = entry.throughput.find(concurrency);
+    if (known == entry.throughput.end()) {
+        entry.throughput.insert(concurrency, bytesPerSecond);
+    } else {
+        *known += kSmoothing * (bytesPerSecond - *known);
+    }
+
+    double best = 0.0;
+    for (double value : std::as_const(entry.throughput)) {
+        best = std::max(best, value);
+    }
+    int chosen = entry.throughput.lastKey();
+    for (auto it = entry.throughput.cbegin(); it != entry.throughput.cend(); ++it) {
+        if (it.value() >= (1.0 - kGainMargin) * best) {
+            chosen = it.key();
+            break;
+        }
+    }
+    if (chosen == entry.throughput.lastKey() && chosen < kMaxConcurrency) {
+        chosen = std::min(chosen * 2, kMaxConcurrency);
+    }
+    entry.current = chosen;
+}
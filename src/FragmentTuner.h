@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+class FragmentTuner {
+public:
+    static bool isFragmented(const QString &protocol);
+    static int defaultConcurrency(const QString &protocol);
+
+    int concurrencyFor(const QString &protocol) const;
+    void record(const QString &protocol, int concurrency, double bytesPerSecond);
+
+private:
+    struct Entry {
+        int current = 1;
+        QMap<int, double> throughput;
+    };
+
+    static QString keyOf(const QString &protocol);
+
+    QHash<QString, Entry> entries;
+};
@@ -0,0 +1,1307 @@
+#include "JobQueue.h"
+
+#include <cmath>
+#include <limits>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QStorageInfo>
+#include <QUrl>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+constexpr int kSampleIntervalMs = 1000;
+constexpr double kUtilizationSmoothing = 0.3;
+const QString kStagingRoot = QStringLiteral(".yt-dlp-gui-staging");
+constexpr qint64 kDiskHeadroom = 256LL * 1024 * 1024;
+constexpr double kEstimateSlack = 1.05;
+constexpr int kErrorLinesKept = 20;
+constexpr int kMoveThreads = 2;
+const QSet<QString> kSecondLevelLabels = {QStringLiteral("co"), QStringLiteral("com"), QStringLiteral("net"), QStringLiteral("org"),
+                                          QStringLiteral("ac"), QStringLiteral("gov"), QStringLiteral("edu"), QStringLiteral("ne"),
+                                          QStringLiteral("or")};
+// Share of the job's progress bar reserved for work after the streams are fetched.
+constexpr double kMergeShare = 0.05;
+constexpr double kExtractAudioShare = 0.15;
+constexpr double kTranscodeShare = 0.5;
+constexpr double kChapterSplitShare = 0.1;
+
+double postShareOf(const JobSpec &spec) {
+    switch (spec.postKind) {
+    case PostKind::Transcode:
+        return kTranscodeShare;
+    case PostKind::ExtractAudio:
+        return kExtractAudioShare;
+    case PostKind::Copy:
+        break;
+    }
+    return spec.needsMerge || spec.post.enabled ? kMergeShare : 0.0;
+}
+
+bool ownsWorker(const Job &job, ProcessWorker *worker) {
+    return job.worker == worker || job.cutWorkers.contains(worker);
+}
+
+// Chapters weigh by length, so the bar moves evenly however the cuts are scheduled.
+double splitPercentOf(const Job &job) {
+    double done = 0.0;
+    double total = 0.0;
+    for (qsizetype i = 0; i < job.cutPercent.size() && i < job.spec.chapters.size(); ++i) {
+        const ChapterCut &cut = job.spec.chapters.at(i);
+        const double length = std::max(0.001, cut.end - cut.start);
+        done += length * job.cutPercent.at(i);
+        total += length;
+    }
+    return total > 0.0 ? done / total : 0.0;
+}
+
+const QString kAriaArgs = QStringLiteral(
+    "-x%1 -s%1 -k1M --summary-interval=1 --console-log-level=warn --show-console-readout=false --enable-color=false");
+}
+
+QString jobStateName(JobState state) {
+    switch (state) {
+    case JobState::Queued:
+        return QStringLiteral("queued");
+    case JobState::WaitingDisk:
+        return QStringLiteral("waiting for disk space");
+    case JobState::WaitingHost:
+        return QStringLiteral("host cooling down");
+    case JobState::RetryWait:
+        return QStringLiteral("retry scheduled");
+    case JobState::Downloading:
+        return QStringLiteral("downloading");
+    case JobState::Paused:
+        return QStringLiteral("paused");
+    case JobState::WaitingPost:
+        return QStringLiteral("waiting for post-processing");
+    case JobState::PostProcessing:
+        return QStringLiteral("post-processing");
+    case JobState::Moving:
+        return QStringLiteral("moving to output folder");
+    case JobState::Done:
+        return QStringLiteral("done");
+    case JobState::Failed:
+        return QStringLiteral("failed");
+    case JobState::Cancelled:
+        return QStringLiteral("cancelled");
+    }
+    return QString();
+}
+
+QString hostKeyOf(const QString &url) {
+    const QString host = QUrl(url).host().toLower();
+    QStringList labels = host.split(QLatin1Char('.'), Qt::SkipEmptyParts);
+    // IP addresses are keyed whole; no top-level domain is numeric.
+    bool numeric = false;
+    labels.value(labels.size() - 1).toInt(&numeric);
+    if (labels.size() <= 2 || numeric || host.contains(QLatin1Char(':'))) {
+        return host;
+    }
+    const bool countryCode = labels.last().size() == 2 && kSecondLevelLabels.contains(labels.at(labels.size() - 2));
+    const int keep = countryCode ? 3 : 2;
+    return labels.mid(labels.size() - keep).join(QLatin1Char('.'));
+}
+
+QString jobPriorityName(JobPriority priority) {
+    switch (priority) {
+    case JobPriority::Low:
+        return QStringLiteral("low");
+    case JobPriority::Normal:
+        return QStringLiteral("normal");
+    case JobPriority::High:
+        return QStringLiteral("high");
+    }
+    return QString();
+}
+
+JobQueue::JobQueue(QThread *ioThread, QObject *parent)
+    : QObject(parent),
+      ioThread(ioThread),
+      diskAware(true),
+      serveCounter(0),
+      maxRetries(4),
+      sampler(this),
+      lastSampleMs(0),
+      nextId(1) {
+    clock.start();
+    postStage.capacity = std::max(1, QThread::idealThreadCount());
+    movePool.setMaxThreadCount(kMoveThreads);
+    movePool.setObjectName(QStringLiteral("output-move"));
+    sampler.setInterval(kSampleIntervalMs);
+    connect(&sampler, &QTimer::timeout, this, &JobQueue::sampleUtilization);
+    sampler.start();
+}
+
+JobQueue::~JobQueue() {
+    movePool.waitForDone();
+    for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+        ProcessWorker *worker = it->worker;
+        if (worker) {
+            worker->disconnect(this);
+            QMetaObject::invokeMethod(worker, [worker]() { delete worker; }, Qt::BlockingQueuedConnection);
+            it->worker = nullptr;
+        }
+        for (auto cut = it->cutWorkers.constBegin(); cut != it->cutWorkers.constEnd(); ++cut) {
+            ProcessWorker *cutWorker = cut.key();
+            cutWorker->disconnect(this);
+            QMetaObject::invokeMethod(cutWorker, [cutWorker]() { delete cutWorker; }, Qt::BlockingQueuedConnection);
+            QFile::remove(it->cuts.at(cut.value()).tempOutput);
+        }
+        it->cutWorkers.clear();
+        if (!it->spec.cookieJar.isEmpty()) {
+            QFile::remove(it->spec.cookieJar);
+        }
+        if (!it->spec.infoJson.isEmpty()) {
+            QFile::remove(it->spec.infoJson);
+        }
+    }
+}
+
+int JobQueue::enqueue(const JobSpec &spec) {
+    Job job;
+    job.id = nextId++;
+    job.spec = spec;
+    job.host = hostKeyOf(spec.url);
+    resetProgress(job);
+    jobs.insert(job.id, job);
+    insertByPriority(downloadQueue, job.id);
+    emit jobAdded(job.id);
+    dispatch();
+    emit statsChanged();
+    return job.id;
+}
+
+void JobQueue::cancel(int id) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end()) {
+        return;
+    }
+    Job &job = *it;
+    switch (job.state) {
+    case JobState::Queued:
+    case JobState::WaitingDisk:
+    case JobState::WaitingHost:
+    case JobState::RetryWait:
+        downloadQueue.removeAll(id);
+        splitQueue.removeAll(id);
+        removeStaging(job);
+        finishJob(job, JobState::Cancelled);
+        break;
+    case JobState::WaitingPost:
+        postQueue.removeAll(id);
+        removeStaging(job);
+        finishJob(job, JobState::Cancelled);
+        break;
+    case JobState::Paused:
+        downloadQueue.removeAll(id);
+        if (!job.worker) {
+            removeStaging(job);
+            finishJob(job, JobState::Cancelled);
+            break;
+        }
+        Q_FALLTHROUGH();
+    case JobState::Downloading:
+    case JobState::PostProcessing:
+        job.cancelRequested = true;
+        if (job.worker) {
+            QMetaObject::invokeMethod(job.worker, &ProcessWorker::kill, Qt::QueuedConnection);
+        }
+        if (!job.pendingCuts.isEmpty()) {
+            postQueue.removeAll(id);
+            job.pendingCuts.clear();
+        }
+        for (ProcessWorker *worker : job.cutWorkers.keys()) {
+            QMetaObject::invokeMethod(worker, &ProcessWorker::kill, Qt::QueuedConnection);
+        }
+        break;
+    case JobState::Moving:
+        job.cancelRequested = true;
+        break;
+    default:
+        break;
+    }
+    emit statsChanged();
+}
+
+void JobQueue::pause(int id) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end() || splitQueue.contains(id)) {
+        return;
+    }
+    Job &job = *it;
+    switch (job.state) {
+    case JobState::Queued:
+    case JobState::WaitingDisk:
+    case JobState::WaitingHost:
+    case JobState::RetryWait:
+        downloadQueue.removeAll(id);
+        job.userPaused = true;
+        setState(job, JobState::Paused);
+        break;
+    case JobState::Paused:
+        downloadQueue.removeAll(id);
+        job.userPaused = true;
+        break;
+    case JobState::Downloading:
+        if (!job.cancelRequested && !job.restartRequested) {
+            job.userPaused = true;
+            suspendDownload(job);
+        }
+        break;
+    default:
+        break;
+    }
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::resume(int id) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end() || it->state != JobState::Paused || it->cancelRequested) {
+        return;
+    }
+    it->userPaused = false;
+    if (!it->worker && it->diskReserved.isEmpty()) {
+        setState(*it, JobState::Queued);
+    }
+    if (!downloadQueue.contains(id) && !it->restartRequested) {
+        insertByPriority(downloadQueue, id);
+    }
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::setPriority(int id, JobPriority priority) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end() || it->spec.priority == priority) {
+        return;
+    }
+    Job &job = *it;
+    job.spec.priority = priority;
+    if (downloadQueue.removeAll(id) > 0) {
+        insertByPriority(downloadQueue, id);
+    }
+    // Post-processing runs in the post class whatever the job's priority, so only a live download changes.
+    if (job.worker && (job.state == JobState::Downloading || job.state == JobState::Paused)) {
+        QMetaObject::invokeMethod(job.worker, [worker = job.worker, value = priorityFor(job, ProcessWorker::Mode::Download)]() {
+            worker->applyPriority(value);
+        }, Qt::QueuedConnection);
+    }
+    emit jobChanged(id);
+    dispatch();
+    emit statsChanged();
+}
+
+// Only finished jobs can go; anything else still has a worker, a timer or a queue entry pointing at it.
+bool JobQueue::remove(int id) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end()
+        || (it->state != JobState::Done && it->state != JobState::Failed && it->state != JobState::Cancelled)) {
+        return false;
+    }
+    jobs.erase(it);
+    return true;
+}
+
+void JobQueue::insertByPriority(QList<int> &queue, int id) {
+    const Job &job = jobs[id];
+    qsizetype pos = 0;
+    while (pos < queue.size()) {
+        const Job &other = jobs[queue.at(pos)];
+        if (other.spec.priority < job.spec.priority || (other.spec.priority == job.spec.priority && other.id > job.id)) {
+            break;
+        }
+        ++pos;
+    }
+    queue.insert(pos, id);
+}
+
+// A new yt-dlp run starts every stream's percentage over, so the folded model has to start over with it.
+void JobQueue::resetProgress(Job &job) {
+    const JobSpec &spec = job.spec;
+    job.progress = ProgressModel();
+    job.progress.plan(spec.streamBytes.isEmpty() ? QList<qint64>{spec.estimatedBytes} : spec.streamBytes, postShareOf(spec),
+                      spec.chapters.isEmpty() ? 0.0 : kChapterSplitShare);
+    job.percent = 0.0;
+}
+
+void JobQueue::suspendDownload(Job &job) {
+    if (!ProcessWorker::supportsSuspend()) {
+        job.restartRequested = true;
+        emit jobLog(job.id, {QStringLiteral("Stopping; the download resumes from its .part files later.")});
+        QMetaObject::invokeMethod(job.worker, &ProcessWorker::kill, Qt::QueuedConnection);
+        return;
+    }
+    QMetaObject::invokeMethod(job.worker, &ProcessWorker::suspend, Qt::QueuedConnection);
+    job.suspended = true;
+    vacateHost(job);
+    setActive(downloadStage, -1);
+    setState(job, JobState::Paused);
+}
+
+void JobQueue::resumeDownload(Job &job) {
+    QMetaObject::invokeMethod(job.worker, &ProcessWorker::resume, Qt::QueuedConnection);
+    job.suspended = false;
+    occupyHost(job);
+    setState(job, JobState::Downloading);
+    setActive(downloadStage, 1);
+}
+
+void JobQueue::cancelAll() {
+    const QList<int> ids = jobs.keys();
+    for (int id : ids) {
+        cancel(id);
+    }
+}
+
+void JobQueue::setMaxDownloads(int count) {
+    downloadStage.capacity = std::max(1, count);
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::setMaxPostProcesses(int count) {
+    postStage.capacity = std::max(1, count);
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::setMaxRetries(int count) {
+    maxRetries = std::max(0, count);
+}
+
+void JobQueue::setDefaultHostLimits(const HostLimits &limits) {
+    defaultHostLimits = limits;
+    dispatch();
+}
+
+void JobQueue::setHostLimits(const QString &host, const HostLimits &limits) {
+    hostLimits.insert(host.toLower(), limits);
+    dispatch();
+}
+
+void JobQueue::setProcessPriority(ProcessClass processClass, const ProcessPriority &priority) {
+    processPriorities[static_cast<std::size_t>(processClass)] = priority;
+}
+
+void JobQueue::setDiskAware(bool enabled) {
+    diskAware = enabled;
+    dispatch();
+    emit statsChanged();
+}
+
+const Job *JobQueue::job(int id) const {
+    const auto it = jobs.constFind(id);
+    return it == jobs.constEnd() ? nullptr : &it.value();
+}
+
+QList<int> JobQueue::jobIds() const {
+    QList<int> ids = jobs.keys();
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool JobQueue::hasActiveJobs() const {
+    if (downloadStage.active > 0 || postStage.active > 0 || !downloadQueue.isEmpty() || !postQueue.isEmpty()
+        || !splitQueue.isEmpty()) {
+        return true;
+    }
+    return std::any_of(jobs.cbegin(), jobs.cend(), [](const Job &job) {
+        return job.state == JobState::Paused || job.state == JobState::Moving;
+    });
+}
+
+void JobQueue::dispatch() {
+    QSet<int> skipped;
+    while (downloadStage.active < downloadStage.capacity) {
+        Job *job = nextDownload(skipped);
+        if (!job) {
+            break;
+        }
+        if (job->suspended) {
+            downloadQueue.removeAll(job->id);
+            resumeDownload(*job);
+            continue;
+        }
+        if (job->state == JobState::Paused) {
+            downloadQueue.removeAll(job->id);
+            startDownload(*job);
+            continue;
+        }
+        switch (admit(*job)) {
+        case Admission::Start:
+            downloadQueue.removeAll(job->id);
+            startDownload(*job);
+            break;
+        case Admission::Hold:
+            skipped.insert(job->id);
+            break;
+        case Admission::Reject:
+            downloadQueue.removeAll(job->id);
+            finishJob(*job, JobState::Failed);
+            break;
+        }
+    }
+    const QList<int> waitingSplits = splitQueue;
+    for (int id : waitingSplits) {
+        if (admitSplit(jobs[id])) {
+            splitQueue.removeAll(id);
+        }
+    }
+    while (postStage.active < postStage.capacity && !postQueue.isEmpty()) {
+        startPost(jobs[postQueue.takeFirst()]);
+    }
+    preempt();
+}
+
+Job *JobQueue::nextDownload(const QSet<int> &skipped) {
+    Job *pick = nullptr;
+    quint64 pickServed = 0;
+    for (int id : std::as_const(downloadQueue)) {
+        Job &job = jobs[id];
+        if (pick && job.spec.priority < pick->spec.priority) {
+            break;
+        }
+        if (skipped.contains(id) || hostBlocked(job) || !hostHasRoom(job)) {
+            continue;
+        }
+        const quint64 served = hostServedAt.value(job.host);
+        if (!pick || served < pickServed) {
+            pick = &job;
+            pickServed = served;
+        }
+    }
+    return pick;
+}
+
+JobQueue::HostLimits JobQueue::limitsFor(const QString &host) const {
+    return hostLimits.value(host, defaultHostLimits);
+}
+
+int JobQueue::plannedConnections(const Job &job) const {
+    if (job.worker && job.connections > 0) {
+        return job.connections;
+    }
+    if (job.spec.sectionSeconds > 0.0) {
+        return 1;
+    }
+    int connections = 1;
+    if (FragmentTuner::isFragmented(job.spec.protocol)) {
+        connections = job.spec.concurrentFragments > 0 ? job.spec.concurrentFragments : tuner.concurrencyFor(job.spec.protocol);
+    } else if (job.spec.ariaConnections > 0 && !job.spec.stream.enabled) {
+        connections = job.spec.ariaConnections;
+    }
+    return std::clamp(connections, 1, std::max(1, limitsFor(job.host).maxConnections));
+}
+
+bool JobQueue::hostHasRoom(const Job &job) const {
+    const HostUsage usage = hostUsage.value(job.host);
+    if (usage.jobs == 0) {
+        return true;
+    }
+    const HostLimits limits = limitsFor(job.host);
+    return usage.jobs < limits.maxJobs && usage.connections + plannedConnections(job) <= limits.maxConnections;
+}
+
+void JobQueue::occupyHost(Job &job) {
+    if (job.hostCharged) {
+        return;
+    }
+    HostUsage &usage = hostUsage[job.host];
+    ++usage.jobs;
+    usage.connections += job.connections;
+    job.hostCharged = true;
+    hostServedAt[job.host] = ++serveCounter;
+}
+
+void JobQueue::vacateHost(Job &job) {
+    if (!job.hostCharged) {
+        return;
+    }
+    HostUsage &usage = hostUsage[job.host];
+    usage.jobs = std::max(0, usage.jobs - 1);
+    usage.connections = std::max(0, usage.connections - job.connections);
+    if (usage.jobs == 0) {
+        hostUsage.remove(job.host);
+    }
+    job.hostCharged = false;
+}
+
+void JobQueue::preempt() {
+    const bool restartPending = std::any_of(jobs.cbegin(), jobs.cend(), [](const Job &job) {
+        return job.restartRequested && !job.userPaused;
+    });
+    if (restartPending) {
+        return;
+    }
+    while (!downloadQueue.isEmpty() && downloadStage.active >= downloadStage.capacity) {
+        Job &head = jobs[downloadQueue.first()];
+        if (hostBlocked(head) || !hostHasRoom(head)) {
+            return;
+        }
+        Job *victim = nullptr;
+        for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+            Job &candidate = *it;
+            if (candidate.state != JobState::Downloading || candidate.cancelRequested || candidate.restartRequested
+                || candidate.spec.priority >= head.spec.priority) {
+                continue;
+            }
+            if (!victim || candidate.spec.priority < victim->spec.priority
+                || (candidate.spec.priority == victim->spec.priority && candidate.id > victim->id)) {
+                victim = &candidate;
+            }
+        }
+        if (!victim) {
+            return;
+        }
+        if (!head.suspended && head.state != JobState::Paused) {
+            const Admission admission = admit(head);
+            if (admission == Admission::Hold) {
+                return;
+            }
+            if (admission == Admission::Reject) {
+                downloadQueue.removeFirst();
+                finishJob(head, JobState::Failed);
+                continue;
+            }
+        }
+        emit jobLog(victim->id, {QStringLiteral("Preempted by job %1 (%2 priority)").arg(head.id).arg(jobPriorityName(head.spec.priority))});
+        suspendDownload(*victim);
+        if (!ProcessWorker::supportsSuspend()) {
+            releaseDisk(head);
+            return;
+        }
+        insertByPriority(downloadQueue, victim->id);
+        downloadQueue.removeFirst();
+        if (head.suspended) {
+            resumeDownload(head);
+        } else {
+            startDownload(head);
+        }
+    }
+}
+
+bool JobQueue::hostBlocked(Job &job) {
+    const qint64 remaining = breaker.remainingMs(job.host, clock.elapsed());
+    if (remaining <= 0) {
+        if (job.state == JobState::WaitingHost) {
+            setState(job, JobState::Queued);
+        }
+        return false;
+    }
+    if (job.state != JobState::WaitingHost && !job.suspended) {
+        emit jobLog(job.id, {QStringLiteral("Holding: %1 is cooling down after repeated rate limiting (%2 s left)")
+                                 .arg(job.host)
+                                 .arg((remaining + 999) / 1000)});
+        setState(job, JobState::WaitingHost);
+    }
+    return true;
+}
+
+bool JobQueue::scheduleRetry(Job &job) {
+    job.failure = classifyFailure(job.exitCode, job.errorLines);
+    if (job.failure == FailureKind::Auth && retryWithBrowserCookies(job)) {
+        return true;
+    }
+    const qint64 now = clock.elapsed();
+    if (job.failure == FailureKind::RateLimited && breaker.recordRateLimit(job.host, now)) {
+        emit jobLog(job.id, {QStringLiteral("WARNING: pausing queued jobs for %1 for %2 s after repeated rate limiting")
+                                 .arg(job.host)
+                                 .arg(breaker.remainingMs(job.host, now) / 1000)});
+    }
+    if (retryFromUrl(job)) {
+        return true;
+    }
+    if (!isTransientFailure(job.failure) || job.attempt >= maxRetries) {
+        emit jobLog(job.id, {QStringLiteral("Failure: %1 (exit code %2)%3")
+                                 .arg(failureKindName(job.failure))
+                                 .arg(job.exitCode)
+                                 .arg(isTransientFailure(job.failure) ? QStringLiteral(", retries exhausted") : QString())});
+        return false;
+    }
+    const qint64 delay = retryDelayMs(job.failure, job.attempt);
+    ++job.attempt;
+    emit jobLog(job.id, {QStringLiteral("WARNING: %1; retry %2/%3 in %4 s")
+                             .arg(failureKindName(job.failure))
+                             .arg(job.attempt)
+                             .arg(maxRetries)
+                             .arg(static_cast<double>(delay) / 1000.0, 0, 'f', 1)});
+    releaseDisk(job);
+    resetProgress(job);
+    setState(job, JobState::RetryWait);
+    const int id = job.id;
+    QTimer::singleShot(static_cast<int>(std::min<qint64>(delay, std::numeric_limits<int>::max())), this, [this, id]() {
+        const auto it = jobs.find(id);
+        if (it == jobs.end() || it->state != JobState::RetryWait) {
+            return;
+        }
+        setState(*it, JobState::Queued);
+        insertByPriority(downloadQueue, id);
+        dispatch();
+        emit statsChanged();
+    });
+    return true;
+}
+
+bool JobQueue::retryWithBrowserCookies(Job &job) {
+    if (job.spec.cookieJar.isEmpty()) {
+        return false;
+    }
+    const qsizetype at = job.spec.args.indexOf(QStringLiteral("--cookies"));
+    if (at < 0 || at + 1 >= job.spec.args.size()) {
+        return false;
+    }
+    job.spec.args[at] = QStringLiteral("--cookies-from-browser");
+    job.spec.args[at + 1] = job.spec.cookieBrowser;
+    QFile::remove(job.spec.cookieJar);
+    job.spec.cookieJar.clear();
+    emit jobLog(job.id, {QStringLiteral("WARNING: cached cookies rejected; retrying with cookies from %1").arg(job.spec.cookieBrowser)});
+    emit cookieJarRejected(job.spec.cookieBrowser);
+    releaseDisk(job);
+    resetProgress(job);
+    setState(job, JobState::Queued);
+    insertByPriority(downloadQueue, job.id);
+    return true;
+}
+
+// Signed format URLs expire, which shows up as a 403/410 or an unrecognised error; those re-extract right away.
+// Rate limiting and throttling would only get worse from an immediate retry, so they take the normal backoff.
+bool JobQueue::retryFromUrl(Job &job) {
+    if (job.spec.infoJson.isEmpty() || job.attempt >= maxRetries) {
+        return false;
+    }
+    const QString text = job.errorLines.join(QLatin1Char('\n')).toLower();
+    const bool stale = job.failure == FailureKind::Unknown || text.contains(QStringLiteral("http error 403"))
+                       || text.contains(QStringLiteral("http error 410")) || text.contains(QStringLiteral("expired"));
+    if (!stale || job.failure == FailureKind::RateLimited) {
+        return false;
+    }
+    QFile::remove(job.spec.infoJson);
+    job.spec.infoJson.clear();
+    ++job.attempt;
+    emit jobLog(job.id, {QStringLiteral("WARNING: analyzed info could not be reused (%1); extracting %2 again (retry %3/%4)")
+                             .arg(failureKindName(job.failure), job.spec.url)
+                             .arg(job.attempt)
+                             .arg(maxRetries)});
+    releaseDisk(job);
+    resetProgress(job);
+    setState(job, JobState::Queued);
+    insertByPriority(downloadQueue, job.id);
+    return true;
+}
+
+QStringList JobQueue::sourceArgs(const Job &job) const {
+    if (job.spec.infoJson.isEmpty()) {
+        return {job.spec.url};
+    }
+    return {QStringLiteral("--load-info-json"), job.spec.infoJson};
+}
+
+QHash<QString, qint64> JobQueue::diskNeeds(const Job &job) const {
+    QHash<QString, qint64> needs;
+    if (job.spec.estimatedBytes <= 0) {
+        return needs;
+    }
+    const auto streams = static_cast<qint64>(static_cast<double>(job.spec.estimatedBytes) * kEstimateSlack);
+    const QString outputRoot = QStorageInfo(job.spec.outputDir).rootPath();
+    const QString workRoot = job.spec.scratchDir.isEmpty() || job.spec.stream.enabled ? outputRoot : QStorageInfo(job.spec.scratchDir).rootPath();
+    needs[workRoot] += job.spec.needsMerge ? streams * 2 : streams;
+    if (workRoot != outputRoot) {
+        needs[outputRoot] += streams;
+    }
+    return needs;
+}
+
+JobQueue::Admission JobQueue::admit(Job &job) {
+    if (!diskAware) {
+        return Admission::Start;
+    }
+    return reserveDisk(job, diskNeeds(job));
+}
+
+JobQueue::Admission JobQueue::reserveDisk(Job &job, const QHash<QString, qint64> &needs) {
+    const QLocale locale;
+    for (auto it = needs.cbegin(); it != needs.cend(); ++it) {
+        QStorageInfo volume(it.key());
+        if (!volume.isValid() || !volume.isReady()) {
+            continue;
+        }
+        if (it.value() + kDiskHeadroom > volume.bytesTotal()) {
+            emit jobLog(job.id, {QStringLiteral("ERROR: needs about %1 on %2, which only holds %3")
+                                     .arg(locale.formattedDataSize(it.value()), volume.rootPath(),
+                                          locale.formattedDataSize(volume.bytesTotal()))});
+            return Admission::Reject;
+        }
+        const qint64 available = volume.bytesAvailable() - reservedBytes.value(it.key()) - kDiskHeadroom;
+        if (it.value() > available) {
+            if (job.state != JobState::WaitingDisk) {
+                emit jobLog(job.id, {QStringLiteral("Waiting for disk space: needs about %1 on %2, %3 available")
+                                         .arg(locale.formattedDataSize(it.value()), volume.rootPath(),
+                                              locale.formattedDataSize(std::max<qint64>(0, available)))});
+                setState(job, JobState::WaitingDisk);
+            }
+            return Admission::Hold;
+        }
+    }
+    for (auto it = needs.cbegin(); it != needs.cend(); ++it) {
+        reservedBytes[it.key()] += it.value();
+    }
+    job.diskReserved = needs;
+    return Admission::Start;
+}
+
+void JobQueue::releaseDisk(Job &job) {
+    for (auto it = job.diskReserved.cbegin(); it != job.diskReserved.cend(); ++it) {
+        const qint64 left = reservedBytes.value(it.key()) - it.value();
+        if (left > 0) {
+            reservedBytes[it.key()] = left;
+        } else {
+            reservedBytes.remove(it.key());
+        }
+    }
+    job.diskReserved.clear();
+}
+
+ProcessPriority JobQueue::priorityFor(const Job &job, ProcessWorker::Mode mode) const {
+    ProcessClass processClass = ProcessClass::Normal;
+    if (mode == ProcessWorker::Mode::Ffmpeg) {
+        processClass = ProcessClass::Post;
+    } else if (job.spec.priority == JobPriority::High) {
+        processClass = ProcessClass::Foreground;
+    } else if (job.spec.priority == JobPriority::Low) {
+        processClass = ProcessClass::Background;
+    }
+    return processPriorities[static_cast<std::size_t>(processClass)];
+}
+
+ProcessWorker *JobQueue::spawn(const Job &job,
+                               ProcessWorker::Mode mode,
+                               const QString &program,
+                               const QStringList &args,
+                               double durationHint,
+                               const std::optional<SinkCommand> &sink) {
+    const int id = job.id;
+    auto *worker = new ProcessWorker(mode);
+    worker->setDurationHint(durationHint);
+    worker->setPriority(priorityFor(job, mode));
+    if (sink) {
+        worker->setSink(sink.value());
+    }
+    worker->moveToThread(ioThread);
+    connect(worker, &ProcessWorker::logLines, this, [this, id, worker](const QStringList &lines) {
+        const auto it = jobs.find(id);
+        if (it == jobs.end() || !ownsWorker(*it, worker)) {
+            return;
+        }
+        for (const QString &line : lines) {
+            if (line.startsWith(QStringLiteral("ERROR"), Qt::CaseInsensitive)) {
+                it->errorLines.append(line);
+            }
+        }
+        if (it->errorLines.size() > kErrorLinesKept) {
+            it->errorLines.remove(0, it->errorLines.size() - kErrorLinesKept);
+        }
+        emit jobLog(id, lines);
+    });
+    connect(worker, &ProcessWorker::progressAvailable, this, [this, id, worker]() {
+        const auto it = jobs.find(id);
+        if (it == jobs.end() || !ownsWorker(*it, worker)) {
+            return;
+        }
+        std::optional<ProgressEvent> event = worker->takeProgress();
+        if (event) {
+            const qint64 now = clock.elapsed();
+            if (event->bytesPerSecond > 0.0 && it->state == JobState::Downloading) {
+                it->speedSum += event->bytesPerSecond;
+                ++it->speedSamples;
+                it->progress.sampleSpeed(event->bytesPerSecond, now);
+            }
+            if (event->percent >= 0.0) {
+                if (const auto cut = it->cutWorkers.constFind(worker); cut != it->cutWorkers.constEnd()) {
+                    it->cutPercent[cut.value()] = event->percent;
+                    it->progress.splitProgress(splitPercentOf(*it), now);
+                } else if (it->state == JobState::PostProcessing) {
+                    it->progress.postProgress(event->percent, now);
+                } else {
+                    it->progress.streamProgress(event->stream, event->percent, now);
+                }
+                it->percent = it->progress.percent();
+                event->percent = it->percent;
+            }
+            if (it->progress.bytesPerSecond() > 0.0) {
+                event->bytesPerSecond = it->progress.bytesPerSecond();
+            }
+            event->etaSeconds = it->progress.etaSeconds();
+            emit jobProgress(id, event.value());
+        }
+    });
+    connect(worker, &ProcessWorker::phaseChanged, this, [this, id, worker](ProcessWorker::Phase phase) {
+        const auto it = jobs.find(id);
+        if (it == jobs.end() || !ownsWorker(*it, worker)) {
+            return;
+        }
+        if (phase == ProcessWorker::Phase::Merging || phase == ProcessWorker::Phase::PostProcessing) {
+            it->progress.postProgress(0.0, clock.elapsed());
+            it->percent = it->progress.percent();
+            emit jobProgress(id, ProgressEvent{it->percent, QString()});
+        }
+        emit jobPhase(id, phase);
+    });
+    connect(worker, &ProcessWorker::downloadFinished, this, [this, id, worker](int exitCode, QProcess::ExitStatus status) {
+        onWorkerFinished(id, worker, exitCode, status);
+    });
+    QMetaObject::invokeMethod(worker, [worker, program, args]() {
+        worker->start(program, args);
+    }, Qt::QueuedConnection);
+    return worker;
+}
+
+void JobQueue::startDownload(Job &job) {
+    QStringList args = job.spec.args;
+    const int connections = plannedConnections(job);
+    job.connections = connections;
+    // Section downloads are read by a single ffmpeg process, so fragment concurrency doesn't apply.
+    const bool fragmented = job.spec.sectionSeconds <= 0.0 && FragmentTuner::isFragmented(job.spec.protocol);
+    if (fragmented) {
+        job.fragmentConcurrency = connections;
+        args << QStringLiteral("--concurrent-fragments") << QString::number(job.fragmentConcurrency);
+        emit jobLog(job.id, {QStringLiteral("Fragmented stream (%1): %2 concurrent fragments%3")
+                                 .arg(job.spec.protocol)
+                                 .arg(job.fragmentConcurrency)
+                                 .arg(job.spec.concurrentFragments > 0 ? QString() : QStringLiteral(", auto-tuned"))});
+    }
+    if (job.spec.ariaConnections > 0 && !job.spec.stream.enabled) {
+        const int ariaConnections = fragmented ? std::min(job.spec.ariaConnections, limitsFor(job.host).maxConnections) : connections;
+        args << QStringLiteral("--external-downloader") << QStringLiteral("aria2c")
+             << QStringLiteral("--external-downloader-args") << kAriaArgs.arg(ariaConnections);
+        if (fragmented) {
+            args << QStringLiteral("--downloader") << QStringLiteral("dash,m3u8:native");
+        }
+    }
+    occupyHost(job);
+    if (job.spec.stream.enabled) {
+        job.postCommand = buildStreamCommand(job.spec.stream, job.spec.outputDir);
+        if (finishIfExists(job, job.postCommand.finalOutput)) {
+            vacateHost(job);
+            return;
+        }
+        QDir().mkpath(QFileInfo(job.postCommand.finalOutput).absolutePath());
+        args << QStringLiteral("-o") << QStringLiteral("-") << sourceArgs(job);
+        emit jobLog(job.id, {QStringLiteral("Streaming through ffmpeg: %1").arg(job.postCommand.description)});
+
+        job.errorLines.clear();
+        SinkCommand sink;
+        sink.program = QStringLiteral("ffmpeg");
+        sink.args = job.postCommand.args;
+        sink.expectedBytes = job.spec.estimatedBytes;
+        job.worker = spawn(job, ProcessWorker::Mode::Stream, QStringLiteral("yt-dlp"), args, 0.0, sink);
+        setState(job, JobState::Downloading);
+        setActive(downloadStage, 1);
+        return;
+    }
+    if (job.spec.post.enabled) {
+        if (job.stagingDir.isEmpty()) {
+            const QString workDir = job.spec.scratchDir.isEmpty() ? job.spec.outputDir : job.spec.scratchDir;
+            job.stagingDir = QDir(workDir).filePath(kStagingRoot + QLatin1Char('/')
+                                                    + QStringLiteral("job-%1-%2").arg(job.id).arg(QDateTime::currentMSecsSinceEpoch()));
+        }
+        QDir().mkpath(job.stagingDir);
+        args << QStringLiteral("-o") << QDir(job.stagingDir).filePath(stagingTemplate(job.spec.outputTemplate));
+    } else if (!job.spec.scratchDir.isEmpty()) {
+        args << QStringLiteral("-P") << QStringLiteral("home:") + job.spec.outputDir
+             << QStringLiteral("-P") << QStringLiteral("temp:") + job.spec.scratchDir
+             << QStringLiteral("-o") << job.spec.outputTemplate;
+    } else {
+        args << QStringLiteral("-o") << QDir(job.spec.outputDir).filePath(job.spec.outputTemplate);
+    }
+    args << sourceArgs(job);
+
+    job.errorLines.clear();
+    job.worker = spawn(job, ProcessWorker::Mode::Download, QStringLiteral("yt-dlp"), args, job.spec.sectionSeconds);
+    setState(job, JobState::Downloading);
+    setActive(downloadStage, 1);
+}
+
+void JobQueue::startPost(Job &job) {
+    if (!job.pendingCuts.isEmpty()) {
+        startCut(job);
+        return;
+    }
+    QString error;
+    const std::optional<PostCommand> command = buildMergeCommand(job.spec.post, job.stagingDir, job.spec.outputDir, &error);
+    if (!command) {
+        emit jobLog(job.id, {QStringLiteral("ERROR: %1").arg(error)});
+        finishJob(job, JobState::Failed);
+        return;
+    }
+    job.postCommand = command.value();
+
+    if (finishIfExists(job, job.postCommand.finalOutput)) {
+        return;
+    }
+
+    QDir().mkpath(QFileInfo(job.postCommand.tempOutput).absolutePath());
+    QDir().mkpath(QFileInfo(job.postCommand.finalOutput).absolutePath());
+    emit jobLog(job.id, {QStringLiteral("Post-processing: %1").arg(job.postCommand.description)});
+
+    job.progress.postProgress(0.0, clock.elapsed());
+    job.percent = job.progress.percent();
+    job.worker = spawn(job, ProcessWorker::Mode::Ffmpeg, QStringLiteral("ffmpeg"), job.postCommand.args, job.spec.post.durationSeconds);
+    setState(job, JobState::PostProcessing);
+    setActive(postStage, 1);
+}
+
+void JobQueue::onWorkerFinished(int id, ProcessWorker *worker, int exitCode, QProcess::ExitStatus status) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end() || !ownsWorker(*it, worker)) {
+        return;
+    }
+    Job &job = *it;
+    const bool ok = status == QProcess::NormalExit && exitCode == 0;
+    if (job.cutWorkers.contains(worker)) {
+        completeCut(job, worker, ok);
+        dispatch();
+        emit statsChanged();
+        return;
+    }
+    const bool wasPost = job.state == JobState::PostProcessing;
+    releaseWorker(job);
+    vacateHost(job);
+    if (!job.suspended) {
+        setActive(wasPost ? postStage : downloadStage, -1);
+    }
+    job.suspended = false;
+    job.exitCode = exitCode;
+
+    if (job.restartRequested && !job.cancelRequested) {
+        job.restartRequested = false;
+        resetProgress(job);
+        setState(job, JobState::Paused);
+        if (!job.userPaused) {
+            insertByPriority(downloadQueue, job.id);
+        }
+    } else if (job.cancelRequested) {
+        if (job.spec.stream.enabled) {
+            QFile::remove(job.postCommand.tempOutput);
+        }
+        removeStaging(job);
+        finishJob(job, JobState::Cancelled);
+    } else if (wasPost) {
+        completePost(job, ok);
+    } else if (!ok && scheduleRetry(job)) {
+        if (job.spec.stream.enabled) {
+            QFile::remove(job.postCommand.tempOutput);
+        }
+    } else if (job.spec.stream.enabled) {
+        completeStream(job, ok);
+    } else if (!ok) {
+        finishJob(job, JobState::Failed);
+    } else {
+        breaker.recordSuccess(job.host);
+        recordThroughput(job);
+        if (job.spec.post.enabled) {
+            setState(job, JobState::WaitingPost);
+            postQueue.append(job.id);
+        } else {
+            finishOutput(job);
+        }
+    }
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::recordThroughput(const Job &job) {
+    if (job.spec.concurrentFragments > 0 || job.fragmentConcurrency <= 0 || job.speedSamples == 0) {
+        return;
+    }
+    tuner.record(job.spec.protocol, job.fragmentConcurrency, job.speedSum / job.speedSamples);
+}
+
+bool JobQueue::finishIfExists(Job &job, const QString &path) {
+    if (!QFileInfo::exists(path)) {
+        return false;
+    }
+    emit jobLog(job.id, {QStringLiteral("%1 already exists; keeping the existing file.").arg(QDir::toNativeSeparators(path))});
+    job.outputPath = path;
+    removeStaging(job);
+    finishOutput(job);
+    return true;
+}
+
+void JobQueue::completeStream(Job &job, bool ok) {
+    if (!ok) {
+        QFile::remove(job.postCommand.tempOutput);
+        finishJob(job, JobState::Failed);
+        return;
+    }
+    breaker.recordSuccess(job.host);
+    recordThroughput(job);
+    moveOutput(job, job.postCommand.tempOutput, job.postCommand.finalOutput);
+}
+
+void JobQueue::completePost(Job &job, bool ok) {
+    if (!ok) {
+        emit jobLog(job.id, {QStringLiteral("ERROR: ffmpeg failed; streams kept in %1").arg(QDir::toNativeSeparators(job.stagingDir))});
+        finishJob(job, JobState::Failed);
+        return;
+    }
+    moveOutput(job, job.postCommand.tempOutput, job.postCommand.finalOutput);
+}
+
+// A rename across volumes turns into a full copy, so it runs off the GUI thread and the job finishes when it lands.
+void JobQueue::moveOutput(Job &job, const QString &from, const QString &to) {
+    setState(job, JobState::Moving);
+    const int id = job.id;
+    movePool.start([this, id, from, to]() {
+        const bool ok = QFile::rename(from, to);
+        QMetaObject::invokeMethod(this, [this, id, from, to, ok]() { onMoved(id, from, to, ok); }, Qt::QueuedConnection);
+    });
+}
+
+void JobQueue::onMoved(int id, const QString &from, const QString &to, bool ok) {
+    const auto it = jobs.find(id);
+    if (it == jobs.end() || it->state != JobState::Moving) {
+        return;
+    }
+    Job &job = *it;
+    if (job.cancelRequested) {
+        QFile::remove(ok ? to : from);
+        removeStaging(job);
+        finishJob(job, JobState::Cancelled);
+    } else if (!ok) {
+        emit jobLog(job.id, {QStringLiteral("ERROR: could not move %1 to %2").arg(QDir::toNativeSeparators(from), QDir::toNativeSeparators(to))});
+        finishJob(job, JobState::Failed);
+    } else {
+        job.outputPath = to;
+        removeStaging(job);
+        finishOutput(job);
+    }
+    dispatch();
+    emit statsChanged();
+}
+
+void JobQueue::finishOutput(Job &job) {
+    if (job.spec.chapters.isEmpty()) {
+        finishJob(job, JobState::Done);
+        return;
+    }
+    startChapterSplit(job);
+}
+
+// Every chapter is its own entry in the post queue, so the cuts spread over all ffmpeg slots.
+void JobQueue::startChapterSplit(Job &job) {
+    const QString source = job.outputPath.isEmpty() ? job.spec.predictedPath : job.outputPath;
+    if (source.isEmpty() || !QFileInfo::exists(source)) {
+        emit jobLog(job.id, {QStringLiteral("ERROR: downloaded file not found; chapters were not split")});
+        finishJob(job, JobState::Done);
+        return;
+    }
+    job.outputPath = source;
+    job.cuts = buildChapterCommands(source, job.spec.chapters, job.spec.outputDir);
+    job.cutPercent = QList<double>(job.cuts.size(), 0.0);
+    job.pendingCuts.clear();
+    job.cutsFailed = 0;
+    for (qsizetype i = 0; i < job.cuts.size(); ++i) {
+        if (QFileInfo::exists(job.cuts.at(i).finalOutput)) {
+            job.cutPercent[i] = 100.0;
+            continue;
+        }
+        job.pendingCuts.append(static_cast<int>(i));
+    }
+    if (job.pendingCuts.isEmpty()) {
+        emit jobLog(job.id, {QStringLiteral("All %1 chapter files already exist.").arg(job.cuts.size())});
+        finishJob(job, JobState::Done);
+        return;
+    }
+    // The download's reservation is on disk by now; what the cuts write comes on top of it.
+    releaseDisk(job);
+    if (!admitSplit(job)) {
+        splitQueue.append(job.id);
+    }
+}
+
+// The chapter files together are about as large as the source, so that much has to fit on the output volume.
+bool JobQueue::admitSplit(Job &job) {
+    if (diskAware) {
+        const QHash<QString, qint64> needs{{QStorageInfo(job.spec.outputDir).rootPath(), QFileInfo(job.outputPath).size()}};
+        const Admission admission = reserveDisk(job, needs);
+        if (admission == Admission::Hold) {
+            return false;
+        }
+        if (admission == Admission::Reject) {
+            job.pendingCuts.clear();
+            emit jobLog(job.id, {QStringLiteral("WARNING: chapters were not split; the full file is kept")});
+            finishJob(job, JobState::Done);
+            return true;
+        }
+    }
+    for (qsizetype i = 0; i < job.pendingCuts.size(); ++i) {
+        postQueue.append(job.id);
+    }
+    emit jobLog(job.id, {QStringLiteral("Splitting %1 chapters (stream copy, up to %2 at once)")
+                             .arg(job.pendingCuts.size())
+                             .arg(postStage.capacity)});
+    setState(job, JobState::WaitingPost);
+    return true;
+}
+
+void JobQueue::startCut(Job &job) {
+    const int index = job.pendingCuts.takeFirst();
+    const PostCommand &cut = job.cuts.at(index);
+    const ChapterCut &chapter = job.spec.chapters.at(index);
+    QDir().mkpath(QFileInfo(cut.finalOutput).absolutePath());
+    ProcessWorker *worker = spawn(job, ProcessWorker::Mode::Ffmpeg, QStringLiteral("ffmpeg"), cut.args, chapter.end - chapter.start);
+    job.cutWorkers.insert(worker, index);
+    if (job.state != JobState::PostProcessing) {
+        setState(job, JobState::PostProcessing);
+    }
+    setActive(postStage, 1);
+}
+
+void JobQueue::completeCut(Job &job, ProcessWorker *worker, bool ok) {
+    const int index = job.cutWorkers.take(worker);
+    worker->disconnect(this);
+    worker->deleteLater();
+    setActive(postStage, -1);
+
+    const PostCommand &cut = job.cuts.at(index);
+    if (job.cancelRequested) {
+        QFile::remove(cut.tempOutput);
+    } else if (ok && QFile::rename(cut.tempOutput, cut.finalOutput)) {
+        job.cutPercent[index] = 100.0;
+        job.progress.splitProgress(splitPercentOf(job), clock.elapsed());
+        job.percent = job.progress.percent();
+        emit jobLog(job.id, {QStringLiteral("Chapter %1/%2: %3").arg(index + 1).arg(job.cuts.size()).arg(QDir::toNativeSeparators(cut.finalOutput))});
+        emit jobProgress(job.id, ProgressEvent{job.percent, QString()});
+    } else {
+        QFile::remove(cut.tempOutput);
+        ++job.cutsFailed;
+        emit jobLog(job.id, {QStringLiteral("ERROR: ffmpeg failed on %1").arg(cut.description)});
+    }
+
+    if (!job.cutWorkers.isEmpty()) {
+        return;
+    }
+    if (job.cancelRequested) {
+        finishJob(job, JobState::Cancelled);
+    } else if (!job.pendingCuts.isEmpty()) {
+        setState(job, JobState::WaitingPost);
+    } else {
+        // The full download is intact, so missing chapters don't make the job a failure.
+        if (job.cutsFailed > 0) {
+            emit jobLog(job.id, {QStringLiteral("WARNING: %1 of %2 chapters failed").arg(job.cutsFailed).arg(job.cuts.size())});
+        }
+        finishJob(job, JobState::Done);
+    }
+}
+
+void JobQueue::removeStaging(Job &job) {
+    if (job.stagingDir.isEmpty()) {
+        return;
+    }
+    const QString root = QFileInfo(job.stagingDir).absolutePath();
+    QDir(job.stagingDir).removeRecursively();
+    QDir().rmdir(root);
+    job.stagingDir.clear();
+}
+
+void JobQueue::releaseWorker(Job &job) {
+    if (!job.worker) {
+        return;
+    }
+    job.worker->disconnect(this);
+    QMetaObject::invokeMethod(job.worker, &ProcessWorker::kill, Qt::QueuedConnection);
+    job.worker->deleteLater();
+    job.worker = nullptr;
+}
+
+void JobQueue::setState(Job &job, JobState state) {
+    job.state = state;
+    emit jobChanged(job.id);
+}
+
+void JobQueue::finishJob(Job &job, JobState state) {
+    if (state == JobState::Done) {
+        job.progress.finish();
+        job.percent = 100.0;
+        if (job.outputPath.isEmpty() && QFileInfo::exists(job.spec.predictedPath)) {
+            job.outputPath = job.spec.predictedPath;
+        }
+    }
+    releaseDisk(job);
+    if (!job.spec.cookieJar.isEmpty()) {
+        QFile::remove(job.spec.cookieJar);
+        job.spec.cookieJar.clear();
+    }
+    if (!job.spec.infoJson.isEmpty()) {
+        QFile::remove(job.spec.infoJson);
+        job.spec.infoJson.clear();
+    }
+    setState(job, state);
+    emit jobFinished(job.id, state);
+}
+
+void JobQueue::setActive(Stage &stage, int delta) {
+    const qint64 now = clock.elapsed();
+    stage.busyMs += stage.active * (now - stage.lastChangeMs);
+    stage.lastChangeMs = now;
+    stage.active = std::max(0, stage.active + delta);
+}
+
+void JobQueue::sampleUtilization() {
+    const qint64 now = clock.elapsed();
+    const qint64 window = std::max<qint64>(1, now - lastSampleMs);
+    lastSampleMs = now;
+    bool changed = false;
+    for (Stage *stage : {&downloadStage, &postStage}) {
+        setActive(*stage, 0);
+        const qint64 busy = stage->busyMs - stage->sampledBusyMs;
+        stage->sampledBusyMs = stage->busyMs;
+        const double instant = std::clamp(static_cast<double>(busy) / static_cast<double>(window * stage->capacity), 0.0, 1.0);
+        const double next = stage->utilization + kUtilizationSmoothing * (instant - stage->utilization);
+        changed = changed || std::abs(next - stage->utilization) > 0.005 || stage->active > 0;
+        stage->utilization = next < 0.001 ? 0.0 : next;
+    }
+    if (changed) {
+        emit statsChanged();
+    }
+    if (!downloadQueue.isEmpty() && downloadStage.active < downloadStage.capacity) {
+        dispatch();
+    }
+}
+
+JobQueue::StageStats JobQueue::statsFor(const Stage &stage, qsizetype queued) const {
+    StageStats stats;
+    stats.active = stage.active;
+    stats.queued = static_cast<int>(queued);
+    stats.capacity = stage.capacity;
+    stats.utilization = stage.utilization;
+    return stats;
+}
+
+JobQueue::StageStats JobQueue::downloadStats() const {
+    return statsFor(downloadStage, downloadQueue.size());
+}
+
+JobQueue::StageStats JobQueue::postStats() const {
+    return statsFor(postStage, postQueue.size());
+}
+
+QString JobQueue::statsText() const {
+    const StageStats dl = downloadStats();
+    const StageStats pp = postStats();
+    return QStringLiteral("Download %1/%2 · %3 queued · %4% busy   |   Post %5/%6 · %7 queued · %8% busy")
+        .arg(dl.active)
+        .arg(dl.capacity)
+        .arg(dl.queued)
+        .arg(qRound(dl.utilization * 100.0))
+        .arg(pp.active)
+        .arg(pp.capacity)
+        .arg(pp.queued)
+        .arg(qRound(pp.utilization * 100.0));
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <array>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "FragmentTuner.h"
+#include "PostProcess.h"
+#include "ProgressModel.h"
+#include "RetryPolicy.h"
+#include "ProcessWorker.h"
+
+class QThread;
+
+enum class JobState { Queued, WaitingDisk, WaitingHost, RetryWait, Downloading, Paused, WaitingPost, PostProcessing, Moving, Done, Failed, Cancelled };
+enum class JobPriority { Low, Normal, High };
+enum class PostKind { Copy, ExtractAudio, Transcode };
+
+QString jobStateName(JobState state);
+QString jobPriorityName(JobPriority priority);
+
+struct JobSpec {
+    QString url;
+    QString label;
+    JobPriority priority = JobPriority::Normal;
+    QStringList args;
+    QString outputDir;
+    QString outputTemplate;
+    QString predictedPath;
+    QString protocol;
+    double sectionSeconds = 0.0;
+    int concurrentFragments = 0;
+    int ariaConnections = 0;
+    QString scratchDir;
+    QString cookieJar;
+    QString cookieBrowser;
+    QString infoJson;
+    QString thumbnailUrl;
+    qint64 estimatedBytes = 0;
+    QList<qint64> streamBytes;
+    bool needsMerge = false;
+    PostKind postKind = PostKind::Copy;
+    PostPlan post;
+    StreamPlan stream;
+    QList<ChapterCut> chapters;
+};
+
+struct Job {
+    int id = 0;
+    JobSpec spec;
+    JobState state = JobState::Queued;
+    double percent = 0.0;
+    ProgressModel progress;
+    int exitCode = 0;
+    bool cancelRequested = false;
+    bool suspended = false;
+    bool userPaused = false;
+    bool restartRequested = false;
+    QString host;
+    int connections = 0;
+    bool hostCharged = false;
+    int attempt = 0;
+    FailureKind failure = FailureKind::None;
+    QStringList errorLines;
+    QString stagingDir;
+    PostCommand postCommand;
+    QList<PostCommand> cuts;
+    QList<int> pendingCuts;
+    QHash<ProcessWorker *, int> cutWorkers;
+    QList<double> cutPercent;
+    int cutsFailed = 0;
+    QString outputPath;
+    int fragmentConcurrency = 0;
+    double speedSum = 0.0;
+    int speedSamples = 0;
+    QHash<QString, qint64> diskReserved;
+    ProcessWorker *worker = nullptr;
+};
+
+QString hostKeyOf(const QString &url);
+
+class JobQueue : public QObject {
+    Q_OBJECT
+
+public:
+    enum class ProcessClass { Foreground, Normal, Background, Post };
+
+    struct HostLimits {
+        int maxJobs = 2;
+        int maxConnections = 16;
+    };
+
+    struct StageStats {
+        int active = 0;
+        int queued = 0;
+        int capacity = 1;
+        double utilization = 0.0;
+    };
+
+    explicit JobQueue(QThread *ioThread, QObject *parent = nullptr);
+    ~JobQueue() override;
+
+    int enqueue(const JobSpec &spec);
+    void cancel(int id);
+    void cancelAll();
+    void pause(int id);
+    void resume(int id);
+    void setPriority(int id, JobPriority priority);
+    bool remove(int id);
+    void setMaxDownloads(int count);
+    void setMaxPostProcesses(int count);
+    void setDiskAware(bool enabled);
+    void setMaxRetries(int count);
+    void setDefaultHostLimits(const HostLimits &limits);
+    void setHostLimits(const QString &host, const HostLimits &limits);
+    void setProcessPriority(ProcessClass processClass, const ProcessPriority &priority);
+
+    const Job *job(int id) const;
+    QList<int> jobIds() const;
+    bool hasActiveJobs() const;
+    StageStats downloadStats() const;
+    StageStats postStats() const;
+    QString statsText() const;
+
+signals:
+    void jobAdded(int id);
+    void jobChanged(int id);
+    void jobLog(int id, const QStringList &lines);
+    void jobProgress(int id, const ProgressEvent &event);
+    void jobPhase(int id, ProcessWorker::Phase phase);
+    void jobFinished(int id, JobState state);
+    void cookieJarRejected(const QString &browser);
+    void statsChanged();
+
+private:
+    struct Stage {
+        int capacity = 1;
+        int active = 0;
+        qint64 busyMs = 0;
+        qint64 lastChangeMs = 0;
+        qint64 sampledBusyMs = 0;
+        double utilization = 0.0;
+    };
+
+    enum class Admission { Start, Hold, Reject };
+
+    struct HostUsage {
+        int jobs = 0;
+        int connections = 0;
+    };
+
+    void dispatch();
+    Job *nextDownload(const QSet<int> &skipped);
+    HostLimits limitsFor(const QString &host) const;
+    int plannedConnections(const Job &job) const;
+    bool hostHasRoom(const Job &job) const;
+    void occupyHost(Job &job);
+    void vacateHost(Job &job);
+    void preempt();
+    void insertByPriority(QList<int> &queue, int id);
+    void resetProgress(Job &job);
+    bool hostBlocked(Job &job);
+    bool scheduleRetry(Job &job);
+    bool retryWithBrowserCookies(Job &job);
+    bool retryFromUrl(Job &job);
+    QStringList sourceArgs(const Job &job) const;
+    void suspendDownload(Job &job);
+    void resumeDownload(Job &job);
+    Admission admit(Job &job);
+    Admission reserveDisk(Job &job, const QHash<QString, qint64> &needs);
+    QHash<QString, qint64> diskNeeds(const Job &job) const;
+    void releaseDisk(Job &job);
+    void startDownload(Job &job);
+    void startPost(Job &job);
+    void onWorkerFinished(int id, ProcessWorker *worker, int exitCode, QProcess::ExitStatus status);
+    void completePost(Job &job, bool ok);
+    void completeStream(Job &job, bool ok);
+    void finishOutput(Job &job);
+    void startChapterSplit(Job &job);
+    bool admitSplit(Job &job);
+    void startCut(Job &job);
+    void completeCut(Job &job, ProcessWorker *worker, bool ok);
+    void moveOutput(Job &job, const QString &from, const QString &to);
+    void onMoved(int id, const QString &from, const QString &to, bool ok);
+    bool finishIfExists(Job &job, const QString &path);
+    void recordThroughput(const Job &job);
+    void finishJob(Job &job, JobState state);
+    void setState(Job &job, JobState state);
+    void releaseWorker(Job &job);
+    void removeStaging(Job &job);
+    ProcessPriority priorityFor(const Job &job, ProcessWorker::Mode mode) const;
+    ProcessWorker *spawn(const Job &job,
+                         ProcessWorker::Mode mode,
+                         const QString &program,
+                         const QStringList &args,
+                         double durationHint,
+                         const std::optional<SinkCommand> &sink = std::nullopt);
+    void setActive(Stage &stage, int delta);
+    void sampleUtilization();
+    StageStats statsFor(const Stage &stage, qsizetype queued) const;
+
+    QThread *ioThread;
+    QHash<int, Job> jobs;
+    QList<int> downloadQueue;
+    QList<int> postQueue;
+    QList<int> splitQueue;
+    Stage downloadStage;
+    Stage postStage;
+    FragmentTuner tuner;
+    QHash<QString, qint64> reservedBytes;
+    bool diskAware;
+    HostCircuitBreaker breaker;
+    HostLimits defaultHostLimits;
+    QHash<QString, HostLimits> hostLimits;
+    QHash<QString, HostUsage> hostUsage;
+    QHash<QString, quint64> hostServedAt;
+    quint64 serveCounter;
+    int maxRetries;
+    std::array<ProcessPriority, 4> processPriorities;
+    QElapsedTimer clock;
+    QThreadPool movePool;
+    QTimer sampler;
+    qint64 lastSampleMs;
+    int nextId;
+};
@@ -3,107 +3,168 @@
 #include <cmath>
 
 #include <QApplication>
+#include <QClipboard>
 #include <QByteArray>
+#include <QBuffer>
 #include <QCheckBox>
 #include <QComboBox>
+#include <QDateTime>
 #include <QDir>
+#include <QEvent>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QGridLayout>
 #include <QHBoxLayout>
+#include <QIcon>
+#include <QImageReader>
 #include <QJsonArray>
-#include <QJsonDocument>
 #include <QJsonObject>
-#include <QJsonParseError>
+#include <QItemSelectionModel>
 #include <QJsonValue>
 #include <QLabel>
 #include <QLineEdit>
+#include <QListView>
+#include <QLocale>
 #include <QMessageBox>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QPixmap>
 #include <QProcess>
-#include <QProcessEnvironment>
 #include <QProgressBar>
 #include <QPushButton>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QShortcut>
 #include <QSpinBox>
 #include <QStandardPaths>
-#include <QStringBuilder>
-#include <QTextEdit>
-#include <QTextCursor>
-#include <QSysInfo>
+#include <QTemporaryFile>
+#include <QTreeWidget>
 #include <QUrl>
 #include <QVBoxLayout>
 #include <QVariant>
 #include <QtCore/Qt>
 #include <QtCore/qoverload.h>
 #include <algorithm>
+#include <iterator>
 #include <utility>
 
+#include "MemoryProbe.h"
+#include "OutputTemplate.h"
+
 namespace {
-constexpr int kMaxLogEntries = 500;
-const QSet<QString> kAllowedThumbSchemes = {QStringLiteral("http"), QStringLiteral("https")};
+constexpr int kLogFilterDelayMs = 200;
+constexpr int kTileRefreshDelayMs = 50;
+constexpr int kMemoryCheckIntervalMs = 30000;
+const QSize kJobTileSize(32, 18);
+constexpr qint64 kInfoExpiryMarginSecs = 10 * 60;
+const QString kSpawnSpan = QStringLiteral("spawn");
+const QString kCookiesSpan = QStringLiteral("cookies");
+const QString kExtractSpan = QStringLiteral("extract");
+const QSet<QString> kProcessSpans = {kSpawnSpan, QStringLiteral("resumed"), kCookiesSpan, kExtractSpan, QStringLiteral("download"),
+                                     QStringLiteral("merge"), QStringLiteral("post-process")};
+enum JobColumn { JobIdColumn, JobPriorityColumn, JobStateColumn, JobPercentColumn, JobNameColumn };
+const QString kDefaultTemplate = QStringLiteral("%(title)s-%(id)s.%(ext)s");
+const QString kDefaultChapterTemplate = QStringLiteral("%(title)s - %(section_number)03d %(section_title)s [%(id)s].%(ext)s");
+const QStringList kLeanInfoFields = {QStringLiteral("id"), QStringLiteral("title"), QStringLiteral("thumbnail"),
+                                     QStringLiteral("duration"), QStringLiteral("chapters")};
+const QString kLeanInfoTemplate = QStringLiteral(
+    "{\"info\":%(.{%1})j,"
+    "\"formats\":%(formats.:.{format_id,ext,vcodec,acodec,height,fps,tbr,format_note,protocol,filesize,filesize_approx})j}");
+
+// The compact projection also carries every field the filename template refers to, so it can be previewed locally.
+QStringList leanInfoFields(const QString &outputTemplate) {
+    static const QRegularExpression identifierRe(QStringLiteral("^[A-Za-z_][A-Za-z0-9_]*$"));
+    QStringList fields = kLeanInfoFields;
+    for (const QString &field : outputTemplateFields(outputTemplate)) {
+        if (identifierRe.match(field).hasMatch() && !fields.contains(field)) {
+            fields << field;
+        }
+    }
+    return fields;
 }
 
-bool FormatRow::isVideo() const {
-    return (vcodec.isEmpty() ? QStringLiteral("none") : vcodec) != QStringLiteral("none") && height.value_or(0) > 0;
+bool samePath(const QString &a, const QString &b) {
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    const Qt::CaseSensitivity sensitivity = Qt::CaseInsensitive;
+#else
+    const Qt::CaseSensitivity sensitivity = Qt::CaseSensitive;
+#endif
+    return QDir::cleanPath(a).compare(QDir::cleanPath(b), sensitivity) == 0;
 }
 
-bool FormatRow::isAudio() const {
-    return (acodec.isEmpty() ? QStringLiteral("none") : acodec) != QStringLiteral("none") && height.value_or(0) == 0;
+std::optional<QJsonObject> expandLeanInfo(const QJsonObject &data) {
+    const QJsonValue info = data.value(QStringLiteral("info"));
+    const QJsonValue formats = data.value(QStringLiteral("formats"));
+    if (!info.isObject() || !formats.isArray()) {
+        return std::nullopt;
+    }
+    QJsonObject object = info.toObject();
+    object.insert(QStringLiteral("formats"), formats);
+    return object;
 }
 
-bool FormatRow::isProgressive() const {
-    const auto v = vcodec.isEmpty() ? QStringLiteral("none") : vcodec;
-    const auto a = acodec.isEmpty() ? QStringLiteral("none") : acodec;
-    return v != QStringLiteral("none") && a != QStringLiteral("none") && height.value_or(0) > 0;
+// Signed media URLs carry their deadline as expire=<unix time> (or /expire/<unix time>/ in manifest paths).
+qint64 earliestUrlExpiry(const QByteArray &json) {
+    static const QByteArray key = QByteArrayLiteral("expire");
+    qint64 earliest = 0;
+    for (qsizetype at = json.indexOf(key); at >= 0; at = json.indexOf(key, at + key.size())) {
+        const qsizetype digits = at + key.size() + 1;
+        if (at == 0 || digits >= json.size()) {
+            continue;
+        }
+        const char before = json.at(at - 1);
+        const char separator = json.at(digits - 1);
+        if ((before != '?' && before != '&' && before != '/') || (separator != '=' && separator != '/')) {
+            continue;
+        }
+        qsizetype end = digits;
+        while (end < json.size() && end - digits < 12 && json.at(end) >= '0' && json.at(end) <= '9') {
+            ++end;
+        }
+        bool ok = false;
+        const qint64 value = json.mid(digits, end - digits).toLongLong(&ok);
+        if (ok && value > 0 && (earliest == 0 || value < earliest)) {
+            earliest = value;
+        }
+    }
+    return earliest;
 }
 
-QString FormatRow::videoLabel() const {
-    QStringList parts;
-    parts << fid;
-    if (height) {
-        parts << QString::number(height.value()) % QLatin1String("p");
-    }
-    if (!vcodec.isEmpty() && vcodec != QStringLiteral("none")) {
-        parts << vcodec;
-    }
-    if (fps) {
-        parts << QString::number(static_cast<int>(fps.value())) % QLatin1String("fps");
-    }
-    if (tbr) {
-        parts << QLatin1String("~") % QString::number(tbr.value(), 'f', 1) % QLatin1String(" Mb/s");
-    }
-    if (!ext.isEmpty()) {
-        parts << ext;
-    }
-    if (!formatNote.isEmpty()) {
-        parts << formatNote;
-    }
-    return parts.join(QLatin1String(" | "));
+QString phaseSpan(ProcessWorker::Phase phase) {
+    switch (phase) {
+    case ProcessWorker::Phase::Starting:
+        return kSpawnSpan;
+    case ProcessWorker::Phase::Extracting:
+        return kExtractSpan;
+    case ProcessWorker::Phase::Downloading:
+        return QStringLiteral("download");
+    case ProcessWorker::Phase::Merging:
+        return QStringLiteral("merge");
+    case ProcessWorker::Phase::PostProcessing:
+        return QStringLiteral("post-process");
+    }
+    return QString();
 }
 
-QString FormatRow::audioLabel() const {
-    QStringList parts;
-    parts << fid;
-    if (!acodec.isEmpty() && acodec != QStringLiteral("none")) {
-        parts << acodec;
-    }
-    if (tbr) {
-        double rate = tbr.value();
-        if (rate < 5.0) {
-            rate *= 1000.0;
-        }
-        parts << QLatin1String("~") % QString::number(static_cast<int>(rate)) % QLatin1String(" kb/s");
-    }
-    if (!ext.isEmpty()) {
-        parts << ext;
-    }
-    if (!formatNote.isEmpty()) {
-        parts << formatNote;
-    }
-    return parts.join(QLatin1String(" | "));
+// Keys under priority/<class>/: nice, io (default, best-effort or idle), ioLevel 0-7 and cpus such as "0-3,6".
+ProcessPriority readProcessPriority(const QSettings &settings, const QString &group, const ProcessPriority &fallback) {
+    ProcessPriority priority = fallback;
+    priority.niceness = std::clamp(settings.value(group + QStringLiteral("/nice"), fallback.niceness).toInt(), 0, 19);
+    const QString io = settings.value(group + QStringLiteral("/io")).toString().trimmed().toLower();
+    if (io == QStringLiteral("idle")) {
+        priority.io = ProcessPriority::Io::Idle;
+    } else if (io == QStringLiteral("best-effort")) {
+        priority.io = ProcessPriority::Io::BestEffort;
+    } else if (io == QStringLiteral("default")) {
+        priority.io = ProcessPriority::Io::Default;
+    }
+    priority.ioLevel = std::clamp(settings.value(group + QStringLiteral("/ioLevel"), fallback.ioLevel).toInt(), 0, 7);
+    priority.cpuMask = parseCpuList(settings.value(group + QStringLiteral("/cpus")).toString()).value_or(0);
+    return priority;
+}
+
+const QSet<QString> kAllowedThumbSchemes = {QStringLiteral("http"), QStringLiteral("https")};
 }
 
 MainWindow::MainWindow(QWidget *parent)
@@ -112,31 +173,74 @@ MainWindow::MainWindow(QWidget *parent)
       btnAnalyze(nullptr),
       btnDownload(nullptr),
       btnStop(nullptr),
+      btnPause(nullptr),
+      btnResume(nullptr),
+      btnClear(nullptr),
+      priorityCombo(nullptr),
       outDirEdit(nullptr),
       btnBrowse(nullptr),
+      scratchDirEdit(nullptr),
+      btnScratchBrowse(nullptr),
       templateEdit(nullptr),
+      templatePreviewLabel(nullptr),
       videoCombo(nullptr),
       audioCombo(nullptr),
       containerCombo(nullptr),
+      audioFormatCombo(nullptr),
       audioOnlyCheck(nullptr),
       ariaCheck(nullptr),
       ariaConn(nullptr),
+      fragmentsSpin(nullptr),
       embedThumbCheck(nullptr),
+      splitChaptersCheck(nullptr),
+      sectionEdit(nullptr),
+      chapterCombo(nullptr),
+      preciseCutCheck(nullptr),
+      sectionSizeLabel(nullptr),
+      postCostLabel(nullptr),
+      btnPostSuggestion(nullptr),
       thumbLabel(nullptr),
       cookiesCombo(nullptr),
       progress(nullptr),
+      jobList(nullptr),
+      parallelSpin(nullptr),
+      queueStatsLabel(nullptr),
       logView(nullptr),
+      logFilterEdit(nullptr),
+      logSeverityCombo(nullptr),
+      logJobCombo(nullptr),
       thumbManager(new QNetworkAccessManager(this)),
       thumbReply(nullptr),
+      thumbTiles(new ThumbnailLoader(thumbManager, kJobTileSize, this)),
       settings(QStringLiteral("falcionx"), QStringLiteral("yt-dlp-gui")),
-      proc(nullptr),
       metaProc(nullptr),
+      jobQueue(new JobQueue(&ioThread, this)),
+      controlServer(new ControlServer(jobQueue, this)),
+      dedupStore(new DedupStore(this)),
       metaTimer(this),
-      thumbMaxBytes(5 * 1024 * 1024),
-      percentRe(QStringLiteral("(\\d{1,3}(?:\\.\\d+)?)%")),
-      ariaProgressRe(QStringLiteral("\\[#(?<id>[^\\s]+)\\s+(?<done>[0-9.]+[A-Za-z]+)/(?:\\s*)?(?<total>[0-9.]+[A-Za-z]+)\\((?<pct>[0-9.]+)%\\)\\s+CN:(?<conn>\\d+)\\s+DL:(?<speed>[0-9.]+[A-Za-z/]+)\\s+ETA:(?<eta>[^\\]]+)\\]")) {
+      watchdog(this),
+      memoryTimer(this),
+      memoryBudgetBytes(0),
+      memoryBudgetWarned(false),
+      logModel(new SessionLogModel(sessionLog, this)),
+      logFilterTimer(this),
+      logFollowTail(true),
+      focusJobId(0),
+      tileTimer(this),
+      videoModel(new FormatListModel(formatStore, FormatListModel::Kind::Video, this)),
+      audioModel(new FormatListModel(formatStore, FormatListModel::Kind::Audio, this)),
+      analyzedInfoAt(0),
+      analyzedInfoExpiry(0),
+      metaLean(false),
+      metaForceFull(false),
+      metaUsedJar(false),
+      metaExporting(false),
+      thumbMaxBytes(5 * 1024 * 1024) {
     setupUi();
 
+    ioThread.setObjectName(QStringLiteral("process-io"));
+    ioThread.start();
+
     ariaAvailable = !QStandardPaths::findExecutable(QStringLiteral("aria2c")).isEmpty();
     if (!ariaAvailable) {
         ariaCheck->setChecked(false);
@@ -147,10 +251,10 @@ MainWindow::MainWindow(QWidget *parent)
     }
 
     if (QStandardPaths::findExecutable(QStringLiteral("yt-dlp")).isEmpty()) {
-        appendLog(QStringLiteral("Warning: yt-dlp not found in PATH. Downloads will fail."));
+        appendLog(QStringLiteral("Warning: yt-dlp not found in PATH. Downloads will fail."), LogSeverity::Warning);
     }
     if (QStandardPaths::findExecutable(QStringLiteral("ffmpeg")).isEmpty()) {
-        appendLog(QStringLiteral("Warning: ffmpeg not found in PATH. Remuxing may fail."));
+        appendLog(QStringLiteral("Warning: ffmpeg not found in PATH. Remuxing may fail."), LogSeverity::Warning);
     }
 
     const QString defaultDir = defaultOutputDir();
@@ -158,6 +262,100 @@ MainWindow::MainWindow(QWidget *parent)
         outDirEdit->setText(defaultDir);
     }
 
+    watchdog.setStallThreshold(settings.value(QStringLiteral("diagnostics/stallThresholdMs"), 150).toInt());
+    // Straight into the session log: appendLog would also scroll the view, more work for a thread that is already behind.
+    connect(&watchdog, &StallWatchdog::stallDetected, this, [this](const QString &handler, qint64 millis, int suppressed) {
+        QString message = QStringLiteral("UI stall: %1 blocked the event loop for %2 ms").arg(handler).arg(millis);
+        if (suppressed > 0) {
+            message += QStringLiteral(" (%1 more since the last report)").arg(suppressed);
+        }
+        sessionLog.append(message, LogSeverity::Warning, 0);
+    }, Qt::QueuedConnection);
+    watchdog.setEnabled(settings.value(QStringLiteral("diagnostics/watchdog"), true).toBool());
+    watchdog.setTrace(&trace);
+    if (settings.value(QStringLiteral("diagnostics/trace"), false).toBool()) {
+        trace.start();
+    }
+    memoryBudgetBytes = settings.value(QStringLiteral("diagnostics/memoryBudgetMB"), 512).toLongLong() * 1024 * 1024;
+    memoryTimer.setInterval(kMemoryCheckIntervalMs);
+    connect(&memoryTimer, &QTimer::timeout, this, &MainWindow::checkMemory);
+    if (memoryBudgetBytes > 0) {
+        memoryTimer.start();
+    }
+
+    jobQueue->setMaxDownloads(parallelSpin->value());
+    jobQueue->setMaxRetries(settings.value(QStringLiteral("queue/maxRetries"), 4).toInt());
+    JobQueue::HostLimits hostDefaults;
+    hostDefaults.maxJobs = settings.value(QStringLiteral("hosts/maxJobs"), hostDefaults.maxJobs).toInt();
+    hostDefaults.maxConnections = settings.value(QStringLiteral("hosts/maxConnections"), hostDefaults.maxConnections).toInt();
+    jobQueue->setDefaultHostLimits(hostDefaults);
+    settings.beginGroup(QStringLiteral("hosts"));
+    const QStringList limitedHosts = settings.childGroups();
+    for (const QString &host : limitedHosts) {
+        JobQueue::HostLimits limits;
+        limits.maxJobs = settings.value(host + QStringLiteral("/maxJobs"), hostDefaults.maxJobs).toInt();
+        limits.maxConnections = settings.value(host + QStringLiteral("/maxConnections"), hostDefaults.maxConnections).toInt();
+        jobQueue->setHostLimits(host, limits);
+    }
+    settings.endGroup();
+    jobQueue->setDiskAware(settings.value(QStringLiteral("queue/diskAware"), true).toBool());
+    jobQueue->setMaxPostProcesses(settings.value(QStringLiteral("queue/maxPostProcesses"), QThread::idealThreadCount()).toInt());
+    if (settings.value(QStringLiteral("priority/enabled"), true).toBool()) {
+        const std::pair<JobQueue::ProcessClass, QString> classes[] = {{JobQueue::ProcessClass::Foreground, QStringLiteral("foreground")},
+                                                                      {JobQueue::ProcessClass::Normal, QStringLiteral("normal")},
+                                                                      {JobQueue::ProcessClass::Background, QStringLiteral("background")},
+                                                                      {JobQueue::ProcessClass::Post, QStringLiteral("post")}};
+        const ProcessPriority defaults[] = {ProcessPriority{},
+                                            ProcessPriority{0, ProcessPriority::Io::BestEffort, 4, 0},
+                                            ProcessPriority{15, ProcessPriority::Io::Idle, 7, 0},
+                                            ProcessPriority{10, ProcessPriority::Io::BestEffort, 7, 0}};
+        for (std::size_t i = 0; i < std::size(classes); ++i) {
+            jobQueue->setProcessPriority(classes[i].first,
+                                         readProcessPriority(settings, QStringLiteral("priority/") + classes[i].second, defaults[i]));
+        }
+    }
+    connect(jobQueue, &JobQueue::jobAdded, this, &MainWindow::onJobAdded);
+    connect(jobQueue, &JobQueue::jobChanged, this, &MainWindow::onJobChanged);
+    connect(jobQueue, &JobQueue::jobLog, this, &MainWindow::onJobLog);
+    connect(jobQueue, &JobQueue::jobProgress, this, &MainWindow::onJobProgress);
+    connect(jobQueue, &JobQueue::jobPhase, this, &MainWindow::onJobPhase);
+    connect(jobQueue, &JobQueue::jobFinished, this, &MainWindow::onJobFinished);
+    connect(jobQueue, &JobQueue::statsChanged, this, &MainWindow::updateQueueStats);
+    connect(jobQueue, &JobQueue::jobAdded, this, &MainWindow::updateTemplatePreview);
+    connect(jobQueue, &JobQueue::jobFinished, this, &MainWindow::updateTemplatePreview);
+    connect(jobQueue, &JobQueue::cookieJarRejected, this, [this](const QString &browser) {
+        cookieCache.invalidate(browser);
+    });
+
+    controlServer->setSubmitHandler([this](const QJsonObject &request, QString *error) {
+        return submitFromControl(request, error);
+    });
+    connect(controlServer, &ControlServer::activationRequested, this, [this]() {
+        showNormal();
+        raise();
+        activateWindow();
+    });
+    dedupStore->setAllowHardlinks(settings.value(QStringLiteral("dedup/allowHardlinks"), false).toBool());
+    connect(dedupStore, &DedupStore::deduplicated, this,
+            [this](int id, const QString &path, const QString &original, qint64 bytes, const QString &method) {
+        appendLog(QStringLiteral("Duplicate of %1 (%2 MiB), replaced with a %3: %4")
+                      .arg(QDir::toNativeSeparators(original))
+                      .arg(static_cast<double>(bytes) / (1024.0 * 1024.0), 0, 'f', 1)
+                      .arg(method, QDir::toNativeSeparators(path)),
+                  LogSeverity::Info, id);
+    });
+    connect(dedupStore, &DedupStore::runFinished, this, [this](qint64 bytes, int files) {
+        if (files > 0) {
+            appendLog(QStringLiteral("Dedup: reclaimed %1 MiB across %2 file(s).")
+                          .arg(static_cast<double>(bytes) / (1024.0 * 1024.0), 0, 'f', 1)
+                          .arg(files));
+        }
+    });
+    if (!controlServer->listen()) {
+        appendLog(QStringLiteral("Control socket unavailable; other launches will open their own window."), LogSeverity::Warning);
+    }
+    updateQueueStats();
+
     metaTimer.setSingleShot(true);
     connect(&metaTimer, &QTimer::timeout, this, &MainWindow::onMetaTimeout);
 
@@ -168,11 +366,32 @@ MainWindow::MainWindow(QWidget *parent)
 
     detectedBrowsers = detectInstalledBrowsers();
     refreshCookieChoices();
+    updateTemplatePreview();
+}
+
+MainWindow::~MainWindow() {
+    if (trace.isRecording()) {
+        trace.stop();
+        saveTrace();
+    }
+    delete controlServer;
+    controlServer = nullptr;
+    jobQueue->disconnect(this);
+    delete jobQueue;
+    jobQueue = nullptr;
+    if (metaProc) {
+        ProcessWorker *worker = metaProc;
+        worker->disconnect(this);
+        QMetaObject::invokeMethod(worker, [worker]() { delete worker; }, Qt::BlockingQueuedConnection);
+    }
+    metaProc = nullptr;
+    ioThread.quit();
+    ioThread.wait();
 }
 
 void MainWindow::setupUi() {
     setWindowTitle(QStringLiteral("yt-dlp GUI"));
-    setFixedSize(QSize(1280, 559));
+    setFixedSize(QSize(1280, 645));
 
     auto *central = new QWidget(this);
     setCentralWidget(central);
@@ -184,26 +403,77 @@ void MainWindow::setupUi() {
     btnDownload = new QPushButton(QStringLiteral("Download"));
     btnStop = new QPushButton(QStringLiteral("Stop"));
     btnStop->setEnabled(false);
+    btnStop->setToolTip(QStringLiteral("Cancel the selected jobs, or all jobs when none are selected"));
+    btnPause = new QPushButton(QStringLiteral("Pause"));
+    btnPause->setToolTip(QStringLiteral("Suspend the selected jobs; progress is kept"));
+    btnResume = new QPushButton(QStringLiteral("Resume"));
+    btnClear = new QPushButton(QStringLiteral("Clear finished"));
+    btnClear->setToolTip(QStringLiteral("Remove done, failed and cancelled jobs from the list"));
+    priorityCombo = new QComboBox();
+    priorityCombo->addItem(QStringLiteral("Low"), static_cast<int>(JobPriority::Low));
+    priorityCombo->addItem(QStringLiteral("Normal"), static_cast<int>(JobPriority::Normal));
+    priorityCombo->addItem(QStringLiteral("High"), static_cast<int>(JobPriority::High));
+    priorityCombo->setCurrentIndex(1);
+    priorityCombo->setToolTip(QStringLiteral("Priority for new downloads and the selected jobs; higher priority suspends lower-priority work when all slots are busy"));
 
     outDirEdit = new QLineEdit();
     outDirEdit->setPlaceholderText(QStringLiteral("Output directory"));
     btnBrowse = new QPushButton(QStringLiteral("Browse…"));
-    templateEdit = new QLineEdit(QStringLiteral("%(title)s-%(id)s.%(ext)s"));
+    scratchDirEdit = new QLineEdit(settings.value(QStringLiteral("download/scratchDir")).toString());
+    scratchDirEdit->setPlaceholderText(QStringLiteral("Optional fast local directory for fragments and merges"));
+    btnScratchBrowse = new QPushButton(QStringLiteral("Browse…"));
+    templateEdit = new QLineEdit(kDefaultTemplate);
+    templatePreviewLabel = new QLabel();
+    templatePreviewLabel->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Preferred);
+    templatePreviewLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
 
     videoCombo = new QComboBox();
     audioCombo = new QComboBox();
     containerCombo = new QComboBox();
     containerCombo->addItems({QStringLiteral("auto"), QStringLiteral("mp4"), QStringLiteral("mkv"), QStringLiteral("webm")});
+    audioFormatCombo = new QComboBox();
+    audioFormatCombo->addItems({QStringLiteral("original"), QStringLiteral("m4a"), QStringLiteral("mp3"), QStringLiteral("opus"),
+                                QStringLiteral("flac"), QStringLiteral("wav")});
+    audioFormatCombo->setEnabled(false);
+    audioFormatCombo->setToolTip(QStringLiteral("Audio-only: stream through ffmpeg into this format without a temporary source file"));
 
     audioOnlyCheck = new QCheckBox(QStringLiteral("Audio only"));
     ariaCheck = new QCheckBox(QStringLiteral("aria2c"));
     ariaConn = new QSpinBox();
     ariaConn->setRange(1, 32);
     ariaConn->setValue(16);
+    fragmentsSpin = new QSpinBox();
+    fragmentsSpin->setRange(0, 32);
+    fragmentsSpin->setSpecialValueText(QStringLiteral("auto"));
+    fragmentsSpin->setValue(settings.value(QStringLiteral("download/concurrentFragments"), 0).toInt());
+    fragmentsSpin->setToolTip(QStringLiteral("Concurrent fragments for HLS/DASH streams (auto tunes by measured throughput)"));
     embedThumbCheck = new QCheckBox(QStringLiteral("Embed thumbnail"));
+    splitChaptersCheck = new QCheckBox(QStringLiteral("Split chapters"));
+    splitChaptersCheck->setEnabled(false);
+    splitChaptersCheck->setToolTip(QStringLiteral("Also write one file per chapter, cut in parallel by stream copy"));
+
+    sectionEdit = new QLineEdit();
+    sectionEdit->setPlaceholderText(QStringLiteral("Whole video — or start-end, e.g. 1:02:00-1:04:30"));
+    sectionEdit->setClearButtonEnabled(true);
+    chapterCombo = new QComboBox();
+    chapterCombo->addItem(QStringLiteral("No chapters"), -1);
+    chapterCombo->setEnabled(false);
+    chapterCombo->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    chapterCombo->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    preciseCutCheck = new QCheckBox(QStringLiteral("Precise cuts"));
+    preciseCutCheck->setToolTip(QStringLiteral("Re-encode around the cut points; otherwise cuts snap to keyframes and streams are copied"));
+    sectionSizeLabel = new QLabel();
+    postCostLabel = new QLabel();
+    postCostLabel->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Preferred);
+    btnPostSuggestion = new QPushButton();
+    btnPostSuggestion->setVisible(false);
+
+    videoCombo->setModel(videoModel);
+    audioCombo->setModel(audioModel);
 
     for (auto combo : {videoCombo, audioCombo, containerCombo}) {
         combo->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+        combo->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
     }
 
     thumbLabel = new QLabel(QStringLiteral("No thumbnail"));
@@ -217,9 +487,42 @@ void MainWindow::setupUi() {
     progress = new QProgressBar();
     progress->setRange(0, 100);
 
-    logView = new QTextEdit();
-    logView->setReadOnly(true);
-    logView->setLineWrapMode(QTextEdit::NoWrap);
+    jobList = new QTreeWidget();
+    jobList->setColumnCount(5);
+    jobList->setHeaderLabels({QStringLiteral("#"), QStringLiteral("Pri"), QStringLiteral("State"), QStringLiteral("%"), QStringLiteral("Name")});
+    jobList->setRootIsDecorated(false);
+    jobList->setUniformRowHeights(true);
+    jobList->setIconSize(kJobTileSize);
+    jobList->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    jobList->setFixedWidth(420);
+    jobList->setColumnWidth(JobIdColumn, 36);
+    jobList->setColumnWidth(JobPriorityColumn, 52);
+    jobList->setColumnWidth(JobStateColumn, 110);
+    jobList->setColumnWidth(JobPercentColumn, 44);
+
+    parallelSpin = new QSpinBox();
+    parallelSpin->setRange(1, 8);
+    parallelSpin->setValue(settings.value(QStringLiteral("queue/maxDownloads"), 2).toInt());
+    parallelSpin->setToolTip(QStringLiteral("Concurrent downloads"));
+    queueStatsLabel = new QLabel();
+
+    logView = new QListView();
+    logView->setModel(logModel);
+    logView->setUniformItemSizes(true);
+    logView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    logView->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+
+    logFilterEdit = new QLineEdit();
+    logFilterEdit->setPlaceholderText(QStringLiteral("Filter log…"));
+    logFilterEdit->setClearButtonEnabled(true);
+    logSeverityCombo = new QComboBox();
+    logSeverityCombo->addItem(QStringLiteral("All"), static_cast<int>(LogSeverity::Debug));
+    logSeverityCombo->addItem(QStringLiteral("Info+"), static_cast<int>(LogSeverity::Info));
+    logSeverityCombo->addItem(QStringLiteral("Warnings+"), static_cast<int>(LogSeverity::Warning));
+    logSeverityCombo->addItem(QStringLiteral("Errors"), static_cast<int>(LogSeverity::Error));
+    logJobCombo = new QComboBox();
+    logJobCombo->addItem(QStringLiteral("All jobs"), -1);
+    logJobCombo->addItem(QStringLiteral("App"), 0);
 
     auto *top = new QHBoxLayout();
     top->addWidget(new QLabel(QStringLiteral("URL:")));
@@ -232,6 +535,10 @@ void MainWindow::setupUi() {
     out->addWidget(btnBrowse, 0, 2);
     out->addWidget(new QLabel(QStringLiteral("Filename template:")), 1, 0);
     out->addWidget(templateEdit, 1, 1, 1, 2);
+    out->addWidget(templatePreviewLabel, 2, 1, 1, 2);
+    out->addWidget(new QLabel(QStringLiteral("Scratch directory:")), 3, 0);
+    out->addWidget(scratchDirEdit, 3, 1);
+    out->addWidget(btnScratchBrowse, 3, 2);
     out->setColumnStretch(1, 1);
 
     auto *sel = new QGridLayout();
@@ -240,8 +547,19 @@ void MainWindow::setupUi() {
     sel->addWidget(new QLabel(QStringLiteral("Audio:")), 1, 0);
     sel->addWidget(audioCombo, 1, 1);
     sel->addWidget(audioOnlyCheck, 0, 2);
+    sel->addWidget(audioFormatCombo, 0, 3);
     sel->addWidget(new QLabel(QStringLiteral("Container:")), 1, 2);
     sel->addWidget(containerCombo, 1, 3);
+    sel->addWidget(new QLabel(QStringLiteral("Section:")), 2, 0);
+    sel->addWidget(sectionEdit, 2, 1);
+    sel->addWidget(chapterCombo, 2, 2);
+    auto *cut = new QHBoxLayout();
+    cut->addWidget(preciseCutCheck);
+    cut->addWidget(sectionSizeLabel, 1);
+    sel->addLayout(cut, 2, 3);
+    sel->addWidget(new QLabel(QStringLiteral("Post-processing:")), 3, 0);
+    sel->addWidget(postCostLabel, 3, 1, 1, 2);
+    sel->addWidget(btnPostSuggestion, 3, 3);
     sel->setColumnStretch(1, 1);
     sel->setColumnStretch(3, 1);
 
@@ -249,7 +567,10 @@ void MainWindow::setupUi() {
     aria->addWidget(ariaCheck);
     aria->addWidget(new QLabel(QStringLiteral("connections:")));
     aria->addWidget(ariaConn);
+    aria->addWidget(new QLabel(QStringLiteral("Fragments:")));
+    aria->addWidget(fragmentsSpin);
     aria->addWidget(embedThumbCheck);
+    aria->addWidget(splitChaptersCheck);
     aria->addStretch(1);
     aria->addWidget(new QLabel(QStringLiteral("Cookies:")));
     aria->addWidget(cookiesCombo);
@@ -257,7 +578,15 @@ void MainWindow::setupUi() {
     auto *buttons = new QHBoxLayout();
     buttons->addWidget(btnDownload);
     buttons->addWidget(btnStop);
+    buttons->addWidget(btnPause);
+    buttons->addWidget(btnResume);
+    buttons->addWidget(btnClear);
+    buttons->addWidget(new QLabel(QStringLiteral("Priority:")));
+    buttons->addWidget(priorityCombo);
+    buttons->addWidget(new QLabel(QStringLiteral("Parallel:")));
+    buttons->addWidget(parallelSpin);
     buttons->addStretch(1);
+    buttons->addWidget(queueStatsLabel);
 
     auto *layout = new QVBoxLayout(central);
     layout->addLayout(top);
@@ -266,48 +595,137 @@ void MainWindow::setupUi() {
     layout->addLayout(aria);
     layout->addWidget(progress);
 
+    auto *logFilters = new QHBoxLayout();
+    logFilters->addWidget(logFilterEdit, 1);
+    logFilters->addWidget(logSeverityCombo);
+    logFilters->addWidget(logJobCombo);
+
+    auto *logBox = new QVBoxLayout();
+    logBox->addLayout(logFilters);
+    logBox->addWidget(logView, 1);
+
     auto *mid = new QHBoxLayout();
-    mid->addWidget(logView, 1);
+    mid->addLayout(logBox, 1);
 
     auto *thumbBox = new QVBoxLayout();
     thumbBox->addWidget(thumbLabel, 0, Qt::AlignTop);
-    thumbBox->addStretch(1);
+    thumbBox->addWidget(jobList, 1);
     mid->addLayout(thumbBox);
 
     layout->addLayout(mid);
     layout->addLayout(buttons);
 
     connect(btnBrowse, &QPushButton::clicked, this, &MainWindow::pickDir);
+    connect(btnScratchBrowse, &QPushButton::clicked, this, &MainWindow::pickScratchDir);
+    connect(scratchDirEdit, &QLineEdit::editingFinished, this, [this]() {
+        settings.setValue(QStringLiteral("download/scratchDir"), scratchDirEdit->text().trimmed());
+    });
     connect(btnAnalyze, &QPushButton::clicked, this, &MainWindow::analyzeUrl);
     connect(btnDownload, &QPushButton::clicked, this, &MainWindow::startDownload);
     connect(btnStop, &QPushButton::clicked, this, &MainWindow::stopDownload);
+    connect(btnPause, &QPushButton::clicked, this, &MainWindow::pauseSelected);
+    connect(btnResume, &QPushButton::clicked, this, &MainWindow::resumeSelected);
+    connect(btnClear, &QPushButton::clicked, this, &MainWindow::clearFinished);
+    connect(priorityCombo, &QComboBox::activated, this, [this](int index) {
+        const auto priority = static_cast<JobPriority>(priorityCombo->itemData(index).toInt());
+        for (int id : selectedJobIds()) {
+            jobQueue->setPriority(id, priority);
+        }
+    });
     connect(audioOnlyCheck, &QCheckBox::checkStateChanged, this, [this](Qt::CheckState state) {
         toggleAudioOnly(static_cast<int>(state));
+        updateSectionEstimate();
     });
     connect(videoCombo, &QComboBox::currentIndexChanged, this, &MainWindow::onVideoChanged);
+    connect(videoCombo, &QComboBox::currentIndexChanged, this, &MainWindow::updateSectionEstimate);
+    connect(audioCombo, &QComboBox::currentIndexChanged, this, &MainWindow::updateSectionEstimate);
+    connect(chapterCombo, &QComboBox::currentIndexChanged, this, &MainWindow::onChapterChanged);
+    connect(sectionEdit, &QLineEdit::textChanged, this, &MainWindow::updateSectionEstimate);
+    for (QLineEdit *edit : {templateEdit, outDirEdit, urlEdit}) {
+        connect(edit, &QLineEdit::textChanged, this, &MainWindow::updateTemplatePreview);
+    }
+    for (QComboBox *combo : {videoCombo, audioCombo, containerCombo, audioFormatCombo}) {
+        connect(combo, &QComboBox::currentIndexChanged, this, &MainWindow::updateTemplatePreview);
+    }
+    connect(audioOnlyCheck, &QCheckBox::checkStateChanged, this, &MainWindow::updateTemplatePreview);
+    for (QComboBox *combo : {videoCombo, audioCombo, containerCombo, audioFormatCombo}) {
+        connect(combo, &QComboBox::currentIndexChanged, this, &MainWindow::updatePostPlan);
+    }
+    connect(audioOnlyCheck, &QCheckBox::checkStateChanged, this, &MainWindow::updatePostPlan);
+    connect(embedThumbCheck, &QCheckBox::checkStateChanged, this, &MainWindow::updatePostPlan);
+    connect(btnPostSuggestion, &QPushButton::clicked, this, &MainWindow::applyPostSuggestion);
+    connect(sectionEdit, &QLineEdit::textEdited, this, [this]() {
+        chapterCombo->blockSignals(true);
+        chapterCombo->setCurrentIndex(0);
+        chapterCombo->blockSignals(false);
+    });
     connect(cookiesCombo, &QComboBox::currentIndexChanged, this, &MainWindow::onCookieChoiceChanged);
+    connect(fragmentsSpin, &QSpinBox::valueChanged, this, [this](int value) {
+        settings.setValue(QStringLiteral("download/concurrentFragments"), value);
+    });
+    connect(jobList, &QTreeWidget::itemSelectionChanged, this, &MainWindow::onJobSelectionChanged);
+    tileTimer.setSingleShot(true);
+    tileTimer.setInterval(kTileRefreshDelayMs);
+    connect(&tileTimer, &QTimer::timeout, this, &MainWindow::refreshVisibleTiles);
+    connect(jobList->verticalScrollBar(), &QScrollBar::valueChanged, &tileTimer, qOverload<>(&QTimer::start));
+    jobList->viewport()->installEventFilter(this);
+    connect(thumbTiles, &ThumbnailLoader::tileReady, this, &MainWindow::onTileReady);
+    connect(parallelSpin, &QSpinBox::valueChanged, this, [this](int value) {
+        settings.setValue(QStringLiteral("queue/maxDownloads"), value);
+        if (jobQueue) {
+            jobQueue->setMaxDownloads(value);
+        }
+    });
+
+    logFilterTimer.setSingleShot(true);
+    logFilterTimer.setInterval(kLogFilterDelayMs);
+    connect(&logFilterTimer, &QTimer::timeout, this, &MainWindow::applyLogFilter);
+    connect(logFilterEdit, &QLineEdit::textChanged, &logFilterTimer, qOverload<>(&QTimer::start));
+    connect(logSeverityCombo, &QComboBox::currentIndexChanged, this, &MainWindow::applyLogFilter);
+    connect(logJobCombo, &QComboBox::currentIndexChanged, this, &MainWindow::applyLogFilter);
+    connect(logView->verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        logFollowTail = value >= logView->verticalScrollBar()->maximum();
+    });
+    auto *copyShortcut = new QShortcut(QKeySequence::Copy, logView);
+    connect(copyShortcut, &QShortcut::activated, this, &MainWindow::copyLogSelection);
+
+    auto *reportShortcut = new QShortcut(QKeySequence(QStringLiteral("Ctrl+Shift+D")), this);
+    connect(reportShortcut, &QShortcut::activated, this, [this]() {
+        appendLog(watchdog.report() + QStringLiteral("\nMemory: ") + memorySummary(sampleMemory()));
+    });
+    auto *traceShortcut = new QShortcut(QKeySequence(QStringLiteral("Ctrl+Shift+T")), this);
+    connect(traceShortcut, &QShortcut::activated, this, &MainWindow::toggleTrace);
 }
 
-void MainWindow::appendLog(const QString &text) {
+void MainWindow::appendLog(const QString &text, LogSeverity severity, int jobId) {
     QString msg = text;
     while (msg.endsWith(QLatin1Char('\n')) || msg.endsWith(QLatin1Char('\r'))) {
         msg.chop(1);
     }
     if (!msg.isEmpty()) {
-        logMessages.append(msg);
-        if (logMessages.size() > kMaxLogEntries) {
-            const int removeCount = logMessages.size() - kMaxLogEntries;
-            for (int i = 0; i < removeCount; ++i) {
-                logMessages.removeFirst();
-            }
+        sessionLog.append(msg, severity, jobId);
+    }
+    clearDownloadLogLine();
+    refreshLogDisplay();
+}
+
+void MainWindow::appendLogEntries(const QStringList &entries, int jobId) {
+    for (const QString &msg : entries) {
+        const QString upper = msg.left(16).toUpper();
+        LogSeverity severity = LogSeverity::Info;
+        if (upper.startsWith(QStringLiteral("ERROR"))) {
+            severity = LogSeverity::Error;
+        } else if (upper.startsWith(QStringLiteral("WARNING"))) {
+            severity = LogSeverity::Warning;
         }
+        sessionLog.append(msg, severity, jobId);
     }
     clearDownloadLogLine();
     refreshLogDisplay();
 }
 
 void MainWindow::clearDownloadLogLine() {
-    downloadProgressLine.clear();
+    logModel->setLiveLine(QString());
 }
 
 void MainWindow::updateDownloadLogLine(const QString &text) {
@@ -315,122 +733,38 @@ void MainWindow::updateDownloadLogLine(const QString &text) {
     while (line.endsWith(QLatin1Char('\n')) || line.endsWith(QLatin1Char('\r'))) {
         line.chop(1);
     }
-    downloadProgressLine = line;
+    logModel->setLiveLine(line);
     refreshLogDisplay();
 }
 
 void MainWindow::refreshLogDisplay() {
-    QStringList parts = logMessages;
-    if (!downloadProgressLine.isEmpty()) {
-        parts.append(downloadProgressLine);
+    const StallWatchdog::Scope scope(watchdog, "refreshLogDisplay");
+    if (logFollowTail) {
+        logView->scrollToBottom();
     }
-    logView->setPlainText(parts.join(QLatin1Char('\n')));
-    QTextCursor cursor = logView->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    logView->setTextCursor(cursor);
 }
 
-std::optional<QString> MainWindow::normalizeProgressLine(const QString &text) const {
-    const QString stripped = text.trimmed();
-    if (stripped.isEmpty()) {
-        return std::nullopt;
-    }
-
-    bool onlyDecor = true;
-    for (const QChar ch : stripped) {
-        if (ch != QLatin1Char('-') && ch != QLatin1Char('=') && ch != QLatin1Char('_')) {
-            onlyDecor = false;
-            break;
-        }
-    }
-    if (onlyDecor) {
-        return std::nullopt;
-    }
-
-    const QString lowered = stripped.toLower();
-    if (lowered.contains(QStringLiteral("[error]"))) {
-        return std::nullopt;
-    }
-    if (lowered.startsWith(QStringLiteral("*** download progress summary"))) {
-        return std::nullopt;
-    }
-    if (lowered.startsWith(QStringLiteral("file:")) || lowered.startsWith(QStringLiteral("destination:"))) {
-        return std::nullopt;
-    }
-    if (lowered.startsWith(QStringLiteral("==="))) {
-        return std::nullopt;
-    }
-
-    if (lowered.contains(QStringLiteral("[download]"))) {
-        const int idx = lowered.indexOf(QStringLiteral("[download]"));
-        QString segment = text.mid(idx);
-        segment.replace(QRegularExpression(QStringLiteral("\\s+")), QStringLiteral(" "));
-        return segment.trimmed();
-    }
-
-    const QRegularExpressionMatch ariaMatch = ariaProgressRe.match(text);
-    if (ariaMatch.hasMatch()) {
-        const QString pct = ariaMatch.captured(QStringLiteral("pct"));
-        const QString done = ariaMatch.captured(QStringLiteral("done"));
-        const QString total = ariaMatch.captured(QStringLiteral("total"));
-        const QString speed = ariaMatch.captured(QStringLiteral("speed"));
-        const QString eta = ariaMatch.captured(QStringLiteral("eta")).trimmed();
-        const QString conn = ariaMatch.captured(QStringLiteral("conn"));
-        QString formatted = QStringLiteral("aria2c %1% — %2/%3 @ %4 ETA %5 (CN:%6)")
-                                 .arg(pct, done, total, speed, eta, conn);
-        return formatted;
-    }
-
-    if (text.startsWith(QStringLiteral("[#")) && percentRe.match(text).hasMatch()) {
-        const QRegularExpressionMatch pctMatch = percentRe.match(text);
-        const QString pct = pctMatch.hasMatch() ? pctMatch.captured(1) : QStringLiteral("?");
-        QString compact = text;
-        compact.replace(QRegularExpression(QStringLiteral("\\s+")), QStringLiteral(" "));
-        QString formatted = QStringLiteral("aria2c %1% — %2").arg(pct, compact.trimmed());
-        return formatted;
-    }
-
-    return std::nullopt;
+void MainWindow::applyLogFilter() {
+    const StallWatchdog::Scope scope(watchdog, "applyLogFilter");
+    logFilterTimer.stop();
+    const auto severity = static_cast<LogSeverity>(logSeverityCombo->currentData().toInt());
+    logModel->setFilter(logJobCombo->currentData().toInt(), severity, logFilterEdit->text().trimmed());
+    logFollowTail = true;
+    logView->scrollToBottom();
 }
 
-bool MainWindow::shouldSkipPlainLine(const QString &text) const {
-    const QString stripped = text.trimmed();
-    if (stripped.isEmpty()) {
-        return true;
-    }
-    bool onlyDecor = true;
-    for (const QChar ch : stripped) {
-        if (ch != QLatin1Char('-') && ch != QLatin1Char('=') && ch != QLatin1Char('_')) {
-            onlyDecor = false;
-            break;
-        }
-    }
-    if (onlyDecor) {
-        return true;
-    }
-    if (stripped.startsWith(QStringLiteral("***")) || stripped.startsWith(QStringLiteral("==="))) {
-        return true;
-    }
-    const QString lowered = stripped.toLower();
-    if (lowered.contains(QStringLiteral("[error]"))) {
-        return true;
-    }
-    if (lowered.startsWith(QStringLiteral("file:")) || lowered.startsWith(QStringLiteral("destination:"))) {
-        return true;
-    }
-    if (lowered.startsWith(QStringLiteral("exception:"))) {
-        return true;
-    }
-    const QStringList noisyPrefixes = {QStringLiteral("yt-dlp "), QStringLiteral("aria2c "), QStringLiteral("ffmpeg ")};
-    for (const QString &prefix : noisyPrefixes) {
-        if (lowered.startsWith(prefix)) {
-            return true;
-        }
+void MainWindow::copyLogSelection() {
+    QModelIndexList selected = logView->selectionModel()->selectedRows();
+    std::sort(selected.begin(), selected.end(), [](const QModelIndex &a, const QModelIndex &b) {
+        return a.row() < b.row();
+    });
+    QStringList lines;
+    for (const QModelIndex &index : std::as_const(selected)) {
+        lines << index.data(Qt::DisplayRole).toString();
     }
-    if (lowered.startsWith(QStringLiteral("[youtube]")) || lowered.startsWith(QStringLiteral("[ffmpeg]"))) {
-        return true;
+    if (!lines.isEmpty()) {
+        QApplication::clipboard()->setText(lines.join(QLatin1Char('\n')));
     }
-    return false;
 }
 
 QString MainWindow::defaultOutputDir() const {
@@ -485,98 +819,30 @@ void MainWindow::refreshCookieChoices() {
     }
 }
 
-QStringList MainWindow::cookiesArgs() const {
+QStringList MainWindow::cookiesArgs(JobSpec &spec) {
     const QString browser = cookieUserOverride.has_value() && !cookieUserOverride->isEmpty()
                                 ? cookieUserOverride.value()
                                 : (activeBrowser.has_value() ? activeBrowser.value() : QString());
-    if (!browser.isEmpty()) {
-        return {QStringLiteral("--cookies-from-browser"), browser};
+    if (browser.isEmpty()) {
+        return {};
+    }
+    const QString jar = cookieCache.checkout(browser);
+    if (!jar.isEmpty()) {
+        spec.cookieJar = jar;
+        spec.cookieBrowser = browser;
+        return {QStringLiteral("--cookies"), jar};
     }
-    return {};
+    return {QStringLiteral("--cookies-from-browser"), browser};
 }
 
 QStringList MainWindow::detectInstalledBrowsers() const {
-    const QString sysname = QSysInfo::productType().toLower();
-    const QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    const QString home = QDir::homePath();
-    const QString local = env.value(QStringLiteral("LOCALAPPDATA"));
-    const QString appdata = env.value(QStringLiteral("APPDATA"));
-
-    struct Candidate {
-        QString name;
-        QStringList paths;
-    };
-
-    auto resolvePath = [](const QString &base, const QString &suffix) -> QString {
-        if (base.isEmpty()) {
-            return QString();
-        }
-        return QDir(base).filePath(suffix);
-    };
-
-    auto existsAny = [](const QStringList &paths) -> bool {
-        for (const QString &path : paths) {
-            if (path.isEmpty()) {
-                continue;
-            }
-            QFileInfo info(path);
-            if (info.exists()) {
-                return true;
-            }
-        }
-        return false;
-    };
-
-    QList<Candidate> candidates;
-
-    if (sysname.contains(QStringLiteral("windows"))) {
-        candidates = {
-            {QStringLiteral("chrome"),
-             {resolvePath(local, QStringLiteral("Google/Chrome/User Data/Default/Network/Cookies")),
-              resolvePath(local, QStringLiteral("Google/Chrome/User Data/Default/Cookies"))}},
-            {QStringLiteral("edge"),
-             {resolvePath(local, QStringLiteral("Microsoft/Edge/User Data/Default/Network/Cookies")),
-              resolvePath(local, QStringLiteral("Microsoft/Edge/User Data/Default/Cookies"))}},
-            {QStringLiteral("brave"),
-             {resolvePath(local, QStringLiteral("BraveSoftware/Brave-Browser/User Data/Default/Network/Cookies")),
-              resolvePath(local, QStringLiteral("BraveSoftware/Brave-Browser/User Data/Default/Cookies"))}},
-            {QStringLiteral("chromium"),
-             {resolvePath(local, QStringLiteral("Chromium/User Data/Default/Network/Cookies")),
-              resolvePath(local, QStringLiteral("Chromium/User Data/Default/Cookies"))}},
-            {QStringLiteral("opera"),
-             {resolvePath(appdata, QStringLiteral("Opera Software/Opera Stable/Network/Cookies")),
-              resolvePath(appdata, QStringLiteral("Opera Software/Opera Stable/Cookies"))}},
-            {QStringLiteral("firefox"),
-             {resolvePath(appdata, QStringLiteral("Mozilla/Firefox/Profiles"))}},
-        };
-    } else if (sysname.contains(QStringLiteral("osx")) || sysname.contains(QStringLiteral("macos"))) {
-        const QString appSup = QDir(home).filePath(QStringLiteral("Library/Application Support"));
-        candidates = {
-            {QStringLiteral("safari"), {QDir(home).filePath(QStringLiteral("Library/Cookies/Cookies.binarycookies"))}},
-            {QStringLiteral("chrome"), {resolvePath(appSup, QStringLiteral("Google/Chrome/Default/Cookies"))}},
-            {QStringLiteral("brave"), {resolvePath(appSup, QStringLiteral("BraveSoftware/Brave-Browser/Default/Cookies"))}},
-            {QStringLiteral("edge"), {resolvePath(appSup, QStringLiteral("Microsoft Edge/Default/Cookies"))}},
-            {QStringLiteral("firefox"), {resolvePath(appSup, QStringLiteral("Firefox/Profiles"))}},
-            {QStringLiteral("chromium"), {resolvePath(appSup, QStringLiteral("Chromium/Default/Cookies"))}},
-            {QStringLiteral("opera"), {resolvePath(appSup, QStringLiteral("com.operasoftware.Opera/Cookies"))}},
-        };
-    } else {
-        const QString cfg = QDir(home).filePath(QStringLiteral(".config"));
-        candidates = {
-            {QStringLiteral("chrome"), {resolvePath(cfg, QStringLiteral("google-chrome/Default/Cookies"))}},
-            {QStringLiteral("chromium"), {resolvePath(cfg, QStringLiteral("chromium/Default/Cookies"))}},
-            {QStringLiteral("brave"), {resolvePath(cfg, QStringLiteral("BraveSoftware/Brave-Browser/Default/Cookies"))}},
-            {QStringLiteral("edge"), {resolvePath(cfg, QStringLiteral("microsoft-edge/Default/Cookies"))}},
-            {QStringLiteral("firefox"), {QDir(home).filePath(QStringLiteral(".mozilla/firefox"))}},
-            {QStringLiteral("opera"), {resolvePath(cfg, QStringLiteral("opera/Cookies")), resolvePath(cfg, QStringLiteral("opera-stable/Cookies"))}},
-            {QStringLiteral("vivaldi"), {resolvePath(cfg, QStringLiteral("vivaldi/Default/Cookies"))}},
-        };
-    }
-
     QStringList order;
-    for (const Candidate &candidate : candidates) {
-        if (existsAny(candidate.paths)) {
-            order.append(candidate.name);
+    for (const CookieStore &store : CookieCache::cookieStores()) {
+        const bool found = std::any_of(store.paths.cbegin(), store.paths.cend(), [](const QString &path) {
+            return !path.isEmpty() && QFileInfo::exists(path);
+        });
+        if (found) {
+            order.append(store.browser);
         }
     }
     return order;
@@ -590,10 +856,20 @@ void MainWindow::pickDir() {
     }
 }
 
+void MainWindow::pickScratchDir() {
+    const QString startDir = scratchDirEdit->text().isEmpty() ? QDir::tempPath() : scratchDirEdit->text();
+    const QString dir = QFileDialog::getExistingDirectory(this, QStringLiteral("Select scratch directory"), startDir);
+    if (!dir.isEmpty()) {
+        scratchDirEdit->setText(dir);
+        settings.setValue(QStringLiteral("download/scratchDir"), dir);
+    }
+}
+
 void MainWindow::toggleAudioOnly(int state) {
     const bool only = state == Qt::Checked;
     videoCombo->setEnabled(!only);
     containerCombo->setEnabled(!only);
+    audioFormatCombo->setEnabled(only);
     audioCombo->setEnabled(true);
     if (!only) {
         onVideoChanged(videoCombo->currentIndex());
@@ -604,18 +880,216 @@ void MainWindow::onVideoChanged(int index) {
     if (audioOnlyCheck->isChecked()) {
         return;
     }
-    bool progressive = false;
-    if (index >= 0 && index < videoCombo->count()) {
-        const QString fid = videoCombo->itemData(index).toString();
-        const auto it = rowsById.constFind(fid);
-        if (it != rowsById.constEnd()) {
-            progressive = it.value().isProgressive();
-        }
-    }
+    const FormatRow *row = videoModel->rowAt(index);
+    const bool progressive = row && row->isProgressive();
     audioCombo->setEnabled(!progressive);
     audioCombo->setToolTip(progressive ? QStringLiteral("This format already contains audio") : QString());
 }
 
+void MainWindow::onChapterChanged(int index) {
+    const int chapter = chapterCombo->itemData(index).toInt();
+    if (chapter >= 0 && chapter < analyzedChapters.size()) {
+        sectionEdit->setText(formatSectionRange(analyzedChapters.at(chapter)));
+    }
+}
+
+std::optional<qint64> MainWindow::selectedFormatBytes() const {
+    const FormatRow *audio = audioModel->rowAt(audioCombo->currentIndex());
+    if (audioOnlyCheck->isChecked()) {
+        return audio ? audio->filesize : std::nullopt;
+    }
+    const FormatRow *video = videoModel->rowAt(videoCombo->currentIndex());
+    if (!video || !video->filesize) {
+        return std::nullopt;
+    }
+    if (video->isProgressive()) {
+        return video->filesize;
+    }
+    if (!audio || !audio->filesize) {
+        return std::nullopt;
+    }
+    return video->filesize.value() + audio->filesize.value();
+}
+
+void MainWindow::updateSectionEstimate() {
+    const double duration = analyzedInfo.value(QStringLiteral("duration")).toDouble();
+    const std::optional<qint64> bytes = selectedFormatBytes();
+    const QString text = sectionEdit->text().trimmed();
+    if (text.isEmpty()) {
+        sectionSizeLabel->setText(bytes ? QStringLiteral("≈ %1").arg(QLocale().formattedDataSize(bytes.value())) : QString());
+        return;
+    }
+    const std::optional<SectionRange> range = parseSectionRange(text, duration);
+    if (!range) {
+        sectionSizeLabel->setText(QStringLiteral("invalid range"));
+        return;
+    }
+    const QString length = formatTimestamp(range->length());
+    if (!bytes || duration <= 0.0) {
+        sectionSizeLabel->setText(length);
+        return;
+    }
+    const auto sectionBytes = static_cast<qint64>(static_cast<double>(bytes.value()) * range->length() / duration);
+    sectionSizeLabel->setText(QStringLiteral("≈ %1 (%2)").arg(QLocale().formattedDataSize(sectionBytes), length));
+}
+
+void MainWindow::updatePostPlan() {
+    const FormatRow *audio = audioModel->rowAt(audioCombo->currentIndex());
+    if (audioOnlyCheck->isChecked()) {
+        postPlan = planAudioConversion(audio, audioFormatCombo->currentText());
+    } else {
+        const FormatRow *video = videoModel->rowAt(videoCombo->currentIndex());
+        postPlan = planRemux(formatStore, video, video && video->isProgressive() ? nullptr : audio, containerCombo->currentText());
+    }
+
+    QString text = postCostName(postPlan.cost) + QStringLiteral(" — ") + postPlan.summary();
+    if (embedThumbCheck->isChecked()) {
+        text += QStringLiteral(", embed thumbnail");
+    }
+    const bool transcode = postPlan.cost == PostCost::Transcode && !audioOnlyCheck->isChecked();
+    if (transcode) {
+        text += QStringLiteral(" (re-encodes: slow and lossy)");
+    }
+    postCostLabel->setText(text);
+    postCostLabel->setStyleSheet(transcode ? QStringLiteral("color:#d9534f;") : QString());
+
+    if (postPlan.progressiveIndex >= 0) {
+        const FormatRow &row = formatStore.at(postPlan.progressiveIndex);
+        btnPostSuggestion->setText(QStringLiteral("Use %1 (no merge)").arg(row.fid));
+        btnPostSuggestion->setToolTip(row.videoLabel());
+        btnPostSuggestion->setVisible(true);
+    } else if (postPlan.audioIndex >= 0) {
+        const FormatRow &row = formatStore.at(postPlan.audioIndex);
+        btnPostSuggestion->setText(QStringLiteral("Use audio %1 (copy)").arg(row.fid));
+        btnPostSuggestion->setToolTip(row.audioLabel());
+        btnPostSuggestion->setVisible(true);
+    } else if (transcode && !postPlan.copyContainer.isEmpty()) {
+        btnPostSuggestion->setText(QStringLiteral("Use %1 (copy)").arg(postPlan.copyContainer));
+        btnPostSuggestion->setToolTip(QStringLiteral("%1 takes these streams without re-encoding").arg(postPlan.copyContainer));
+        btnPostSuggestion->setVisible(true);
+    } else {
+        btnPostSuggestion->setVisible(false);
+    }
+}
+
+void MainWindow::applyPostSuggestion() {
+    if (postPlan.progressiveIndex >= 0) {
+        videoCombo->setCurrentIndex(static_cast<int>(formatStore.videoOrder().indexOf(postPlan.progressiveIndex)));
+    } else if (postPlan.audioIndex >= 0) {
+        audioCombo->setCurrentIndex(static_cast<int>(formatStore.audioOrder().indexOf(postPlan.audioIndex)));
+    } else if (!postPlan.copyContainer.isEmpty()) {
+        containerCombo->setCurrentText(postPlan.copyContainer);
+    }
+}
+
+QString MainWindow::predictedExtension(const FormatRow *video, const FormatRow *audio) const {
+    if (audioOnlyCheck->isChecked()) {
+        const QString audioFormat = audioFormatCombo->currentText();
+        const bool converted = !sectionEdit->text().trimmed().isEmpty() || settings.value(QStringLiteral("stream/enabled"), true).toBool();
+        if (audioFormat != QStringLiteral("original") && converted) {
+            return audioFormat;
+        }
+        return audio ? audio->ext : QString();
+    }
+    const QString container = containerCombo->currentText();
+    if (container != QStringLiteral("auto")) {
+        return container;
+    }
+    if (!video) {
+        return QString();
+    }
+    return video->isProgressive() ? video->ext : pickMergeContainer(video->ext, audio ? audio->ext : QString());
+}
+
+std::optional<QString> MainWindow::predictOutputPath(QStringList *unresolved) const {
+    if (analyzedUrl.isEmpty() || urlEdit->text().trimmed() != analyzedUrl) {
+        return std::nullopt;
+    }
+    const bool audioOnly = audioOnlyCheck->isChecked();
+    const FormatRow *video = audioOnly ? nullptr : videoModel->rowAt(videoCombo->currentIndex());
+    const bool needsAudio = audioOnly || (video && !video->isProgressive());
+    const FormatRow *audio = needsAudio ? audioModel->rowAt(audioCombo->currentIndex()) : nullptr;
+
+    // yt-dlp describes the merged download with the video's properties and both format ids.
+    QJsonObject fields = analyzedInfo;
+    QStringList formatIds;
+    if (video) {
+        formatIds << video->fid;
+        fields.insert(QStringLiteral("vcodec"), video->vcodec);
+        fields.insert(QStringLiteral("format_note"), video->formatNote);
+        if (video->height) {
+            fields.insert(QStringLiteral("height"), video->height.value());
+        }
+        if (video->fps) {
+            fields.insert(QStringLiteral("fps"), video->fps.value());
+        }
+    }
+    if (audio) {
+        formatIds << audio->fid;
+        fields.insert(QStringLiteral("acodec"), audio->acodec);
+    }
+    if (!formatIds.isEmpty()) {
+        fields.insert(QStringLiteral("format_id"), formatIds.join(QLatin1Char('+')));
+    }
+    const QString ext = predictedExtension(video, audio);
+    if (!ext.isEmpty()) {
+        fields.insert(QStringLiteral("ext"), ext);
+    }
+
+    const QString tpl = templateEdit->text().trimmed().isEmpty() ? kDefaultTemplate : templateEdit->text().trimmed();
+    const QString outDir = outDirEdit->text().trimmed().isEmpty() ? QDir::currentPath() : outDirEdit->text().trimmed();
+    return QDir::cleanPath(QDir(outDir).filePath(evaluateOutputTemplate(tpl, fields, unresolved)));
+}
+
+QStringList MainWindow::outputConflicts(const QString &path) const {
+    QStringList conflicts;
+    if (QFileInfo::exists(path)) {
+        conflicts << QStringLiteral("file already exists");
+    }
+    for (int id : jobQueue->jobIds()) {
+        const Job *job = jobQueue->job(id);
+        if (!job || job->state == JobState::Done || job->state == JobState::Failed || job->state == JobState::Cancelled) {
+            continue;
+        }
+        if (!job->spec.predictedPath.isEmpty() && samePath(job->spec.predictedPath, path)) {
+            conflicts << QStringLiteral("job #%1 writes the same file").arg(id);
+        }
+    }
+    return conflicts;
+}
+
+void MainWindow::updateTemplatePreview() {
+    QStringList unresolved;
+    const std::optional<QString> path = predictOutputPath(&unresolved);
+    if (!path) {
+        templatePreviewLabel->setStyleSheet(QStringLiteral("color:#888;"));
+        templatePreviewLabel->setText(QStringLiteral("Analyze the URL to preview the file name"));
+        templatePreviewLabel->setToolTip(QString());
+        return;
+    }
+
+    QStringList notes = outputConflicts(path.value());
+    const bool conflict = !notes.isEmpty();
+    QStringList unfetched;
+    for (const QString &field : unresolved) {
+        if (!analyzedFields.isEmpty() && !analyzedFields.contains(field)) {
+            unfetched << field;
+        }
+    }
+    if (!unfetched.isEmpty()) {
+        notes << QStringLiteral("analyze again to fetch %1").arg(unfetched.join(QStringLiteral(", ")));
+    }
+
+    const QString outDir = outDirEdit->text().trimmed().isEmpty() ? QDir::currentPath() : outDirEdit->text().trimmed();
+    QString text = QStringLiteral("→ ") + QDir::toNativeSeparators(QDir(outDir).relativeFilePath(path.value()));
+    if (!notes.isEmpty()) {
+        text += QStringLiteral("  ⚠ ") + notes.join(QStringLiteral("; "));
+    }
+    templatePreviewLabel->setStyleSheet(conflict ? QStringLiteral("color:#d9534f;") : QStringLiteral("color:#888;"));
+    templatePreviewLabel->setText(text);
+    templatePreviewLabel->setToolTip(QDir::toNativeSeparators(path.value()));
+}
+
 void MainWindow::onCookieChoiceChanged(int index) {
     const QVariant data = cookiesCombo->itemData(index);
     if (data.isValid() && !data.toString().isEmpty()) {
@@ -652,17 +1126,20 @@ void MainWindow::updateThumbnail() {
     thumbLabel->setText(QStringLiteral("Loading thumbnail…"));
     QNetworkRequest request(url);
     request.setRawHeader("User-Agent", "Mozilla/5.0");
+    trace.setSpan(TraceRecorder::kAnalysisTrack, QStringLiteral("thumbnail"), QStringLiteral("network"));
     thumbReply = thumbManager->get(request);
     connect(thumbReply, &QNetworkReply::finished, this, &MainWindow::onThumbFinished);
 }
 
 void MainWindow::onThumbFinished() {
+    const StallWatchdog::Scope scope(watchdog, "onThumbFinished");
     if (!thumbReply) {
         return;
     }
 
     QNetworkReply *reply = thumbReply;
     thumbReply = nullptr;
+    trace.endSpan(TraceRecorder::kAnalysisTrack);
 
     disconnect(reply, &QNetworkReply::finished, this, &MainWindow::onThumbFinished);
 
@@ -680,17 +1157,72 @@ void MainWindow::onThumbFinished() {
         return;
     }
 
-    QPixmap pix;
-    if (!pix.loadFromData(data)) {
+    // Decoding at the label's size avoids holding a full-resolution pixmap for a 420px preview.
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    const QSize source = reader.size();
+    if (source.isValid()) {
+        reader.setScaledSize(source.scaled(thumbLabel->size(), Qt::KeepAspectRatio));
+    }
+    QImage image = reader.read();
+    if (image.isNull()) {
         thumbLabel->setText(QStringLiteral("No thumbnail"));
         return;
     }
-
-    const QPixmap scaled = pix.scaled(thumbLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    thumbLabel->setPixmap(scaled);
+    if (!source.isValid()) {
+        image = image.scaled(thumbLabel->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    thumbLabel->setPixmap(QPixmap::fromImage(image));
     thumbLabel->setText(QString());
 }
 
+// Only rows in the viewport, plus one page below it, hold a tile; the loader fetches those first
+// and drops requests for rows that scrolled away.
+void MainWindow::refreshVisibleTiles() {
+    const StallWatchdog::Scope scope(watchdog, "refreshVisibleTiles");
+    const QRect viewport = jobList->viewport()->rect();
+    const int limit = viewport.bottom() + viewport.height();
+    QList<int> visible;
+    for (QTreeWidgetItem *item = jobList->itemAt(viewport.topLeft()); item; item = jobList->itemBelow(item)) {
+        if (jobList->visualItemRect(item).top() > limit) {
+            break;
+        }
+        visible.append(item->data(JobIdColumn, Qt::UserRole).toInt());
+    }
+
+    const QSet<int> range(visible.cbegin(), visible.cend());
+    for (int id : std::as_const(tileJobs)) {
+        QTreeWidgetItem *item = jobItems.value(id);
+        if (item && !range.contains(id)) {
+            item->setIcon(JobNameColumn, QIcon());
+        }
+    }
+    tileJobs = range;
+    for (int id : visible) {
+        const QImage tile = thumbTiles->tile(id);
+        if (!tile.isNull()) {
+            onTileReady(id, tile);
+        }
+    }
+    thumbTiles->setVisible(visible);
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (watched == jobList->viewport() && event->type() == QEvent::Resize) {
+        tileTimer.start();
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::onTileReady(int id, const QImage &tile) {
+    QTreeWidgetItem *item = jobItems.value(id);
+    if (item && tileJobs.contains(id)) {
+        item->setIcon(JobNameColumn, QIcon(QPixmap::fromImage(tile)));
+    }
+}
+
 QList<std::optional<QString>> MainWindow::buildCookieAttempts() const {
     QList<std::optional<QString>> attempts;
 
@@ -729,7 +1261,7 @@ QList<std::optional<QString>> MainWindow::buildCookieAttempts() const {
 }
 
 void MainWindow::analyzeUrl() {
-    if (metaProc && metaProc->state() != QProcess::NotRunning) {
+    if (metaProc) {
         QMessageBox::information(this, QStringLiteral("In progress"), QStringLiteral("Metadata analysis is already running."));
         return;
     }
@@ -746,6 +1278,7 @@ void MainWindow::analyzeUrl() {
     metaAttempts = buildCookieAttempts();
     metaCurrentBrowser.reset();
     metaRaw.clear();
+    metaForceFull = false;
     btnAnalyze->setEnabled(false);
 
     startNextAnalysisAttempt();
@@ -770,48 +1303,60 @@ void MainWindow::startNextAnalysisAttempt() {
     const std::optional<QString> browser = metaAttempts.takeFirst();
     metaCurrentBrowser = browser;
     metaRaw.clear();
-
-    QStringList args{QStringLiteral("-J"), QStringLiteral("--ignore-config"), QStringLiteral("--no-warnings")};
+    metaUsedJar = false;
+    metaExporting = false;
+
+    metaLean = !metaForceFull && settings.value(QStringLiteral("analysis/lean"), true).toBool();
+    QStringList args;
+    if (metaLean) {
+        metaFields = leanInfoFields(templateEdit->text().trimmed());
+        args << QStringLiteral("-O") << kLeanInfoTemplate.arg(metaFields.join(QLatin1Char(',')));
+    } else {
+        metaFields.clear();
+        args << QStringLiteral("-J");
+    }
+    args << QStringLiteral("--ignore-config") << QStringLiteral("--no-warnings");
+    if (!metaInfoPath.isEmpty()) {
+        QFile::remove(metaInfoPath);
+        metaInfoPath.clear();
+    }
+    if (infoDir.isValid() && settings.value(QStringLiteral("analysis/reuseInfoJson"), true).toBool()) {
+        // The full info dict goes to a file for --load-info-json; stdout still carries only what the UI parses.
+        metaInfoPath = infoDir.filePath(QStringLiteral("analysis-%1.json").arg(QDateTime::currentMSecsSinceEpoch()));
+        args << QStringLiteral("--print-to-file") << QStringLiteral("%()j") << metaInfoPath;
+    }
     if (browser && !browser->isEmpty()) {
-        args << QStringLiteral("--cookies-from-browser") << browser.value();
-        appendLog(QStringLiteral("Trying cookies from %1…").arg(browser.value()));
+        if (const std::optional<QString> jar = cookieCache.freshJar(browser.value())) {
+            args << QStringLiteral("--cookies") << jar.value();
+            metaUsedJar = true;
+            appendLog(QStringLiteral("Trying cached cookies from %1…").arg(browser.value()));
+        } else {
+            args << QStringLiteral("--cookies-from-browser") << browser.value();
+            const QString exportPath = cookieCache.prepareExport(browser.value());
+            if (!exportPath.isEmpty()) {
+                args << QStringLiteral("--cookies") << exportPath;
+                metaExporting = true;
+            }
+            appendLog(QStringLiteral("Trying cookies from %1…").arg(browser.value()));
+        }
     } else if (cookieUserOverride && !cookieUserOverride->isEmpty()) {
         appendLog(QStringLiteral("Cookie override failed, retrying without cookies…"));
     }
 
-    metaProc = new QProcess(this);
-    metaProc->setProgram(QStringLiteral("yt-dlp"));
     QStringList fullArgs = args;
     fullArgs << metaUrl;
-    metaProc->setArguments(fullArgs);
-    metaProc->setProcessChannelMode(QProcess::MergedChannels);
-    connect(metaProc, &QProcess::readyReadStandardOutput, this, &MainWindow::onMetaReady);
-    connect(metaProc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &MainWindow::onMetaFinished);
-    metaProc->start();
+    trace.setSpan(TraceRecorder::kAnalysisTrack, kSpawnSpan, QStringLiteral("analysis"));
+    metaProc = spawnAnalysisWorker(fullArgs);
     metaTimer.start(60000);
 }
 
-void MainWindow::onMetaReady() {
-    if (!metaProc) {
+void MainWindow::onMetaLines(const QStringList &lines) {
+    const StallWatchdog::Scope scope(watchdog, "onMetaLines");
+    if (sender() != metaProc) {
         return;
     }
-
-    const QByteArray chunk = metaProc->readAllStandardOutput();
-    QString text = QString::fromUtf8(chunk);
-    text.replace(QLatin1Char('\r'), QLatin1Char('\n'));
-    metaRaw += text;
-
-    const QStringList lines = text.split(QLatin1Char('\n'));
-    for (QString line : lines) {
-        line = line.trimmed();
-        if (line.isEmpty()) {
-            continue;
-        }
-        const QString upper = line.toUpper();
-        if (upper.contains(QStringLiteral("ERROR")) || upper.contains(QStringLiteral("WARNING"))) {
-            appendLog(line);
-        }
-    }
+    traceOutputLines(TraceRecorder::kAnalysisTrack, lines);
+    appendLogEntries(lines);
 }
 
 void MainWindow::logMetaFailureOutput(const QString &raw) {
@@ -827,31 +1372,61 @@ void MainWindow::logMetaFailureOutput(const QString &raw) {
     appendLog(text);
 }
 
-void MainWindow::onMetaFinished(int exitCode, QProcess::ExitStatus exitStatus) {
+void MainWindow::onMetaFinished(int exitCode, QProcess::ExitStatus exitStatus, const QJsonObject &data, bool parsed, const QString &raw,
+                                qint64 payloadBytes, qint64 parseMicros) {
+    const StallWatchdog::Scope scope(watchdog, "onMetaFinished");
+    if (sender() != metaProc) {
+        return;
+    }
     metaTimer.stop();
     cleanupMetaProcess();
+    trace.endSpan(TraceRecorder::kAnalysisTrack);
+    if (parsed) {
+        trace.complete(TraceRecorder::kAnalysisTrack, metaLean ? QStringLiteral("parse compact") : QStringLiteral("parse -J"),
+                       QStringLiteral("analysis"), trace.nowUs() - parseMicros, parseMicros);
+    }
 
-    const QString raw = metaRaw.trimmed();
+    metaRaw = raw;
     const bool ok = exitStatus == QProcess::NormalExit && exitCode == 0;
-
-    QJsonObject data;
-    bool parsed = false;
-    if (!raw.isEmpty()) {
-        const int first = raw.indexOf(QLatin1Char('{'));
-        const int last = raw.lastIndexOf(QLatin1Char('}'));
-        if (first != -1 && last != -1 && last > first) {
-            const QString candidate = raw.mid(first, last - first + 1);
-            QJsonParseError err{};
-            const QJsonDocument doc = QJsonDocument::fromJson(candidate.toUtf8(), &err);
-            if (err.error == QJsonParseError::NoError && doc.isObject()) {
-                data = doc.object();
-                parsed = true;
-            }
+    if (metaExporting && metaCurrentBrowser) {
+        if (ok) {
+            cookieCache.commitExport(metaCurrentBrowser.value());
+        } else {
+            cookieCache.discardExport(metaCurrentBrowser.value());
         }
+        metaExporting = false;
     }
 
     if (ok && parsed) {
-        handleAnalysisSuccess(data);
+        appendLog(QStringLiteral("Metadata: %1 parsed in %2 ms (%3)")
+                      .arg(QLocale().formattedDataSize(payloadBytes))
+                      .arg(static_cast<double>(parseMicros) / 1000.0, 0, 'f', 1)
+                      .arg(metaLean ? QStringLiteral("compact") : QStringLiteral("full -J")),
+                  LogSeverity::Debug);
+        if (!metaLean) {
+            handleAnalysisSuccess(data);
+            return;
+        }
+        if (const std::optional<QJsonObject> expanded = expandLeanInfo(data)) {
+            handleAnalysisSuccess(expanded.value());
+            return;
+        }
+    }
+
+    if (ok && metaLean) {
+        appendLog(QStringLiteral("Compact metadata unavailable; retrying with full -J…"));
+        metaForceFull = true;
+        metaAttempts.prepend(metaCurrentBrowser);
+        startNextAnalysisAttempt();
+        return;
+    }
+
+    // Only a sign-in failure says anything about the jar; network errors and unavailable videos would fail the same with fresh cookies.
+    if (!ok && metaUsedJar && metaCurrentBrowser && classifyFailure(exitCode, raw.split(QLatin1Char('\n'))) == FailureKind::Auth) {
+        appendLog(QStringLiteral("Cached cookies for %1 failed; reading the browser again…").arg(metaCurrentBrowser.value()));
+        cookieCache.invalidate(metaCurrentBrowser.value());
+        metaAttempts.prepend(metaCurrentBrowser);
+        startNextAnalysisAttempt();
         return;
     }
 
@@ -876,17 +1451,98 @@ void MainWindow::onMetaTimeout() {
         return;
     }
     appendLog(QStringLiteral("Metadata fetch timed out; trying next option…"));
-    metaProc->kill();
+    QMetaObject::invokeMethod(metaProc, &ProcessWorker::kill, Qt::QueuedConnection);
 }
 
 void MainWindow::cleanupMetaProcess() {
-    if (metaProc) {
-        metaProc->disconnect(this);
-        if (metaProc->state() != QProcess::NotRunning) {
-            metaProc->kill();
+    releaseWorker(metaProc);
+}
+
+ProcessWorker *MainWindow::spawnAnalysisWorker(const QStringList &args) {
+    auto *worker = new ProcessWorker(ProcessWorker::Mode::Analysis);
+    worker->moveToThread(&ioThread);
+    connect(worker, &ProcessWorker::logLines, this, &MainWindow::onMetaLines);
+    connect(worker, &ProcessWorker::analysisFinished, this, &MainWindow::onMetaFinished);
+    QMetaObject::invokeMethod(worker, [worker, args]() {
+        worker->start(QStringLiteral("yt-dlp"), args);
+    }, Qt::QueuedConnection);
+    return worker;
+}
+
+void MainWindow::releaseWorker(ProcessWorker *&worker) {
+    if (!worker) {
+        return;
+    }
+    worker->disconnect(this);
+    QMetaObject::invokeMethod(worker, &ProcessWorker::kill, Qt::QueuedConnection);
+    worker->deleteLater();
+    worker = nullptr;
+}
+
+void MainWindow::toggleTrace() {
+    if (!trace.isRecording()) {
+        trace.start();
+        appendLog(QStringLiteral("Tracing started; press Ctrl+Shift+T again to save."));
+        return;
+    }
+    trace.stop();
+    saveTrace();
+}
+
+bool MainWindow::saveTrace() {
+    const QString dir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath(QStringLiteral("traces"));
+    const QString path = QDir(dir).filePath(QStringLiteral("trace-%1.json").arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss"))));
+    QString error;
+    if (!trace.write(path, &error)) {
+        appendLog(QStringLiteral("Could not write trace: %1").arg(error), LogSeverity::Warning);
+        return false;
+    }
+    appendLog(QStringLiteral("Trace saved (open in ui.perfetto.dev or chrome://tracing): %1").arg(QDir::toNativeSeparators(path)));
+    return true;
+}
+
+void MainWindow::traceJobState(const Job &job) {
+    if (!trace.isRecording()) {
+        return;
+    }
+    const int track = TraceRecorder::jobTrack(job.id);
+    const QString current = trace.openSpan(track);
+    switch (job.state) {
+    case JobState::Downloading:
+        if (!kProcessSpans.contains(current)) {
+            trace.setSpan(track, current == jobStateName(JobState::Paused) ? QStringLiteral("resumed") : kSpawnSpan, QStringLiteral("yt-dlp"));
+        }
+        break;
+    case JobState::PostProcessing:
+        trace.setSpan(track, QStringLiteral("ffmpeg post-process"), QStringLiteral("ffmpeg"));
+        break;
+    case JobState::Done:
+    case JobState::Failed:
+    case JobState::Cancelled:
+        trace.endSpan(track);
+        trace.instant(track, jobStateName(job.state), QStringLiteral("job"));
+        break;
+    default:
+        trace.setSpan(track, jobStateName(job.state), QStringLiteral("queue"));
+        break;
+    }
+}
+
+// Cookie decryption and format selection only show up in yt-dlp's output, not as worker phases.
+void MainWindow::traceOutputLines(int track, const QStringList &lines) {
+    if (!trace.isRecording()) {
+        return;
+    }
+    for (const QString &line : lines) {
+        const QString current = trace.openSpan(track);
+        if (line.startsWith(QStringLiteral("Extracting cookies from")) || line.startsWith(QStringLiteral("[Cookies]"))) {
+            trace.setSpan(track, kCookiesSpan, QStringLiteral("yt-dlp"));
+        } else if ((current == kCookiesSpan || current == kSpawnSpan) && line.startsWith(QLatin1Char('['))) {
+            trace.setSpan(track, kExtractSpan, QStringLiteral("yt-dlp"));
+        }
+        if (line.startsWith(QStringLiteral("[info]"))) {
+            trace.instant(track, line.left(120), QStringLiteral("yt-dlp"));
         }
-        metaProc->deleteLater();
-        metaProc = nullptr;
     }
 }
 
@@ -897,9 +1553,63 @@ void MainWindow::resetAnalysisState() {
     metaCurrentBrowser.reset();
     metaRaw.clear();
     metaUrl.clear();
+    if (!metaInfoPath.isEmpty()) {
+        QFile::remove(metaInfoPath);
+        metaInfoPath.clear();
+    }
     btnAnalyze->setEnabled(true);
 }
 
+void MainWindow::adoptInfoJson() {
+    if (!analyzedInfoJson.isEmpty()) {
+        QFile::remove(analyzedInfoJson);
+        analyzedInfoJson.clear();
+    }
+    analyzedInfoExpiry = 0;
+    const QString path = std::exchange(metaInfoPath, QString());
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QByteArray data = file.readAll().trimmed();
+    file.close();
+    // Playlists print one object per entry, which --load-info-json cannot take.
+    if (data.isEmpty() || data.contains('\n')) {
+        QFile::remove(path);
+        return;
+    }
+    analyzedInfoJson = path;
+    analyzedInfoAt = QDateTime::currentSecsSinceEpoch();
+    analyzedInfoExpiry = earliestUrlExpiry(data);
+}
+
+QString MainWindow::checkoutInfoJson() {
+    if (analyzedInfoJson.isEmpty() || !settings.value(QStringLiteral("analysis/reuseInfoJson"), true).toBool()) {
+        return QString();
+    }
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const qint64 maxAge = settings.value(QStringLiteral("analysis/reuseMaxAgeMinutes"), 30).toLongLong() * 60;
+    if (now - analyzedInfoAt > maxAge || (analyzedInfoExpiry > 0 && analyzedInfoExpiry - now < kInfoExpiryMarginSecs)) {
+        appendLog(QStringLiteral("Analyzed format URLs are stale; yt-dlp will extract the page again."), LogSeverity::Debug);
+        return QString();
+    }
+    QFile source(analyzedInfoJson);
+    if (!source.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    // Jobs can outlive the next analysis, so each one gets its own copy.
+    QTemporaryFile copy(infoDir.filePath(QStringLiteral("job-XXXXXX.json")));
+    copy.setAutoRemove(false);
+    if (!copy.open()) {
+        return QString();
+    }
+    if (copy.write(source.readAll()) < 0) {
+        copy.remove();
+        return QString();
+    }
+    return copy.fileName();
+}
+
 void MainWindow::handleAnalysisSuccess(const QJsonObject &object) {
     const std::optional<QString> browser = metaCurrentBrowser;
     activeBrowser = browser;
@@ -917,6 +1627,9 @@ void MainWindow::handleAnalysisSuccess(const QJsonObject &object) {
 
     refreshCookieChoices();
 
+    analyzedUrl = metaUrl;
+    analyzedFields = metaFields;
+    adoptInfoJson();
     resetAnalysisState();
 
     populateFormatsFromInfo(object);
@@ -925,105 +1638,71 @@ void MainWindow::handleAnalysisSuccess(const QJsonObject &object) {
     updateThumbnail();
 
     const QString title = object.value(QStringLiteral("title")).toString();
+    analyzedInfo = object;
+    analyzedInfo.remove(QStringLiteral("formats"));
+    populateChapters(object);
+    updateTemplatePreview();
     if (!title.isEmpty()) {
         appendLog(title);
     }
+    // The parsed payload is released once onMetaFinished returns; hand its pages back to the OS then.
+    QTimer::singleShot(0, this, [this]() {
+        releaseFreeHeap();
+        appendLog(QStringLiteral("Memory after analysis: %1").arg(memorySummary(sampleMemory())), LogSeverity::Debug);
+    });
 }
 
-void MainWindow::populateFormatsFromInfo(const QJsonObject &object) {
-    formats.clear();
-    videoMap.clear();
-    audioMap.clear();
-    rowsById.clear();
-    videoCombo->clear();
-    audioCombo->clear();
-
-    const QJsonArray formatArray = object.value(QStringLiteral("formats")).toArray();
-    for (const QJsonValue &value : formatArray) {
-        if (!value.isObject()) {
-            continue;
-        }
-        const QJsonObject f = value.toObject();
-
-        FormatRow row;
-        row.fid = f.value(QStringLiteral("format_id")).toVariant().toString();
-        row.ext = f.value(QStringLiteral("ext")).toString();
-        row.vcodec = f.value(QStringLiteral("vcodec")).toString();
-        if (row.vcodec.isEmpty()) {
-            row.vcodec = QStringLiteral("none");
-        }
-        row.acodec = f.value(QStringLiteral("acodec")).toString();
-        if (row.acodec.isEmpty()) {
-            row.acodec = QStringLiteral("none");
-        }
-        if (!f.value(QStringLiteral("height")).isNull()) {
-            row.height = f.value(QStringLiteral("height")).toInt();
-        }
-        if (!f.value(QStringLiteral("fps")).isNull()) {
-            row.fps = f.value(QStringLiteral("fps")).toDouble();
-        }
-        if (!f.value(QStringLiteral("tbr")).isNull()) {
-            row.tbr = f.value(QStringLiteral("tbr")).toDouble();
-        }
-        row.formatNote = f.value(QStringLiteral("format_note")).toString();
-
-        if (row.fid.isEmpty()) {
-            continue;
-        }
-
-        if (row.isVideo()) {
-            videoMap.append(row);
-        } else if (row.isAudio()) {
-            audioMap.append(row);
-        }
-        formats.append(row);
-        rowsById.insert(row.fid, row);
+void MainWindow::checkMemory() {
+    const MemorySample sample = sampleMemory();
+    const qint64 peak = std::max(sample.residentBytes, sample.peakResidentBytes);
+    if (memoryBudgetWarned || peak <= memoryBudgetBytes) {
+        return;
     }
+    memoryBudgetWarned = true;
+    appendLog(QStringLiteral("Memory above the %1 budget (diagnostics/memoryBudgetMB): %2")
+                  .arg(QLocale().formattedDataSize(memoryBudgetBytes), memorySummary(sample)),
+              LogSeverity::Warning);
+}
 
-    std::sort(videoMap.begin(), videoMap.end(), [](const FormatRow &a, const FormatRow &b) {
-        const int ah = a.height.value_or(0);
-        const int bh = b.height.value_or(0);
-        if (ah == bh) {
-            return a.tbr.value_or(0.0) > b.tbr.value_or(0.0);
-        }
-        return ah > bh;
-    });
-
-    std::sort(audioMap.begin(), audioMap.end(), [](const FormatRow &a, const FormatRow &b) {
-        return a.tbr.value_or(0.0) > b.tbr.value_or(0.0);
-    });
+void MainWindow::populateChapters(const QJsonObject &object) {
+    analyzedChapters = chaptersFromInfo(object.value(QStringLiteral("chapters")).toArray(), object.value(QStringLiteral("duration")).toDouble());
+    chapterCombo->blockSignals(true);
+    chapterCombo->clear();
+    chapterCombo->addItem(analyzedChapters.isEmpty() ? QStringLiteral("No chapters") : QStringLiteral("Chapter…"), -1);
+    for (qsizetype i = 0; i < analyzedChapters.size(); ++i) {
+        const SectionRange &chapter = analyzedChapters.at(i);
+        chapterCombo->addItem(QStringLiteral("%1  %2").arg(formatTimestamp(chapter.start), chapter.title), static_cast<int>(i));
+    }
+    chapterCombo->setEnabled(!analyzedChapters.isEmpty());
+    splitChaptersCheck->setEnabled(analyzedChapters.size() > 1);
+    chapterCombo->blockSignals(false);
+    sectionEdit->clear();
+    updateSectionEstimate();
+}
 
+void MainWindow::populateFormatsFromInfo(const QJsonObject &object) {
+    const StallWatchdog::Scope scope(watchdog, "populateFormatsFromInfo");
     videoCombo->blockSignals(true);
-    for (const FormatRow &row : std::as_const(videoMap)) {
-        QString label = row.videoLabel();
-        if (row.isProgressive()) {
-            label += QStringLiteral(" [with audio]");
-        }
-        videoCombo->addItem(label, row.fid);
-    }
+    audioCombo->blockSignals(true);
+    videoModel->beginReload();
+    audioModel->beginReload();
+    formatStore.populate(object.value(QStringLiteral("formats")).toArray());
+    videoModel->endReload();
+    audioModel->endReload();
     if (videoCombo->count() > 0) {
         videoCombo->setCurrentIndex(0);
     }
-    videoCombo->blockSignals(false);
-
-    audioCombo->blockSignals(true);
-    for (const FormatRow &row : std::as_const(audioMap)) {
-        audioCombo->addItem(row.audioLabel(), row.fid);
-    }
     if (audioCombo->count() > 0) {
         audioCombo->setCurrentIndex(0);
     }
+    videoCombo->blockSignals(false);
     audioCombo->blockSignals(false);
 
     onVideoChanged(videoCombo->currentIndex());
+    updatePostPlan();
 }
 
 void MainWindow::startDownload() {
-    if (proc && proc->state() != QProcess::NotRunning) {
-        QMessageBox::warning(this, QStringLiteral("In progress"), QStringLiteral("A download is already in progress."));
-        return;
-    }
-
     const QString url = urlEdit->text().trimmed();
     if (url.isEmpty()) {
         QMessageBox::warning(this, QStringLiteral("Error"), QStringLiteral("Enter a URL."));
@@ -1042,22 +1721,50 @@ void MainWindow::startDownload() {
 
     QString tpl = templateEdit->text().trimmed();
     if (tpl.isEmpty()) {
-        tpl = QStringLiteral("%(title)s-%(id)s.%(ext)s");
+        tpl = kDefaultTemplate;
+    }
+
+    const QString scratchDir = scratchDirEdit->text().trimmed();
+    if (!scratchDir.isEmpty() && !QDir().mkpath(scratchDir)) {
+        QMessageBox::warning(this, QStringLiteral("Error"), QStringLiteral("Scratch directory cannot be created."));
+        return;
     }
-    const QString outTemplate = QDir(outDir).filePath(tpl);
 
     const bool isAudioOnly = audioOnlyCheck->isChecked();
     const QString container = containerCombo->currentText();
     const bool useAria = ariaCheck->isChecked();
     const int conn = ariaConn->value();
+    const bool embedThumb = embedThumbCheck->isChecked();
+    const bool pipelinePost = settings.value(QStringLiteral("queue/pipelinePost"), true).toBool();
+
+    JobSpec spec;
+    spec.url = url;
+    const QJsonObject info = url == analyzedUrl ? analyzedInfo : QJsonObject();
+    const QString title = info.value(QStringLiteral("title")).toString();
+    spec.label = title.isEmpty() ? url : title;
+    if (url == analyzedUrl) {
+        spec.thumbnailUrl = thumbnailUrl;
+    }
+
+    const double duration = info.value(QStringLiteral("duration")).toDouble();
+    std::optional<SectionRange> section;
+    if (!sectionEdit->text().trimmed().isEmpty()) {
+        section = parseSectionRange(sectionEdit->text(), duration);
+        if (!section) {
+            QMessageBox::warning(this, QStringLiteral("Error"), QStringLiteral("Invalid section. Use start-end, e.g. 1:02:00-1:04:30."));
+            return;
+        }
+        spec.sectionSeconds = section->length();
+        spec.label += QStringLiteral(" [%1]").arg(formatSectionRange(section.value()));
+    }
+    spec.outputDir = outDir;
+    spec.outputTemplate = tpl;
+    spec.concurrentFragments = fragmentsSpin->value();
+    spec.priority = static_cast<JobPriority>(priorityCombo->currentData().toInt());
+    spec.scratchDir = scratchDir;
 
-    QStringList args{QStringLiteral("--newline"),
-                     QStringLiteral("--ignore-config"),
-                     QStringLiteral("--no-warnings"),
-                     QStringLiteral("-o"),
-                     outTemplate};
-
-    args << cookiesArgs();
+    QStringList &args = spec.args;
+    args << QStringLiteral("--newline") << QStringLiteral("--ignore-config") << QStringLiteral("--no-warnings");
 
     if (isAudioOnly) {
         if (audioCombo->count() == 0) {
@@ -1066,135 +1773,437 @@ void MainWindow::startDownload() {
         }
         const QString aId = audioCombo->currentData().toString();
         args << QStringLiteral("-f") << aId;
+        const FormatRow *row = audioModel->rowAt(audioCombo->currentIndex());
+        if (row) {
+            spec.protocol = row->protocol;
+            spec.estimatedBytes = row->filesize.value_or(0);
+            spec.streamBytes = {spec.estimatedBytes};
+        }
+        spec.needsMerge = embedThumb;
+
+        const QString audioFormat = audioFormatCombo->currentText();
+        if (audioFormat != QStringLiteral("original") && section) {
+            args << QStringLiteral("-x") << QStringLiteral("--audio-format") << audioFormat;
+            spec.postKind = PostKind::ExtractAudio;
+        } else if (audioFormat != QStringLiteral("original") && settings.value(QStringLiteral("stream/enabled"), true).toBool()) {
+            if (info.isEmpty()) {
+                appendLog(QStringLiteral("Analyze the URL first to stream into %1; downloading the original file instead.").arg(audioFormat),
+                          LogSeverity::Warning);
+            } else {
+                spec.stream.enabled = true;
+                spec.stream.format = audioFormat;
+                spec.stream.sourceCodec = row ? row->acodec : QString();
+                spec.stream.fileName = expandBasicTemplate(tpl, info);
+                spec.needsMerge = false;
+            }
+        }
     } else {
         if (videoCombo->count() == 0) {
             QMessageBox::warning(this, QStringLiteral("Missing"), QStringLiteral("Select a video."));
             return;
         }
         const QString vId = videoCombo->currentData().toString();
-        bool progressive = false;
-        const auto it = rowsById.constFind(vId);
-        if (it != rowsById.constEnd()) {
-            progressive = it.value().isProgressive();
+        const FormatRow *row = videoModel->rowAt(videoCombo->currentIndex());
+        const bool progressive = row && row->isProgressive();
+        if (row) {
+            spec.protocol = row->protocol;
         }
-        if (progressive) {
-            args << QStringLiteral("-f") << vId;
-        } else {
+        QString aId;
+        if (!progressive) {
             if (audioCombo->count() == 0) {
                 QMessageBox::warning(this, QStringLiteral("Missing"), QStringLiteral("No audio tracks for the selected item."));
                 return;
             }
-            const QString aId = audioCombo->currentData().toString();
-            args << QStringLiteral("-f") << (vId + QStringLiteral("+") + aId);
+            aId = audioCombo->currentData().toString();
+        }
+
+        const FormatRow *audioRow = aId.isEmpty() ? nullptr : audioModel->rowAt(audioCombo->currentIndex());
+        if (row && row->filesize && (!audioRow || audioRow->filesize)) {
+            spec.estimatedBytes = row->filesize.value() + (audioRow ? audioRow->filesize.value() : 0);
+        }
+        // yt-dlp fetches the video stream first, then the audio stream.
+        spec.streamBytes = {row ? row->filesize.value_or(0) : 0};
+        if (audioRow) {
+            spec.streamBytes << audioRow->filesize.value_or(0);
         }
-        if (container != QStringLiteral("auto")) {
-            args << QStringLiteral("--remux-video") << container;
+        const RemuxPlan plan = planRemux(formatStore, row, audioRow, container);
+        spec.needsMerge = plan.cost != PostCost::None || embedThumb;
+
+        // The staged ffmpeg pass only stream-copies; anything needing a transcode goes through yt-dlp.
+        spec.post.enabled = pipelinePost && plan.cost == PostCost::StreamCopy;
+        if (spec.post.enabled) {
+            spec.post.videoId = vId;
+            spec.post.audioId = aId;
+            spec.post.container = container;
+            spec.post.embedThumbnail = embedThumb;
+            spec.post.durationSeconds = info.value(QStringLiteral("duration")).toDouble();
+            args << QStringLiteral("-f") << (aId.isEmpty() ? vId : vId + QStringLiteral(",") + aId);
+            if (embedThumb) {
+                args << QStringLiteral("--write-thumbnail") << QStringLiteral("--convert-thumbnails") << QStringLiteral("jpg");
+            }
+        } else {
+            args << QStringLiteral("-f") << (aId.isEmpty() ? vId : vId + QStringLiteral("+") + aId);
+            if (plan.cost == PostCost::Transcode) {
+                appendLog(QStringLiteral("WARNING: %1 does not take %2 as-is; re-encoding (slow, lossy)%3")
+                              .arg(plan.container, plan.transcoded.join(QStringLiteral(" + ")),
+                                   plan.copyContainer.isEmpty() ? QString() : QStringLiteral(". %1 would keep the streams").arg(plan.copyContainer)),
+                          LogSeverity::Warning);
+                args << QStringLiteral("--recode-video") << plan.container;
+                spec.postKind = PostKind::Transcode;
+            } else if (plan.merge && container != QStringLiteral("auto")) {
+                args << QStringLiteral("--merge-output-format") << container;
+            } else if (plan.remux) {
+                args << QStringLiteral("--remux-video") << container;
+            }
         }
     }
 
-    if (embedThumbCheck->isChecked()) {
+    if (embedThumb && !spec.post.enabled && !spec.stream.enabled) {
         args << QStringLiteral("--embed-thumbnail");
     }
 
-    if (useAria) {
-        const QString ariaArgs = QStringLiteral("-x%1 -s%1 -k1M --summary-interval=1 --console-log-level=warn --show-console-readout=false --enable-color=false")
-                                     .arg(conn);
-        args << QStringLiteral("--external-downloader") << QStringLiteral("aria2c")
-             << QStringLiteral("--external-downloader-args") << ariaArgs;
+    if (section) {
+        args << QStringLiteral("--download-sections") << sectionArgument(section.value());
+        if (preciseCutCheck->isChecked()) {
+            args << QStringLiteral("--force-keyframes-at-cuts");
+        }
+        if (duration > 0.0) {
+            spec.estimatedBytes = static_cast<qint64>(static_cast<double>(spec.estimatedBytes) * section->length() / duration);
+        }
+        // A section is cut by a single ffmpeg process that reads every stream at once.
+        spec.streamBytes = {spec.estimatedBytes};
+    }
+
+    if (splitChaptersCheck->isChecked() && splitChaptersCheck->isEnabled() && !section && !info.isEmpty()) {
+        const QString chapterTemplate = settings.value(QStringLiteral("postprocess/chapterTemplate"), kDefaultChapterTemplate).toString();
+        spec.chapters = planChapterCuts(analyzedChapters, chapterTemplate, info);
     }
 
-    QStringList finalArgs = args;
-    finalArgs << url;
+    if (useAria && !spec.stream.enabled && !section) {
+        spec.ariaConnections = conn;
+    }
 
-    QString summary = QStringLiteral("Starting download");
-    if (useAria) {
+    if (const std::optional<QString> predicted = predictOutputPath()) {
+        const QStringList conflicts = outputConflicts(predicted.value());
+        if (!conflicts.isEmpty()) {
+            const QMessageBox::StandardButton choice = QMessageBox::question(
+                this, QStringLiteral("Output conflict"),
+                QStringLiteral("%1\n\n%2.\n\nQueue it anyway?").arg(QDir::toNativeSeparators(predicted.value()), conflicts.join(QStringLiteral("; "))));
+            if (choice != QMessageBox::Yes) {
+                return;
+            }
+        }
+        spec.predictedPath = predicted.value();
+    }
+    if (!info.isEmpty()) {
+        spec.infoJson = checkoutInfoJson();
+    }
+    // Checking out writes a private copy of the browser's cookies, so it waits until nothing can abandon the job.
+    args << cookiesArgs(spec);
+
+    const int id = jobQueue->enqueue(spec);
+
+    QString summary = QStringLiteral("Queued download");
+    if (section) {
+        summary += QStringLiteral(" of %1 (%2)").arg(formatSectionRange(section.value()), formatTimestamp(section->length()));
+    }
+    if (spec.stream.enabled) {
+        summary += QStringLiteral(" (streamed to %1)").arg(spec.stream.format);
+    } else if (useAria) {
         summary += QStringLiteral(" (aria2c external downloader)");
     }
-    appendLog(summary + QStringLiteral("…"));
+    if (spec.post.enabled) {
+        summary += QStringLiteral(", post-processing in a separate stage");
+    }
+    appendLog(summary + QStringLiteral(": ") + spec.label, LogSeverity::Info, id);
+}
+
+void MainWindow::runControlRequests(const QList<QJsonObject> &requests) {
+    for (const QJsonObject &request : requests) {
+        const QJsonObject reply = controlServer->handleRequest(request);
+        if (!reply.value(QStringLiteral("ok")).toBool()) {
+            appendLog(QStringLiteral("Command-line request failed: %1").arg(reply.value(QStringLiteral("error")).toString()),
+                      LogSeverity::Warning);
+        }
+    }
+}
 
-    proc = new QProcess(this);
-    proc->setProgram(QStringLiteral("yt-dlp"));
-    proc->setArguments(finalArgs);
-    proc->setProcessChannelMode(QProcess::MergedChannels);
-    connect(proc, &QProcess::readyReadStandardOutput, this, &MainWindow::onProcOutput);
-    connect(proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &MainWindow::onProcFinished);
-    proc->start();
+int MainWindow::submitFromControl(const QJsonObject &request, QString *error) {
+    const QString url = request.value(QStringLiteral("url")).toString().trimmed();
+    if (url.isEmpty() || url.startsWith(QLatin1Char('-'))) {
+        *error = QStringLiteral("invalid url");
+        return 0;
+    }
 
-    btnDownload->setEnabled(false);
-    btnStop->setEnabled(true);
-    progress->setValue(0);
+    QString outDir = request.value(QStringLiteral("outputDir")).toString();
+    if (outDir.isEmpty()) {
+        outDir = outDirEdit->text().trimmed().isEmpty() ? QDir::currentPath() : outDirEdit->text().trimmed();
+    }
+    if (!QFileInfo(outDir).isDir()) {
+        *error = QStringLiteral("output directory does not exist: %1").arg(outDir);
+        return 0;
+    }
+
+    QString tpl = request.value(QStringLiteral("template")).toString();
+    if (tpl.isEmpty()) {
+        tpl = templateEdit->text().trimmed().isEmpty() ? kDefaultTemplate : templateEdit->text().trimmed();
+    }
+
+    JobSpec spec;
+    spec.url = url;
+    spec.label = request.value(QStringLiteral("label")).toString(url);
+    spec.outputDir = outDir;
+    spec.outputTemplate = tpl;
+    spec.concurrentFragments = fragmentsSpin->value();
+    spec.scratchDir = scratchDirEdit->text().trimmed();
+    if (!spec.scratchDir.isEmpty() && !QDir().mkpath(spec.scratchDir)) {
+        spec.scratchDir.clear();
+    }
+
+    const QString priority = request.value(QStringLiteral("priority")).toString(QStringLiteral("normal"));
+    if (priority == jobPriorityName(JobPriority::High)) {
+        spec.priority = JobPriority::High;
+    } else if (priority == jobPriorityName(JobPriority::Low)) {
+        spec.priority = JobPriority::Low;
+    }
+
+    QStringList &args = spec.args;
+    args << QStringLiteral("--newline") << QStringLiteral("--ignore-config") << QStringLiteral("--no-warnings");
+
+    const bool audioOnly = request.value(QStringLiteral("audioOnly")).toBool();
+    const QString format = request.value(QStringLiteral("format")).toString();
+    args << QStringLiteral("-f") << (format.isEmpty() ? (audioOnly ? QStringLiteral("ba/b") : QStringLiteral("bv*+ba/b")) : format);
+    const QString audioFormat = request.value(QStringLiteral("audioFormat")).toString();
+    if (audioOnly && !audioFormat.isEmpty() && audioFormat != QStringLiteral("original")) {
+        if (audioFormatCombo->findText(audioFormat) < 0) {
+            *error = QStringLiteral("unsupported audio format: %1").arg(audioFormat);
+            return 0;
+        }
+        args << QStringLiteral("-x") << QStringLiteral("--audio-format") << audioFormat;
+        spec.postKind = PostKind::ExtractAudio;
+    }
+    spec.needsMerge = !audioOnly;
+
+    if (ariaCheck->isChecked()) {
+        spec.ariaConnections = ariaConn->value();
+    }
+    if (spec.url == analyzedUrl) {
+        spec.infoJson = checkoutInfoJson();
+        spec.thumbnailUrl = thumbnailUrl;
+    }
+    args << cookiesArgs(spec);
+
+    const int id = jobQueue->enqueue(spec);
+    appendLog(QStringLiteral("Queued download from control socket: %1").arg(url), LogSeverity::Info, id);
+    return id;
 }
 
-void MainWindow::stopDownload() {
-    if (proc) {
-        appendLog(QStringLiteral("Stopping…"));
-        proc->kill();
+QList<int> MainWindow::selectedJobIds() const {
+    QList<int> ids;
+    for (QTreeWidgetItem *item : jobList->selectedItems()) {
+        ids << item->data(JobIdColumn, Qt::UserRole).toInt();
+    }
+    return ids;
+}
+
+void MainWindow::pauseSelected() {
+    const QList<int> ids = selectedJobIds();
+    for (int id : ids) {
+        jobQueue->pause(id);
+    }
+}
+
+void MainWindow::resumeSelected() {
+    const QList<int> ids = selectedJobIds();
+    for (int id : ids) {
+        jobQueue->resume(id);
+    }
+}
+
+void MainWindow::clearFinished() {
+    for (int id : jobQueue->jobIds()) {
+        if (!jobQueue->remove(id)) {
+            continue;
+        }
+        delete jobItems.take(id);
+        tileJobs.remove(id);
+        jobDisplay.remove(id);
+        thumbTiles->remove(id);
+        if (id == focusJobId) {
+            setFocusJob(0);
+        }
     }
+    tileTimer.start();
 }
 
-void MainWindow::onProcOutput() {
-    if (!proc) {
+void MainWindow::stopDownload() {
+    const QList<int> ids = selectedJobIds();
+    if (ids.isEmpty()) {
+        appendLog(QStringLiteral("Stopping all jobs…"));
+        jobQueue->cancelAll();
         return;
     }
+    for (int id : ids) {
+        appendLog(QStringLiteral("Stopping…"), LogSeverity::Info, id);
+        jobQueue->cancel(id);
+    }
+}
 
-    const QByteArray chunk = proc->readAllStandardOutput();
-    QString text = QString::fromUtf8(chunk);
-    text.replace(QLatin1Char('\r'), QLatin1Char('\n'));
-    const QStringList lines = text.split(QLatin1Char('\n'));
-    for (const QString &line : lines) {
-        processDownloadLine(line);
+void MainWindow::onJobAdded(int id) {
+    const Job *job = jobQueue->job(id);
+    if (!job) {
+        return;
+    }
+    auto *item = new QTreeWidgetItem(jobList);
+    item->setData(JobIdColumn, Qt::UserRole, id);
+    item->setText(JobIdColumn, QString::number(id));
+    item->setText(JobNameColumn, job->spec.label);
+    item->setToolTip(JobNameColumn, job->spec.url);
+    jobItems.insert(id, item);
+    if (!job->spec.thumbnailUrl.isEmpty()) {
+        thumbTiles->add(id, QUrl(job->spec.thumbnailUrl));
+        tileTimer.start();
+    }
+    trace.nameTrack(TraceRecorder::jobTrack(id), QStringLiteral("Job %1: %2").arg(id).arg(job->spec.label));
+    logJobCombo->addItem(QStringLiteral("Job %1").arg(id), id);
+    onJobChanged(id);
+    if (jobList->selectedItems().isEmpty()) {
+        setFocusJob(id);
     }
+    btnStop->setEnabled(true);
 }
 
-void MainWindow::processDownloadLine(const QString &line) {
-    const QString stripped = line.trimmed();
-    if (stripped.isEmpty()) {
+void MainWindow::onJobChanged(int id) {
+    const Job *job = jobQueue->job(id);
+    QTreeWidgetItem *item = jobItems.value(id);
+    if (!job || !item) {
         return;
     }
+    item->setText(JobPriorityColumn, jobPriorityName(job->spec.priority));
+    item->setText(JobStateColumn, jobStateName(job->state));
+    item->setText(JobPercentColumn, QString::number(qRound(job->percent)));
+    traceJobState(*job);
+    if (job->state == JobState::WaitingPost) {
+        setJobStatus(id, QStringLiteral("Waiting for post-processing…"));
+    } else if (job->state == JobState::Moving) {
+        setJobStatus(id, QStringLiteral("Moving to output folder…"));
+    } else if (job->state == JobState::Paused) {
+        setJobStatus(id, QStringLiteral("Paused — %p%"));
+    } else if (job->state == JobState::Downloading) {
+        setJobStatus(id, QString());
+    }
+}
 
-    const std::optional<QString> normalized = normalizeProgressLine(stripped);
-    if (normalized.has_value()) {
-        QRegularExpressionMatch match = percentRe.match(normalized.value());
-        if (match.hasMatch()) {
-            updateDownloadLogLine(normalized.value());
-        } else {
-            appendLog(normalized.value());
-            match = percentRe.match(normalized.value());
-        }
-        if (match.hasMatch()) {
-            bool ok = false;
-            const double pct = match.captured(1).toDouble(&ok);
-            if (ok && pct >= 0.0 && pct <= 100.0) {
-                progress->setValue(static_cast<int>(pct));
-            }
+void MainWindow::onJobLog(int id, const QStringList &lines) {
+    const StallWatchdog::Scope scope(watchdog, "onJobLog");
+    traceOutputLines(TraceRecorder::jobTrack(id), lines);
+    appendLogEntries(lines, id);
+}
+
+void MainWindow::onJobProgress(int id, const ProgressEvent &event) {
+    const StallWatchdog::Scope scope(watchdog, "onJobProgress");
+    if (event.percent >= 0.0) {
+        if (QTreeWidgetItem *item = jobItems.value(id)) {
+            item->setText(JobPercentColumn, QString::number(qRound(event.percent)));
         }
+    }
+    JobDisplay &display = jobDisplay[id];
+    display.bytesPerSecond = event.bytesPerSecond;
+    display.etaSeconds = event.etaSeconds;
+    if (id != focusJobId) {
         return;
     }
+    if (!event.line.isEmpty()) {
+        updateDownloadLogLine(event.line);
+    }
+    if (event.percent >= 0.0) {
+        progress->setValue(static_cast<int>(event.percent));
+    }
+    showJobProgress(id);
+}
 
-    if (shouldSkipPlainLine(stripped)) {
+void MainWindow::setJobStatus(int id, const QString &status) {
+    jobDisplay[id].status = status;
+    if (id == focusJobId) {
+        showJobProgress(id);
+    }
+}
+
+void MainWindow::showJobProgress(int id) {
+    const JobDisplay display = jobDisplay.value(id);
+    if (!display.status.isEmpty()) {
+        progress->setFormat(display.status);
         return;
     }
+    QStringList parts{QStringLiteral("%p%")};
+    if (display.bytesPerSecond > 0.0) {
+        parts << QStringLiteral("%1/s").arg(QLocale().formattedDataSize(static_cast<qint64>(display.bytesPerSecond)));
+    }
+    if (display.etaSeconds >= 0.0) {
+        parts << QStringLiteral("ETA %1").arg(formatTimestamp(std::round(display.etaSeconds)));
+    }
+    progress->setFormat(parts.join(QStringLiteral(" · ")));
+}
 
-    appendLog(stripped);
-    const QRegularExpressionMatch match = percentRe.match(stripped);
-    if (match.hasMatch()) {
-        bool ok = false;
-        const double pct = match.captured(1).toDouble(&ok);
-        if (ok && pct >= 0.0 && pct <= 100.0) {
-            progress->setValue(static_cast<int>(pct));
-        }
+void MainWindow::onJobPhase(int id, ProcessWorker::Phase phase) {
+    const Job *job = jobQueue->job(id);
+    if (trace.isRecording() && job && job->state == JobState::Downloading) {
+        trace.setSpan(TraceRecorder::jobTrack(id), phaseSpan(phase), QStringLiteral("yt-dlp"));
+    }
+    switch (phase) {
+    case ProcessWorker::Phase::Extracting:
+        setJobStatus(id, QStringLiteral("Extracting…"));
+        break;
+    case ProcessWorker::Phase::Merging:
+        setJobStatus(id, QStringLiteral("Merging…"));
+        break;
+    case ProcessWorker::Phase::PostProcessing:
+        setJobStatus(id, QStringLiteral("Post-processing…"));
+        break;
+    default:
+        setJobStatus(id, QString());
+        break;
     }
 }
 
-void MainWindow::onProcFinished(int exitCode, QProcess::ExitStatus status) {
-    Q_UNUSED(status);
-    appendLog(QStringLiteral("Finished. Code: %1").arg(exitCode));
-    if (proc) {
-        proc->disconnect(this);
-        proc->deleteLater();
-        proc = nullptr;
+void MainWindow::onJobFinished(int id, JobState state) {
+    const Job *job = jobQueue->job(id);
+    QString message = QStringLiteral("Finished (%1).").arg(jobStateName(state));
+    if (job && state == JobState::Failed) {
+        message += QStringLiteral(" Code: %1").arg(job->exitCode);
+    } else if (job && !job->outputPath.isEmpty()) {
+        message += QStringLiteral(" %1").arg(QDir::toNativeSeparators(job->outputPath));
     }
-    btnDownload->setEnabled(true);
-    btnStop->setEnabled(false);
-    progress->setValue(exitCode == 0 ? 100 : 0);
+    appendLog(message, state == JobState::Failed ? LogSeverity::Error : LogSeverity::Info, id);
+    if (job && state == JobState::Done && !job->outputPath.isEmpty() && settings.value(QStringLiteral("dedup/enabled"), true).toBool()) {
+        dedupStore->add(job->outputPath, id);
+    }
+    jobDisplay.remove(id);
+    if (id == focusJobId) {
+        progress->setFormat(QStringLiteral("%p%"));
+        progress->setValue(state == JobState::Done ? 100 : 0);
+    }
+    btnStop->setEnabled(jobQueue->hasActiveJobs());
+}
+
+void MainWindow::onJobSelectionChanged() {
+    const QList<QTreeWidgetItem *> selected = jobList->selectedItems();
+    if (selected.size() == 1) {
+        setFocusJob(selected.first()->data(JobIdColumn, Qt::UserRole).toInt());
+    }
+}
+
+void MainWindow::setFocusJob(int id) {
+    if (id == focusJobId) {
+        return;
+    }
+    focusJobId = id;
+    clearDownloadLogLine();
+    const Job *job = jobQueue->job(id);
+    showJobProgress(id);
+    progress->setValue(job ? static_cast<int>(job->percent) : 0);
+}
+
+void MainWindow::updateQueueStats() {
+    queueStatsLabel->setText(jobQueue->statsText());
 }
@@ -6,130 +6,230 @@
 #include <QJsonObject>
 #include <QMainWindow>
 #include <QProcess>
-#include <QRegularExpression>
+#include <QSet>
 #include <QSettings>
 #include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
 #include <QTimer>
 
+#include "ControlServer.h"
+#include "CookieCache.h"
+#include "DedupStore.h"
+#include "FormatModel.h"
+#include "JobQueue.h"
+#include "ProcessWorker.h"
+#include "RemuxPlanner.h"
+#include "SectionRange.h"
+#include "SessionLog.h"
+#include "StallWatchdog.h"
+#include "ThumbnailLoader.h"
+#include "TraceRecorder.h"
+
 class QCheckBox;
 class QComboBox;
 class QLineEdit;
 class QLabel;
+class QListView;
 class QNetworkAccessManager;
 class QNetworkReply;
-class QProcess;
 class QProgressBar;
 class QPushButton;
 class QSpinBox;
-class QTextEdit;
-
-struct FormatRow {
-    QString fid;
-    QString ext;
-    QString vcodec;
-    QString acodec;
-    std::optional<int> height;
-    std::optional<double> fps;
-    std::optional<double> tbr;
-    QString formatNote;
-
-    bool isVideo() const;
-    bool isAudio() const;
-    bool isProgressive() const;
-    QString videoLabel() const;
-    QString audioLabel() const;
-};
+class QTreeWidget;
+class QTreeWidgetItem;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
     explicit MainWindow(QWidget *parent = nullptr);
+    ~MainWindow() override;
+
+    void runControlRequests(const QList<QJsonObject> &requests);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void pickDir();
+    void pickScratchDir();
     void analyzeUrl();
     void startDownload();
     void stopDownload();
-    void onProcOutput();
-    void onProcFinished(int exitCode, QProcess::ExitStatus status);
+    void pauseSelected();
+    void resumeSelected();
+    void clearFinished();
+    void onJobAdded(int id);
+    void onJobChanged(int id);
+    void onJobLog(int id, const QStringList &lines);
+    void onJobProgress(int id, const ProgressEvent &event);
+    void onJobPhase(int id, ProcessWorker::Phase phase);
+    void onJobFinished(int id, JobState state);
+    void onJobSelectionChanged();
+    void updateQueueStats();
     void toggleAudioOnly(int state);
     void onVideoChanged(int index);
+    void onChapterChanged(int index);
+    void updateSectionEstimate();
+    void updateTemplatePreview();
+    void updatePostPlan();
+    void applyPostSuggestion();
     void onCookieChoiceChanged(int index);
     void updateThumbnail();
     void onThumbFinished();
-    void onMetaReady();
-    void onMetaFinished(int exitCode, QProcess::ExitStatus status);
+    void refreshVisibleTiles();
+    void onTileReady(int id, const QImage &tile);
+    void onMetaLines(const QStringList &lines);
+    void onMetaFinished(int exitCode, QProcess::ExitStatus status, const QJsonObject &data, bool parsed, const QString &raw,
+                        qint64 payloadBytes, qint64 parseMicros);
     void onMetaTimeout();
+    void checkMemory();
 
 private:
+    // What the progress bar shows for a job: a status text, or the live percent, speed and ETA when it is empty.
+    struct JobDisplay {
+        QString status;
+        double bytesPerSecond = -1.0;
+        double etaSeconds = -1.0;
+    };
+
     void setupUi();
-    void appendLog(const QString &text);
+    void appendLog(const QString &text, LogSeverity severity = LogSeverity::Info, int jobId = 0);
+    void appendLogEntries(const QStringList &entries, int jobId = 0);
     void clearDownloadLogLine();
     void updateDownloadLogLine(const QString &text);
     void refreshLogDisplay();
-    std::optional<QString> normalizeProgressLine(const QString &text) const;
-    bool shouldSkipPlainLine(const QString &text) const;
+    void applyLogFilter();
+    void copyLogSelection();
     QString defaultOutputDir() const;
     void refreshCookieChoices();
-    QStringList cookiesArgs() const;
+    QStringList cookiesArgs(JobSpec &spec);
     QStringList detectInstalledBrowsers() const;
     void startNextAnalysisAttempt();
     void cleanupMetaProcess();
     void resetAnalysisState();
     void handleAnalysisSuccess(const QJsonObject &object);
     void populateFormatsFromInfo(const QJsonObject &object);
+    void populateChapters(const QJsonObject &object);
+    void adoptInfoJson();
+    QString checkoutInfoJson();
+    std::optional<qint64> selectedFormatBytes() const;
+    QString predictedExtension(const FormatRow *video, const FormatRow *audio) const;
+    std::optional<QString> predictOutputPath(QStringList *unresolved = nullptr) const;
+    QStringList outputConflicts(const QString &path) const;
     QList<std::optional<QString>> buildCookieAttempts() const;
     void logMetaFailureOutput(const QString &raw);
-    void processDownloadLine(const QString &line);
+    ProcessWorker *spawnAnalysisWorker(const QStringList &args);
+    void releaseWorker(ProcessWorker *&worker);
+    void toggleTrace();
+    bool saveTrace();
+    void traceJobState(const Job &job);
+    void traceOutputLines(int track, const QStringList &lines);
+    void setFocusJob(int id);
+    void setJobStatus(int id, const QString &status);
+    void showJobProgress(int id);
+    QList<int> selectedJobIds() const;
+    int submitFromControl(const QJsonObject &request, QString *error);
 
     QLineEdit *urlEdit;
     QPushButton *btnAnalyze;
     QPushButton *btnDownload;
     QPushButton *btnStop;
+    QPushButton *btnPause;
+    QPushButton *btnResume;
+    QPushButton *btnClear;
+    QComboBox *priorityCombo;
     QLineEdit *outDirEdit;
     QPushButton *btnBrowse;
+    QLineEdit *scratchDirEdit;
+    QPushButton *btnScratchBrowse;
     QLineEdit *templateEdit;
+    QLabel *templatePreviewLabel;
     QComboBox *videoCombo;
     QComboBox *audioCombo;
     QComboBox *containerCombo;
+    QComboBox *audioFormatCombo;
     QCheckBox *audioOnlyCheck;
     QCheckBox *ariaCheck;
     QSpinBox *ariaConn;
+    QSpinBox *fragmentsSpin;
     QCheckBox *embedThumbCheck;
+    QCheckBox *splitChaptersCheck;
+    QLineEdit *sectionEdit;
+    QComboBox *chapterCombo;
+    QCheckBox *preciseCutCheck;
+    QLabel *sectionSizeLabel;
+    QLabel *postCostLabel;
+    QPushButton *btnPostSuggestion;
     QLabel *thumbLabel;
     QComboBox *cookiesCombo;
     QProgressBar *progress;
-    QTextEdit *logView;
+    QTreeWidget *jobList;
+    QSpinBox *parallelSpin;
+    QLabel *queueStatsLabel;
+    QListView *logView;
+    QLineEdit *logFilterEdit;
+    QComboBox *logSeverityCombo;
+    QComboBox *logJobCombo;
     QNetworkAccessManager *thumbManager;
     QNetworkReply *thumbReply;
+    ThumbnailLoader *thumbTiles;
     QSettings settings;
-    QProcess *proc;
-    QProcess *metaProc;
+    QThread ioThread;
+    ProcessWorker *metaProc;
+    JobQueue *jobQueue;
+    ControlServer *controlServer;
+    DedupStore *dedupStore;
     QTimer metaTimer;
-
-    QStringList logMessages;
-    QString downloadProgressLine;
-
-    QList<FormatRow> formats;
-    QList<FormatRow> videoMap;
-    QList<FormatRow> audioMap;
-    QHash<QString, FormatRow> rowsById;
+    TraceRecorder trace;
+    StallWatchdog watchdog;
+    QTimer memoryTimer;
+    qint64 memoryBudgetBytes;
+    bool memoryBudgetWarned;
+
+    SessionLog sessionLog;
+    SessionLogModel *logModel;
+    QTimer logFilterTimer;
+    bool logFollowTail;
+
+    QHash<int, QTreeWidgetItem *> jobItems;
+    QHash<int, JobDisplay> jobDisplay;
+    int focusJobId;
+    QSet<int> tileJobs;
+    QTimer tileTimer;
+
+    FormatStore formatStore;
+    FormatListModel *videoModel;
+    FormatListModel *audioModel;
 
     QString thumbnailUrl;
+    QString analyzedUrl;
+    QJsonObject analyzedInfo;
+    QList<SectionRange> analyzedChapters;
+    QStringList analyzedFields;
+    RemuxPlan postPlan;
+    QTemporaryDir infoDir;
+    QString analyzedInfoJson;
+    qint64 analyzedInfoAt;
+    qint64 analyzedInfoExpiry;
 
     QList<std::optional<QString>> metaAttempts;
     std::optional<QString> metaCurrentBrowser;
     QString metaRaw;
     QString metaUrl;
+    bool metaLean;
+    bool metaForceFull;
+    QStringList metaFields;
+    QString metaInfoPath;
+    bool metaUsedJar;
+    bool metaExporting;
 
     QStringList detectedBrowsers;
     std::optional<QString> activeBrowser;
     std::optional<QString> cookieUserOverride;
+    CookieCache cookieCache;
 
     bool ariaAvailable;
     const int thumbMaxBytes;
-
-    QRegularExpression percentRe;
-    QRegularExpression ariaProgressRe;
 };
@@ -0,0 +1,102 @@
+#include "MemoryProbe.h"
+
+#include <QFile>
+#include <QLocale>
+#include <QStringList>
+
+#if defined(Q_OS_LINUX)
+#include <malloc.h>
+// glibc keeps freed blocks in its arenas; mallinfo2 replaced the int-sized mallinfo in 2.33.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define YTDLPGUI_HAS_MALLINFO2 1
+#endif
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#include <sys/resource.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace {
+#if defined(Q_OS_LINUX)
+qint64 statusKilobytes(const QByteArray &status, const QByteArray &key) {
+    const qsizetype at = status.indexOf(key);
+    if (at < 0) {
+        return -1;
+    }
+    const qsizetype end = status.indexOf('\n', at);
+    bool ok = false;
+    const qint64 value = status.mid(at + key.size(), end < 0 ? -1 : end - at - key.size()).trimmed().split(' ').value(0).toLongLong(&ok);
+    return ok ? value * 1024 : -1;
+}
+#endif
+
+QString bytesText(qint64 bytes) {
+    return bytes < 0 ? QStringLiteral("n/a") : QLocale().formattedDataSize(bytes);
+}
+}
+
+MemorySample sampleMemory() {
+    MemorySample sample;
+#if defined(Q_OS_LINUX)
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (status.open(QIODevice::ReadOnly)) {
+        const QByteArray text = status.readAll();
+        sample.residentBytes = statusKilobytes(text, "VmRSS:");
+        sample.peakResidentBytes = statusKilobytes(text, "VmHWM:");
+    }
+#ifdef YTDLPGUI_HAS_MALLINFO2
+    const struct mallinfo2 info = ::mallinfo2();
+    sample.heapInUseBytes = static_cast<qint64>(info.uordblks + info.hblkhd);
+    sample.heapReservedBytes = static_cast<qint64>(info.arena + info.hblkhd);
+#endif
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        sample.residentBytes = static_cast<qint64>(info.resident_size);
+    }
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+        sample.peakResidentBytes = static_cast<qint64>(usage.ru_maxrss);
+    }
+    malloc_statistics_t stats;
+    malloc_zone_statistics(nullptr, &stats);
+    sample.heapInUseBytes = static_cast<qint64>(stats.size_in_use);
+    sample.heapReservedBytes = static_cast<qint64>(stats.size_allocated);
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        sample.residentBytes = static_cast<qint64>(counters.WorkingSetSize);
+        sample.peakResidentBytes = static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+#endif
+    return sample;
+}
+
+// Linux lets a process restart its VmHWM high-water mark; elsewhere the peak covers the whole run.
+bool resetPeakResident() {
+#if defined(Q_OS_LINUX)
+    QFile refs(QStringLiteral("/proc/self/clear_refs"));
+    return refs.open(QIODevice::WriteOnly) && refs.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+void releaseFreeHeap() {
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+    ::malloc_trim(0);
+#endif
+}
+
+QString memorySummary(const MemorySample &sample) {
+    QStringList parts;
+    parts << QStringLiteral("RSS %1 (peak %2)").arg(bytesText(sample.residentBytes), bytesText(sample.peakResidentBytes));
+    if (sample.heapInUseBytes >= 0) {
+        parts << QStringLiteral("heap %1 in use of %2").arg(bytesText(sample.heapInUseBytes), bytesText(sample.heapReservedBytes));
+    }
+    return parts.join(QStringLiteral(" · "));
+}
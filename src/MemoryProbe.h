@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QString>
+
+// Process memory as reported by the OS and the allocator; -1 where the platform has no source.
+struct MemorySample {
+    qint64 residentBytes = -1;
+    qint64 peakResidentBytes = -1;
+    qint64 heapInUseBytes = -1;
+    qint64 heapReservedBytes = -1;
+};
+
+MemorySample sampleMemory();
+bool resetPeakResident();
+void releaseFreeHeap();
+QString memorySummary(const MemorySample &sample);
@@ -0,0 +1,374 @@
+#include "OutputTemplate.h"
+
+#include <cmath>
+#include <optional>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonValue>
+#include <QLocale>
+#include <QRegularExpression>
+#include <QTimeZone>
+#include <algorithm>
+
+// Mirrors the subset of yt-dlp's output template language people actually use:
+// %(a.b,c>strftime&replacement|default)<flags><width>.<precision><type>
+
+namespace {
+const QString kPlaceholder = QStringLiteral("NA");
+const QString kNumericTypes = QStringLiteral("diouxXeEfFgG");
+
+struct Field {
+    QStringList alternatives;
+    QString dateFormat;
+    QString replacement;
+    QString fallback;
+    bool hasReplacement = false;
+    bool hasFallback = false;
+};
+
+struct Spec {
+    QString flags;
+    int width = 0;
+    int precision = -1;
+    QChar type;
+};
+
+const QRegularExpression &specRe() {
+    static const QRegularExpression re(QStringLiteral("([-0#+ ]*)(\\d*)(?:\\.(\\d+))?([diouxXeEfFgGcrsaBjlqDSUh])"));
+    return re;
+}
+
+qsizetype closingParen(const QString &text, qsizetype open) {
+    int depth = 0;
+    for (qsizetype i = open; i < text.size(); ++i) {
+        if (text.at(i) == QLatin1Char('(')) {
+            ++depth;
+        } else if (text.at(i) == QLatin1Char(')') && --depth == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+Field parseField(const QString &key) {
+    Field field;
+    QString names = key;
+    const qsizetype amp = key.indexOf(QLatin1Char('&'));
+    const qsizetype bar = key.indexOf(QLatin1Char('|'));
+    if (amp >= 0 && (bar < 0 || amp < bar)) {
+        names = key.left(amp);
+        field.hasReplacement = true;
+        const qsizetype defaultBar = key.indexOf(QLatin1Char('|'), amp + 1);
+        field.replacement = key.mid(amp + 1, defaultBar < 0 ? -1 : defaultBar - amp - 1);
+        if (defaultBar >= 0) {
+            field.hasFallback = true;
+            field.fallback = key.mid(defaultBar + 1);
+        }
+    } else if (bar >= 0) {
+        names = key.left(bar);
+        field.hasFallback = true;
+        field.fallback = key.mid(bar + 1);
+    }
+    const qsizetype gt = names.indexOf(QLatin1Char('>'));
+    if (gt >= 0) {
+        field.dateFormat = names.mid(gt + 1);
+        names = names.left(gt);
+    }
+    for (const QString &name : names.split(QLatin1Char(','))) {
+        if (!name.trimmed().isEmpty()) {
+            field.alternatives << name.trimmed();
+        }
+    }
+    return field;
+}
+
+QJsonValue lookup(const QJsonObject &info, const QString &path) {
+    QJsonValue value = info;
+    for (const QString &part : path.split(QLatin1Char('.'), Qt::SkipEmptyParts)) {
+        if (value.isObject()) {
+            value = value.toObject().value(part);
+        } else if (value.isArray()) {
+            bool ok = false;
+            int index = part.toInt(&ok);
+            const QJsonArray array = value.toArray();
+            if (!ok) {
+                return QJsonValue(QJsonValue::Undefined);
+            }
+            index = index < 0 ? static_cast<int>(array.size()) + index : index;
+            value = index >= 0 && index < array.size() ? array.at(index) : QJsonValue(QJsonValue::Undefined);
+        } else {
+            return QJsonValue(QJsonValue::Undefined);
+        }
+    }
+    return value;
+}
+
+QString plainText(const QJsonValue &value) {
+    switch (value.type()) {
+    case QJsonValue::String:
+        return value.toString();
+    case QJsonValue::Double: {
+        const double number = value.toDouble();
+        if (std::floor(number) == number && std::abs(number) < 1e15) {
+            return QString::number(static_cast<qint64>(number));
+        }
+        return QString::number(number, 'g', 15);
+    }
+    case QJsonValue::Bool:
+        return value.toBool() ? QStringLiteral("True") : QStringLiteral("False");
+    case QJsonValue::Array:
+        return QString::fromUtf8(QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact));
+    case QJsonValue::Object:
+        return QString::fromUtf8(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+    default:
+        return QString();
+    }
+}
+
+QString applyDateFormat(const QJsonValue &value, const QString &format) {
+    QDateTime when;
+    const QString text = plainText(value);
+    if (value.isDouble()) {
+        when = QDateTime::fromSecsSinceEpoch(static_cast<qint64>(value.toDouble()), QTimeZone::UTC);
+    } else if (text.size() == 8) {
+        when = QDateTime(QDate::fromString(text, QStringLiteral("yyyyMMdd")), QTime(0, 0), QTimeZone::UTC);
+    }
+    if (!when.isValid()) {
+        return text;
+    }
+    QString out;
+    for (qsizetype i = 0; i < format.size(); ++i) {
+        if (format.at(i) != QLatin1Char('%') || i + 1 >= format.size()) {
+            out += format.at(i);
+            continue;
+        }
+        const QChar code = format.at(++i);
+        const QDate date = when.date();
+        const QTime time = when.time();
+        auto two = [](int number) { return QStringLiteral("%1").arg(number, 2, 10, QLatin1Char('0')); };
+        switch (code.toLatin1()) {
+        case 'Y': out += QString::number(date.year()); break;
+        case 'y': out += two(date.year() % 100); break;
+        case 'm': out += two(date.month()); break;
+        case 'd': out += two(date.day()); break;
+        case 'H': out += two(time.hour()); break;
+        case 'M': out += two(time.minute()); break;
+        case 'S': out += two(time.second()); break;
+        case 'j': out += QStringLiteral("%1").arg(date.dayOfYear(), 3, 10, QLatin1Char('0')); break;
+        case 'b': out += QLocale::c().monthName(date.month(), QLocale::ShortFormat); break;
+        case 'B': out += QLocale::c().monthName(date.month()); break;
+        case 'a': out += QLocale::c().dayName(date.dayOfWeek(), QLocale::ShortFormat); break;
+        case 'A': out += QLocale::c().dayName(date.dayOfWeek()); break;
+        case '%': out += QLatin1Char('%'); break;
+        default: out += QLatin1Char('%') + code; break;
+        }
+    }
+    return out;
+}
+
+QString truncateUtf8(const QString &text, int bytes) {
+    QByteArray utf8 = text.toUtf8();
+    if (utf8.size() <= bytes) {
+        return text;
+    }
+    utf8.truncate(bytes);
+    // Drop a multi-byte sequence cut in half.
+    qsizetype lead = utf8.size() - 1;
+    while (lead > 0 && (static_cast<unsigned char>(utf8.at(lead)) & 0xC0) == 0x80) {
+        --lead;
+    }
+    if (lead >= 0) {
+        const auto first = static_cast<unsigned char>(utf8.at(lead));
+        const int length = first < 0x80 ? 1 : first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+        if (utf8.size() - lead < length) {
+            utf8.truncate(lead);
+        }
+    }
+    return QString::fromUtf8(utf8);
+}
+
+QString pad(const QString &text, const Spec &spec) {
+    if (text.size() >= spec.width) {
+        return text;
+    }
+    if (spec.flags.contains(QLatin1Char('-'))) {
+        return text.leftJustified(spec.width);
+    }
+    return text.rightJustified(spec.width);
+}
+
+std::optional<QString> formatNumber(const QJsonValue &value, const Spec &spec) {
+    bool ok = value.isDouble();
+    double number = value.toDouble();
+    if (!ok && value.isString()) {
+        number = value.toString().toDouble(&ok);
+    }
+    if (!ok) {
+        return std::nullopt;
+    }
+    const char type = spec.type.toLatin1();
+    QString digits;
+    if (type == 'd' || type == 'i' || type == 'u') {
+        digits = QString::number(static_cast<qint64>(number));
+    } else if (type == 'x' || type == 'X' || type == 'o') {
+        digits = QString::number(static_cast<qint64>(number), type == 'o' ? 8 : 16);
+        if (type == 'X') {
+            digits = digits.toUpper();
+        }
+    } else {
+        digits = QString::number(number, type, spec.precision < 0 ? 6 : spec.precision);
+    }
+    if (spec.flags.contains(QLatin1Char('+')) && number >= 0) {
+        digits.prepend(QLatin1Char('+'));
+    }
+    if (spec.flags.contains(QLatin1Char('0')) && !spec.flags.contains(QLatin1Char('-')) && digits.size() < spec.width) {
+        const bool hasSign = digits.startsWith(QLatin1Char('-')) || digits.startsWith(QLatin1Char('+'));
+        digits.insert(hasSign ? 1 : 0, QString(spec.width - digits.size(), QLatin1Char('0')));
+    }
+    return pad(digits, spec);
+}
+
+QString formatValue(const QJsonValue &value, bool found, const Spec &spec) {
+    if (found && kNumericTypes.contains(spec.type)) {
+        if (const std::optional<QString> number = formatNumber(value, spec)) {
+            return number.value();
+        }
+    }
+    QString text;
+    const char type = spec.type.toLatin1();
+    if (type == 'j') {
+        text = value.isString() ? QString::fromUtf8(QJsonDocument(QJsonArray{value}).toJson(QJsonDocument::Compact)).mid(1).chopped(1)
+                                : plainText(value);
+    } else if (type == 'l' && value.isArray()) {
+        QStringList items;
+        for (const QJsonValue &item : value.toArray()) {
+            items << plainText(item);
+        }
+        text = items.join(QStringLiteral(", "));
+    } else {
+        text = plainText(value);
+    }
+    if (type == 'B' && spec.precision >= 0) {
+        text = truncateUtf8(text, spec.precision);
+    } else if (spec.precision >= 0) {
+        text = text.left(spec.precision);
+    }
+    // An empty default ("%(series&{} - |)s") stands for nothing, not for a placeholder character.
+    return pad(text.isEmpty() ? text : sanitizeFilenameField(text), spec);
+}
+}
+
+QStringList outputTemplateFields(const QString &outputTemplate) {
+    QStringList names;
+    for (qsizetype i = outputTemplate.indexOf(QStringLiteral("%(")); i >= 0; i = outputTemplate.indexOf(QStringLiteral("%("), i + 1)) {
+        if (i > 0 && outputTemplate.at(i - 1) == QLatin1Char('%')) {
+            continue;
+        }
+        const qsizetype close = closingParen(outputTemplate, i + 1);
+        if (close < 0) {
+            break;
+        }
+        for (const QString &path : parseField(outputTemplate.mid(i + 2, close - i - 2)).alternatives) {
+            const QString top = path.section(QLatin1Char('.'), 0, 0, QString::SectionSkipEmpty);
+            if (!top.isEmpty() && !names.contains(top)) {
+                names << top;
+            }
+        }
+    }
+    return names;
+}
+
+QString evaluateOutputTemplate(const QString &outputTemplate, const QJsonObject &info, QStringList *unresolved) {
+    QString out;
+    qsizetype i = 0;
+    while (i < outputTemplate.size()) {
+        const QChar c = outputTemplate.at(i);
+        if (c != QLatin1Char('%') || i + 1 >= outputTemplate.size()) {
+            out += c;
+            ++i;
+            continue;
+        }
+        if (outputTemplate.at(i + 1) == QLatin1Char('%')) {
+            out += QLatin1Char('%');
+            i += 2;
+            continue;
+        }
+        if (outputTemplate.at(i + 1) != QLatin1Char('(')) {
+            out += c;
+            ++i;
+            continue;
+        }
+        const qsizetype close = closingParen(outputTemplate, i + 1);
+        const QRegularExpressionMatch match = close < 0 ? QRegularExpressionMatch()
+                                                        : specRe().match(outputTemplate, close + 1, QRegularExpression::NormalMatch,
+                                                                         QRegularExpression::AnchorAtOffsetMatchOption);
+        if (!match.hasMatch()) {
+            out += c;
+            ++i;
+            continue;
+        }
+
+        const Field field = parseField(outputTemplate.mid(i + 2, close - i - 2));
+        Spec spec;
+        spec.flags = match.captured(1);
+        spec.width = match.captured(2).toInt();
+        spec.precision = match.captured(3).isEmpty() ? -1 : match.captured(3).toInt();
+        spec.type = match.captured(4).at(0);
+
+        QJsonValue value(QJsonValue::Undefined);
+        for (const QString &path : field.alternatives) {
+            const QJsonValue candidate = lookup(info, path);
+            if (!candidate.isUndefined() && !candidate.isNull()) {
+                value = candidate;
+                break;
+            }
+        }
+
+        bool found = !value.isUndefined();
+        if (found && !field.dateFormat.isEmpty()) {
+            value = applyDateFormat(value, field.dateFormat);
+        }
+        if (found && field.hasReplacement) {
+            QString replaced = field.replacement;
+            value = replaced.replace(QStringLiteral("{}"), plainText(value));
+        } else if (!found) {
+            if (unresolved) {
+                for (const QString &path : field.alternatives) {
+                    const QString top = path.section(QLatin1Char('.'), 0, 0, QString::SectionSkipEmpty);
+                    if (!info.contains(top) && !unresolved->contains(top)) {
+                        unresolved->append(top);
+                    }
+                }
+            }
+            value = field.hasFallback ? field.fallback : kPlaceholder;
+            found = field.hasFallback;
+        }
+        out += formatValue(value, found, spec);
+        i = match.capturedEnd();
+    }
+    return out;
+}
+
+QString sanitizeFilenameField(const QString &value) {
+    static const QString fullWidth = QStringLiteral("\"*:<>?|");
+    QString out;
+    out.reserve(value.size());
+    for (const QChar c : value) {
+        if (c == QLatin1Char('\n')) {
+            out += QLatin1Char(' ');
+        } else if (c == QLatin1Char('/')) {
+            out += QChar(0x29F8);
+        } else if (c == QLatin1Char('\\')) {
+            out += QChar(0x29F9);
+        } else if (fullWidth.contains(c)) {
+            out += QChar(c.unicode() + 0xFEE0);
+        } else if (c.unicode() < 32 || c.unicode() == 127) {
+            out += QLatin1Char('_');
+        } else {
+            out += c;
+        }
+    }
+    return out.isEmpty() ? QStringLiteral("_") : out;
+}
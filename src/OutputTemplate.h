@@ -0,0 +1,9 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+QStringList outputTemplateFields(const QString &outputTemplate);
+QString evaluateOutputTemplate(const QString &outputTemplate, const QJsonObject &info, QStringList *unresolved = nullptr);
+QString sanitizeFilenameField(const QString &value);
@@ -0,0 +1,242 @@
+#include "PostProcess.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonValue>
+#include <QRegularExpression>
+#include <QSet>
+
+#include "OutputTemplate.h"
+
+namespace {
+const QString kExtSuffix = QStringLiteral(".%(ext)s");
+const QSet<QString> kImageExts = {QStringLiteral("jpg"), QStringLiteral("jpeg"), QStringLiteral("png"), QStringLiteral("webp")};
+const QSet<QString> kSkippedExts = {QStringLiteral("part"), QStringLiteral("ytdl"), QStringLiteral("temp"), QStringLiteral("json")};
+const QSet<QString> kPictureContainers = {QStringLiteral("mp4"), QStringLiteral("m4v"), QStringLiteral("mov"), QStringLiteral("m4a")};
+
+QStringList audioCodecArgs(const QString &format, const QString &sourceCodec) {
+    const QString source = sourceCodec.toLower();
+    if (format == QStringLiteral("m4a")) {
+        if (source.startsWith(QStringLiteral("mp4a"))) {
+            return {QStringLiteral("-c:a"), QStringLiteral("copy")};
+        }
+        return {QStringLiteral("-c:a"), QStringLiteral("aac"), QStringLiteral("-b:a"), QStringLiteral("192k")};
+    }
+    if (format == QStringLiteral("mp3")) {
+        if (source == QStringLiteral("mp3")) {
+            return {QStringLiteral("-c:a"), QStringLiteral("copy")};
+        }
+        return {QStringLiteral("-c:a"), QStringLiteral("libmp3lame"), QStringLiteral("-q:a"), QStringLiteral("2")};
+    }
+    if (format == QStringLiteral("opus")) {
+        if (source == QStringLiteral("opus")) {
+            return {QStringLiteral("-c:a"), QStringLiteral("copy")};
+        }
+        return {QStringLiteral("-c:a"), QStringLiteral("libopus"), QStringLiteral("-b:a"), QStringLiteral("160k")};
+    }
+    if (format == QStringLiteral("flac")) {
+        return {QStringLiteral("-c:a"), QStringLiteral("flac")};
+    }
+    return {QStringLiteral("-c:a"), QStringLiteral("pcm_s16le")};
+}
+}
+
+QString stagingTemplate(const QString &outputTemplate) {
+    QString base = outputTemplate;
+    if (base.endsWith(kExtSuffix)) {
+        base.chop(kExtSuffix.size());
+    }
+    return base + QStringLiteral(".f%(format_id)s") + kExtSuffix;
+}
+
+QString expandBasicTemplate(const QString &outputTemplate, const QJsonObject &info) {
+    QString base = outputTemplate;
+    if (base.endsWith(kExtSuffix)) {
+        base.chop(kExtSuffix.size());
+    }
+    return evaluateOutputTemplate(base, info);
+}
+
+QString pickMergeContainer(const QString &videoExt, const QString &audioExt) {
+    const QString v = videoExt.toLower();
+    const QString a = audioExt.toLower();
+    if (a.isEmpty()) {
+        return v.isEmpty() ? QStringLiteral("mkv") : v;
+    }
+    const QSet<QString> mp4Video = {QStringLiteral("mp4"), QStringLiteral("m4v"), QStringLiteral("mov")};
+    const QSet<QString> mp4Audio = {QStringLiteral("m4a"), QStringLiteral("mp4"), QStringLiteral("aac")};
+    if (mp4Video.contains(v) && mp4Audio.contains(a)) {
+        return QStringLiteral("mp4");
+    }
+    if (v == QStringLiteral("webm") && (a == QStringLiteral("webm") || a == QStringLiteral("weba") || a == QStringLiteral("opus"))) {
+        return QStringLiteral("webm");
+    }
+    return QStringLiteral("mkv");
+}
+
+std::optional<PostCommand> buildMergeCommand(const PostPlan &plan,
+                                             const QString &stagingDir,
+                                             const QString &outputDir,
+                                             QString *error) {
+    const QRegularExpression formatFileRe(QStringLiteral("^(.*)\\.f([^./\\\\]+)\\.([^./\\\\]+)$"));
+    const QDir staging(stagingDir);
+
+    QString videoPath;
+    QString audioPath;
+    QString videoExt;
+    QString audioExt;
+    QString base;
+    QString thumbPath;
+
+    QDirIterator it(stagingDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        const QFileInfo info(path);
+        const QString ext = info.suffix().toLower();
+        if (kSkippedExts.contains(ext)) {
+            continue;
+        }
+        if (kImageExts.contains(ext)) {
+            thumbPath = path;
+            continue;
+        }
+        const QRegularExpressionMatch match = formatFileRe.match(staging.relativeFilePath(path));
+        if (!match.hasMatch()) {
+            continue;
+        }
+        const QString fid = match.captured(2);
+        if (fid == plan.videoId) {
+            videoPath = path;
+            videoExt = match.captured(3);
+            base = match.captured(1);
+        } else if (!plan.audioId.isEmpty() && fid == plan.audioId) {
+            audioPath = path;
+            audioExt = match.captured(3);
+            if (base.isEmpty()) {
+                base = match.captured(1);
+            }
+        }
+    }
+
+    if (videoPath.isEmpty() || (!plan.audioId.isEmpty() && audioPath.isEmpty())) {
+        if (error) {
+            *error = QStringLiteral("Downloaded streams not found in %1").arg(QDir::toNativeSeparators(stagingDir));
+        }
+        return std::nullopt;
+    }
+
+    const QString container = plan.container == QStringLiteral("auto") ? pickMergeContainer(videoExt, audioExt) : plan.container;
+
+    PostCommand command;
+    command.finalOutput = QDir(outputDir).filePath(base + QLatin1Char('.') + container);
+    command.tempOutput = staging.filePath(base + QStringLiteral(".merged.") + container);
+
+    QStringList &args = command.args;
+    args << QStringLiteral("-hide_banner") << QStringLiteral("-nostdin") << QStringLiteral("-y")
+         << QStringLiteral("-loglevel") << QStringLiteral("error")
+         << QStringLiteral("-progress") << QStringLiteral("pipe:1") << QStringLiteral("-nostats")
+         << QStringLiteral("-i") << videoPath;
+    int inputs = 1;
+    if (!audioPath.isEmpty()) {
+        args << QStringLiteral("-i") << audioPath;
+        ++inputs;
+    }
+
+    const bool embedAsPicture = plan.embedThumbnail && !thumbPath.isEmpty() && kPictureContainers.contains(container);
+    const bool embedAsAttachment = plan.embedThumbnail && !thumbPath.isEmpty() && container == QStringLiteral("mkv");
+    if (embedAsPicture) {
+        args << QStringLiteral("-i") << thumbPath;
+    }
+
+    if (audioPath.isEmpty()) {
+        args << QStringLiteral("-map") << QStringLiteral("0");
+    } else {
+        args << QStringLiteral("-map") << QStringLiteral("0:v:0") << QStringLiteral("-map") << QStringLiteral("1:a:0");
+    }
+    if (embedAsPicture) {
+        args << QStringLiteral("-map") << QStringLiteral("%1:0").arg(inputs)
+             << QStringLiteral("-disposition:v:1") << QStringLiteral("attached_pic");
+    }
+    args << QStringLiteral("-c") << QStringLiteral("copy");
+    if (embedAsAttachment) {
+        args << QStringLiteral("-attach") << thumbPath
+             << QStringLiteral("-metadata:s:t:0") << QStringLiteral("mimetype=image/jpeg");
+    }
+    args << command.tempOutput;
+
+    QStringList steps;
+    steps << (audioPath.isEmpty() ? QStringLiteral("remux → %1").arg(container) : QStringLiteral("merge → %1").arg(container));
+    if (embedAsPicture || embedAsAttachment) {
+        steps << QStringLiteral("embed thumbnail");
+    } else if (plan.embedThumbnail) {
+        steps << QStringLiteral("thumbnail not embeddable in %1").arg(container);
+    }
+    command.description = steps.join(QStringLiteral(", "));
+    return command;
+}
+
+PostCommand buildStreamCommand(const StreamPlan &plan, const QString &outputDir) {
+    PostCommand command;
+    command.finalOutput = QDir(outputDir).filePath(plan.fileName + QLatin1Char('.') + plan.format);
+    command.tempOutput = QDir(outputDir).filePath(plan.fileName + QStringLiteral(".part.") + plan.format);
+
+    const QStringList codec = audioCodecArgs(plan.format, plan.sourceCodec);
+    QStringList &args = command.args;
+    args << QStringLiteral("-hide_banner") << QStringLiteral("-y")
+         << QStringLiteral("-loglevel") << QStringLiteral("error")
+         << QStringLiteral("-i") << QStringLiteral("pipe:0")
+         << QStringLiteral("-vn") << QStringLiteral("-map") << QStringLiteral("0:a:0")
+         << codec << command.tempOutput;
+
+    command.description = codec.value(1) == QStringLiteral("copy") ? QStringLiteral("remux → %1").arg(plan.format)
+                                                                   : QStringLiteral("transcode → %1 (%2)").arg(plan.format, codec.value(1));
+    return command;
+}
+
+QList<ChapterCut> planChapterCuts(const QList<SectionRange> &chapters, const QString &chapterTemplate, const QJsonObject &info) {
+    QList<ChapterCut> cuts;
+    QSet<QString> used;
+    for (qsizetype i = 0; i < chapters.size(); ++i) {
+        const SectionRange &chapter = chapters.at(i);
+        QJsonObject fields = info;
+        fields.insert(QStringLiteral("section_number"), static_cast<int>(i + 1));
+        fields.insert(QStringLiteral("section_title"), chapter.title);
+        fields.insert(QStringLiteral("section_start"), chapter.start);
+        fields.insert(QStringLiteral("section_end"), chapter.end);
+        QString name = expandBasicTemplate(chapterTemplate, fields);
+        // Templates without section_number would otherwise overwrite chapters that share a title.
+        const QString base = name;
+        for (int n = 2; used.contains(name.toLower()); ++n) {
+            name = QStringLiteral("%1 (%2)").arg(base).arg(n);
+        }
+        used.insert(name.toLower());
+        cuts.append(ChapterCut{chapter.start, chapter.end, name});
+    }
+    return cuts;
+}
+
+QList<PostCommand> buildChapterCommands(const QString &source, const QList<ChapterCut> &cuts, const QString &outputDir) {
+    const QString ext = QFileInfo(source).suffix();
+    const QDir dir(outputDir);
+    QList<PostCommand> commands;
+    for (qsizetype i = 0; i < cuts.size(); ++i) {
+        const ChapterCut &cut = cuts.at(i);
+        PostCommand command;
+        command.finalOutput = dir.filePath(cut.fileName + QLatin1Char('.') + ext);
+        command.tempOutput = dir.filePath(cut.fileName + QStringLiteral(".part.") + ext);
+        // Seeking on the input makes each cut read only its own range; stream copy cuts at the preceding keyframe.
+        command.args << QStringLiteral("-hide_banner") << QStringLiteral("-nostdin") << QStringLiteral("-y")
+                     << QStringLiteral("-loglevel") << QStringLiteral("error")
+                     << QStringLiteral("-progress") << QStringLiteral("pipe:1") << QStringLiteral("-nostats")
+                     << QStringLiteral("-ss") << QString::number(cut.start, 'f', 3)
+                     << QStringLiteral("-i") << source
+                     << QStringLiteral("-t") << QString::number(cut.end - cut.start, 'f', 3)
+                     << QStringLiteral("-map") << QStringLiteral("0") << QStringLiteral("-map_chapters") << QStringLiteral("-1")
+                     << QStringLiteral("-c") << QStringLiteral("copy") << QStringLiteral("-avoid_negative_ts") << QStringLiteral("make_zero")
+                     << command.tempOutput;
+        command.description = QStringLiteral("chapter %1/%2 → %3").arg(i + 1).arg(cuts.size()).arg(QFileInfo(command.finalOutput).fileName());
+        commands.append(command);
+    }
+    return commands;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <optional>
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include "SectionRange.h"
+
+struct PostPlan {
+    bool enabled = false;
+    QString videoId;
+    QString audioId;
+    QString container = QStringLiteral("auto");
+    bool embedThumbnail = false;
+    double durationSeconds = 0.0;
+};
+
+struct StreamPlan {
+    bool enabled = false;
+    QString format;
+    QString sourceCodec;
+    QString fileName;
+};
+
+struct ChapterCut {
+    double start = 0.0;
+    double end = 0.0;
+    QString fileName;
+};
+
+struct PostCommand {
+    QStringList args;
+    QString tempOutput;
+    QString finalOutput;
+    QString description;
+};
+
+QString stagingTemplate(const QString &outputTemplate);
+QString expandBasicTemplate(const QString &outputTemplate, const QJsonObject &info);
+QString pickMergeContainer(const QString &videoExt, const QString &audioExt);
+std::optional<PostCommand> buildMergeCommand(const PostPlan &plan,
+                                             const QString &stagingDir,
+                                             const QString &outputDir,
+                                             QString *error);
+PostCommand buildStreamCommand(const StreamPlan &plan, const QString &outputDir);
+QList<ChapterCut> planChapterCuts(const QList<SectionRange> &chapters, const QString &chapterTemplate, const QJsonObject &info);
+QList<PostCommand> buildChapterCommands(const QString &source, const QList<ChapterCut> &cuts, const QString &outputDir);
@@ -0,0 +1,839 @@
+#include "ProcessWorker.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QLocale>
+#include <QMutexLocker>
+#include <QtCore/qoverload.h>
+#include <algorithm>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+#ifdef Q_OS_LINUX
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioWhoPgrp = 2;
+constexpr int kIoprioClassBestEffort = 2;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+#endif
+#ifdef Q_OS_WIN
+constexpr int kIdleNiceness = 15;
+#endif
+constexpr int kMaxCpus = 64;
+constexpr qint64 kSinkHighWater = 8 * 1024 * 1024;
+constexpr qint64 kSinkLowWater = 2 * 1024 * 1024;
+
+bool isLineBreak(char ch) {
+    return ch == '\n' || ch == '\r';
+}
+
+bool isOnlyDecor(const QString &stripped) {
+    for (const QChar ch : stripped) {
+        if (ch != QLatin1Char('-') && ch != QLatin1Char('=') && ch != QLatin1Char('_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+int ioprioValue(const ProcessPriority &priority) {
+    const int ioClass = priority.io == ProcessPriority::Io::Idle ? kIoprioClassIdle : kIoprioClassBestEffort;
+    return (ioClass << kIoprioClassShift) | std::clamp(priority.ioLevel, 0, 7);
+}
+
+cpu_set_t cpuSetOf(quint64 mask) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < kMaxCpus; ++cpu) {
+        if (mask & (quint64(1) << cpu)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return set;
+}
+
+// Affinity has no process-group form, so every thread of every process in the group is set on its own.
+void setGroupAffinity(pid_t group, const cpu_set_t &set) {
+    const QStringList pids = QDir(QStringLiteral("/proc")).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : pids) {
+        bool ok = false;
+        entry.toInt(&ok);
+        if (!ok) {
+            continue;
+        }
+        QFile stat(QStringLiteral("/proc/%1/stat").arg(entry));
+        if (!stat.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        // The command name may hold spaces and parentheses; the fields after it are "state ppid pgrp ...".
+        const QByteArray line = stat.readAll();
+        const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() < 3 || fields.at(2).toInt() != group) {
+            continue;
+        }
+        const QStringList tasks = QDir(QStringLiteral("/proc/%1/task").arg(entry)).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &task : tasks) {
+            ::sched_setaffinity(static_cast<pid_t>(task.toInt()), sizeof(set), &set);
+        }
+    }
+}
+#endif
+
+#ifdef Q_OS_WIN
+DWORD priorityClassOf(int niceness) {
+    if (niceness >= kIdleNiceness) {
+        return IDLE_PRIORITY_CLASS;
+    }
+    return niceness > 0 ? BELOW_NORMAL_PRIORITY_CLASS : NORMAL_PRIORITY_CLASS;
+}
+#endif
+}
+
+std::optional<quint64> parseCpuList(const QString &text) {
+    quint64 mask = 0;
+    const QStringList parts = text.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        const QStringList bounds = part.trimmed().split(QLatin1Char('-'));
+        bool firstOk = false;
+        bool lastOk = false;
+        const int first = bounds.first().toInt(&firstOk);
+        const int last = bounds.size() == 2 ? bounds.last().toInt(&lastOk) : first;
+        if (bounds.size() > 2 || !firstOk || (bounds.size() == 2 && !lastOk) || first < 0 || last < first || last >= kMaxCpus) {
+            return std::nullopt;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            mask |= quint64(1) << cpu;
+        }
+    }
+    return mask;
+}
+
+OutputParser::OutputParser()
+    : percentRe(QStringLiteral("(\\d{1,3}(?:\\.\\d+)?)%")),
+      ariaProgressRe(QStringLiteral("\\[#(?<id>[^\\s]+)\\s+(?<done>[0-9.]+[A-Za-z]+)/(?:\\s*)?(?<total>[0-9.]+[A-Za-z]+)\\((?<pct>[0-9.]+)%\\)\\s+CN:(?<conn>\\d+)\\s+DL:(?<speed>[0-9.]+[A-Za-z/]+)\\s+ETA:(?<eta>[^\\]]+)\\]")),
+      speedRe(QStringLiteral("\\bat\\s+~?\\s*([0-9.]+)\\s*([KMGT]?)(i?)B/s")),
+      fragmentRe(QStringLiteral("\\(frag (\\d+)/(\\d+)\\)")),
+      elapsedRe(QStringLiteral("\\btime=(\\d+):(\\d{2}):(\\d{2}(?:\\.\\d+)?)")),
+      whitespaceRe(QStringLiteral("\\s+")) {
+}
+
+std::optional<QString> OutputParser::normalizeProgressLine(const QString &text) const {
+    const QString stripped = text.trimmed();
+    if (stripped.isEmpty() || isOnlyDecor(stripped)) {
+        return std::nullopt;
+    }
+
+    const QString lowered = stripped.toLower();
+    if (lowered.contains(QStringLiteral("[error]"))) {
+        return std::nullopt;
+    }
+    if (lowered.startsWith(QStringLiteral("*** download progress summary"))) {
+        return std::nullopt;
+    }
+    if (lowered.startsWith(QStringLiteral("file:")) || lowered.startsWith(QStringLiteral("destination:"))) {
+        return std::nullopt;
+    }
+    if (lowered.startsWith(QStringLiteral("==="))) {
+        return std::nullopt;
+    }
+
+    if (lowered.contains(QStringLiteral("[download]"))) {
+        const int idx = lowered.indexOf(QStringLiteral("[download]"));
+        QString segment = text.mid(idx);
+        segment.replace(whitespaceRe, QStringLiteral(" "));
+        return segment.trimmed();
+    }
+
+    const QRegularExpressionMatch ariaMatch = ariaProgressRe.match(text);
+    if (ariaMatch.hasMatch()) {
+        const QString pct = ariaMatch.captured(QStringLiteral("pct"));
+        const QString done = ariaMatch.captured(QStringLiteral("done"));
+        const QString total = ariaMatch.captured(QStringLiteral("total"));
+        const QString speed = ariaMatch.captured(QStringLiteral("speed"));
+        const QString eta = ariaMatch.captured(QStringLiteral("eta")).trimmed();
+        const QString conn = ariaMatch.captured(QStringLiteral("conn"));
+        return QStringLiteral("aria2c %1% — %2/%3 @ %4 ETA %5 (CN:%6)").arg(pct, done, total, speed, eta, conn);
+    }
+
+    if (text.startsWith(QStringLiteral("[#"))) {
+        const QRegularExpressionMatch pctMatch = percentRe.match(text);
+        if (pctMatch.hasMatch()) {
+            QString compact = text;
+            compact.replace(whitespaceRe, QStringLiteral(" "));
+            return QStringLiteral("aria2c %1% — %2").arg(pctMatch.captured(1), compact.trimmed());
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool OutputParser::shouldSkipPlainLine(const QString &text) const {
+    const QString stripped = text.trimmed();
+    if (stripped.isEmpty() || isOnlyDecor(stripped)) {
+        return true;
+    }
+    if (stripped.startsWith(QStringLiteral("***")) || stripped.startsWith(QStringLiteral("==="))) {
+        return true;
+    }
+    const QString lowered = stripped.toLower();
+    if (lowered.contains(QStringLiteral("[error]"))) {
+        return true;
+    }
+    if (lowered.startsWith(QStringLiteral("file:")) || lowered.startsWith(QStringLiteral("destination:"))) {
+        return true;
+    }
+    if (lowered.startsWith(QStringLiteral("exception:"))) {
+        return true;
+    }
+    const QStringList noisyPrefixes = {QStringLiteral("yt-dlp "), QStringLiteral("aria2c "), QStringLiteral("ffmpeg ")};
+    for (const QString &prefix : noisyPrefixes) {
+        if (lowered.startsWith(prefix)) {
+            return true;
+        }
+    }
+    if (lowered.startsWith(QStringLiteral("[youtube]")) || lowered.startsWith(QStringLiteral("[ffmpeg]"))) {
+        return true;
+    }
+    return false;
+}
+
+std::optional<double> OutputParser::percentOf(const QString &text) const {
+    const QRegularExpressionMatch match = percentRe.match(text);
+    if (!match.hasMatch()) {
+        return std::nullopt;
+    }
+    bool ok = false;
+    const double pct = match.captured(1).toDouble(&ok);
+    if (!ok || pct < 0.0 || pct > 100.0) {
+        return std::nullopt;
+    }
+    return pct;
+}
+
+std::optional<double> OutputParser::speedOf(const QString &text) const {
+    const QRegularExpressionMatch match = speedRe.match(text);
+    if (!match.hasMatch()) {
+        return std::nullopt;
+    }
+    bool ok = false;
+    double value = match.captured(1).toDouble(&ok);
+    if (!ok) {
+        return std::nullopt;
+    }
+    const double base = match.captured(3).isEmpty() ? 1000.0 : 1024.0;
+    const QString prefix = match.captured(2);
+    const int power = prefix.isEmpty() ? 0 : QStringLiteral("KMGT").indexOf(prefix) + 1;
+    for (int i = 0; i < power; ++i) {
+        value *= base;
+    }
+    return value;
+}
+
+std::optional<std::pair<int, int>> OutputParser::fragmentsOf(const QString &text) const {
+    const QRegularExpressionMatch match = fragmentRe.match(text);
+    if (!match.hasMatch()) {
+        return std::nullopt;
+    }
+    const int index = match.captured(1).toInt();
+    const int count = match.captured(2).toInt();
+    if (count <= 0) {
+        return std::nullopt;
+    }
+    return std::make_pair(std::min(index, count), count);
+}
+
+std::optional<double> OutputParser::elapsedOf(const QString &text) const {
+    const QRegularExpressionMatch match = elapsedRe.match(text);
+    if (!match.hasMatch()) {
+        return std::nullopt;
+    }
+    return match.captured(1).toDouble() * 3600.0 + match.captured(2).toDouble() * 60.0 + match.captured(3).toDouble();
+}
+
+ProcessWorker::ProcessWorker(Mode mode)
+    : QObject(nullptr),
+      mode(mode),
+      process(nullptr),
+      skippingPayload(false),
+      phase(Phase::Starting),
+      durationHint(0.0),
+      fragmentPercent(0.0),
+      streamIndex(-1),
+      sink(nullptr),
+      relayedBytes(0),
+      sourceThrottled(false),
+      suspended(false),
+      progressPosted(false) {
+}
+
+ProcessWorker::~ProcessWorker() {
+    kill();
+}
+
+bool ProcessWorker::supportsSuspend() {
+#ifdef Q_OS_UNIX
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Runs in the forked child before exec, so only plain system calls belong here.
+// Its own process group keeps terminal signals away from the child, so on Linux it is tied to the app instead:
+// if the app dies (or already died before prctl ran), the child is killed rather than left downloading. The signal
+// follows the thread that forked, which is the I/O thread workers live on for the whole session.
+void ProcessWorker::isolate(QProcess *target) {
+#if defined(Q_OS_UNIX)
+    target->setChildProcessModifier([priority = priority, parent = ::getpid()]() {
+        ::setpgid(0, 0);
+#ifdef Q_OS_LINUX
+        ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (::getppid() != parent) {
+            ::_exit(1);
+        }
+#else
+        Q_UNUSED(parent);
+#endif
+        if (priority.niceness != 0) {
+            ::setpriority(PRIO_PROCESS, 0, ::getpriority(PRIO_PROCESS, 0) + priority.niceness);
+        }
+#ifdef Q_OS_LINUX
+        if (priority.io != ProcessPriority::Io::Default) {
+            ::syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, ioprioValue(priority));
+        }
+        if (priority.cpuMask != 0) {
+            const cpu_set_t set = cpuSetOf(priority.cpuMask);
+            ::sched_setaffinity(0, sizeof(set), &set);
+        }
+#endif
+    });
+#elif defined(Q_OS_WIN)
+    const int niceness = priority.niceness;
+    const quint64 cpuMask = priority.cpuMask;
+    target->setCreateProcessArgumentsModifier([niceness](QProcess::CreateProcessArguments *args) {
+        if (niceness > 0) {
+            args->flags |= priorityClassOf(niceness);
+        }
+    });
+    if (cpuMask != 0) {
+        connect(target, &QProcess::started, target, [target, cpuMask]() {
+            if (HANDLE handle = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION, FALSE, static_cast<DWORD>(target->processId()))) {
+                SetProcessAffinityMask(handle, static_cast<DWORD_PTR>(cpuMask));
+                CloseHandle(handle);
+            }
+        });
+    }
+#else
+    Q_UNUSED(target);
+#endif
+}
+
+void ProcessWorker::signalGroup(QProcess *target, int signo) {
+#ifdef Q_OS_UNIX
+    if (target && target->state() != QProcess::NotRunning && target->processId() > 0) {
+        ::kill(-static_cast<pid_t>(target->processId()), signo);
+    }
+#else
+    Q_UNUSED(target);
+    Q_UNUSED(signo);
+#endif
+}
+
+void ProcessWorker::setDurationHint(double seconds) {
+    durationHint = seconds;
+}
+
+void ProcessWorker::setSink(const SinkCommand &command) {
+    sinkCommand = command;
+}
+
+void ProcessWorker::setPriority(const ProcessPriority &value) {
+    priority = value;
+}
+
+// The child started in its own process group, so niceness, I/O class and CPU list change for everything yt-dlp spawned
+// too; without a CPU list the group gets this process's own affinity back. Windows has no process groups, so there only
+// the direct child changes and its helpers keep the class they were started with.
+// Raising priority back up may be refused for unprivileged users; the child then keeps its current class.
+void ProcessWorker::applyPriority(const ProcessPriority &value) {
+    priority = value;
+    for (QProcess *target : {process, sink}) {
+        if (!target || target->state() == QProcess::NotRunning || target->processId() <= 0) {
+            continue;
+        }
+        const qint64 pid = target->processId();
+#if defined(Q_OS_UNIX)
+        ::setpriority(PRIO_PGRP, static_cast<id_t>(pid), ::getpriority(PRIO_PROCESS, 0) + priority.niceness);
+#endif
+#if defined(Q_OS_LINUX)
+        const int ioprio = priority.io == ProcessPriority::Io::Default ? 0 : ioprioValue(priority);
+        ::syscall(SYS_ioprio_set, kIoprioWhoPgrp, static_cast<int>(pid), ioprio);
+        cpu_set_t set;
+        if (priority.cpuMask != 0) {
+            set = cpuSetOf(priority.cpuMask);
+        } else if (::sched_getaffinity(0, sizeof(set), &set) != 0) {
+            continue;
+        }
+        setGroupAffinity(static_cast<pid_t>(pid), set);
+#elif defined(Q_OS_WIN)
+        if (HANDLE handle = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_INFORMATION, FALSE, static_cast<DWORD>(pid))) {
+            SetPriorityClass(handle, priorityClassOf(priority.niceness));
+            DWORD_PTR processMask = 0;
+            DWORD_PTR systemMask = 0;
+            if (priority.cpuMask != 0) {
+                SetProcessAffinityMask(handle, static_cast<DWORD_PTR>(priority.cpuMask));
+            } else if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+                SetProcessAffinityMask(handle, systemMask);
+            }
+            CloseHandle(handle);
+        }
+#endif
+    }
+}
+
+std::optional<ProgressEvent> ProcessWorker::takeProgress() {
+    QMutexLocker locker(&progressMutex);
+    progressPosted = false;
+    std::optional<ProgressEvent> event = std::move(latestProgress);
+    latestProgress.reset();
+    return event;
+}
+
+void ProcessWorker::start(const QString &program, const QStringList &args) {
+    process = new QProcess(this);
+    process->setProgram(program);
+    process->setArguments(args);
+    isolate(process);
+    if (mode == Mode::Stream) {
+        sink = new QProcess(this);
+        sink->setProgram(sinkCommand.program);
+        sink->setArguments(sinkCommand.args);
+        sink->setStandardOutputFile(QProcess::nullDevice());
+        isolate(sink);
+        connect(sink, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &ProcessWorker::onSinkFinished);
+        connect(sink, &QProcess::errorOccurred, this, &ProcessWorker::onSinkError);
+        connect(sink, &QProcess::bytesWritten, this, &ProcessWorker::onSinkWritten);
+        sink->start();
+        if (sinkResult) {
+            sourceResult = std::make_pair(-1, QProcess::CrashExit);
+            finishStream();
+            return;
+        }
+        process->setProcessChannelMode(QProcess::SeparateChannels);
+        connect(process, &QProcess::readyReadStandardOutput, this, &ProcessWorker::onSourceData);
+        connect(process, &QProcess::readyReadStandardError, this, &ProcessWorker::onSourceErrors);
+    } else {
+        process->setProcessChannelMode(QProcess::MergedChannels);
+        connect(process, &QProcess::readyReadStandardOutput, this, &ProcessWorker::onReadyRead);
+    }
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &ProcessWorker::onFinished);
+    connect(process, &QProcess::errorOccurred, this, &ProcessWorker::onErrorOccurred);
+    process->start();
+}
+
+void ProcessWorker::onErrorOccurred(QProcess::ProcessError error) {
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+    emit logLines({QStringLiteral("ERROR: failed to start %1: %2").arg(process->program(), process->errorString())});
+    if (mode == Mode::Analysis) {
+        emit analysisFinished(-1, QProcess::CrashExit, QJsonObject(), false, QString(), 0, 0);
+    } else if (mode == Mode::Stream) {
+        sourceResult = std::make_pair(-1, QProcess::CrashExit);
+        if (sink && sink->state() != QProcess::NotRunning) {
+            sink->kill();
+        } else {
+            finishStream();
+        }
+    } else {
+        emit downloadFinished(-1, QProcess::CrashExit);
+    }
+}
+
+void ProcessWorker::kill() {
+#ifdef Q_OS_UNIX
+    signalGroup(process, SIGKILL);
+    signalGroup(sink, SIGKILL);
+#endif
+    if (process && process->state() != QProcess::NotRunning) {
+        process->kill();
+    }
+    if (sink && sink->state() != QProcess::NotRunning) {
+        sink->kill();
+    }
+}
+
+void ProcessWorker::suspend() {
+    suspended = true;
+#ifdef Q_OS_UNIX
+    signalGroup(process, SIGSTOP);
+#endif
+}
+
+void ProcessWorker::resume() {
+    suspended = false;
+#ifdef Q_OS_UNIX
+    if (!sourceThrottled) {
+        signalGroup(process, SIGCONT);
+    }
+#endif
+}
+
+// ffmpeg can fall behind yt-dlp (slow disk, re-encode); holding the source stops the pipe buffer from growing without bound.
+void ProcessWorker::onSourceData() {
+    if (sourceThrottled) {
+        return;
+    }
+    const QByteArray chunk = process->readAllStandardOutput();
+    if (chunk.isEmpty()) {
+        return;
+    }
+    if (!sink || sink->state() == QProcess::NotRunning) {
+        return;
+    }
+    sink->write(chunk);
+    relayedBytes += chunk.size();
+    if (sink->bytesToWrite() > kSinkHighWater && process->state() != QProcess::NotRunning) {
+        sourceThrottled = true;
+#ifdef Q_OS_UNIX
+        signalGroup(process, SIGSTOP);
+#endif
+    }
+
+    const QLocale locale;
+    ProgressEvent event;
+    if (sinkCommand.expectedBytes > 0) {
+        event.percent = std::min(99.9, 100.0 * static_cast<double>(relayedBytes) / static_cast<double>(sinkCommand.expectedBytes));
+        event.line = QStringLiteral("[stream] %1 of ~%2 piped to ffmpeg")
+                         .arg(locale.formattedDataSize(relayedBytes), locale.formattedDataSize(sinkCommand.expectedBytes));
+    } else {
+        event.line = QStringLiteral("[stream] %1 piped to ffmpeg").arg(locale.formattedDataSize(relayedBytes));
+    }
+    if (const std::optional<double> speed = parser.speedOf(lastSourceLine)) {
+        event.bytesPerSecond = speed.value();
+    }
+    postProgress(std::move(event));
+}
+
+void ProcessWorker::onSourceErrors() {
+    QStringList logOut;
+    consume(process->readAllStandardError(), logOut);
+    if (!logOut.isEmpty()) {
+        emit logLines(logOut);
+    }
+}
+
+void ProcessWorker::onSinkFinished(int exitCode, QProcess::ExitStatus status) {
+    sinkResult = std::make_pair(exitCode, status);
+    QStringList logOut;
+    const QList<QByteArray> lines = sink->readAllStandardError().split('\n');
+    for (const QByteArray &raw : lines) {
+        const QString line = QString::fromUtf8(raw).trimmed();
+        if (!line.isEmpty()) {
+            logOut.append(QStringLiteral("[ffmpeg] ") + line);
+        }
+    }
+    if (!logOut.isEmpty()) {
+        emit logLines(logOut);
+    }
+    if (process && process->state() != QProcess::NotRunning) {
+        process->kill();
+        return;
+    }
+    finishStream();
+}
+
+void ProcessWorker::onSinkError(QProcess::ProcessError error) {
+    if (error != QProcess::FailedToStart) {
+        return;
+    }
+    emit logLines({QStringLiteral("ERROR: failed to start %1: %2").arg(sink->program(), sink->errorString())});
+    sinkResult = std::make_pair(-1, QProcess::CrashExit);
+    if (process && process->state() != QProcess::NotRunning) {
+        process->kill();
+        return;
+    }
+    finishStream();
+}
+
+void ProcessWorker::onSinkWritten() {
+    if (!sourceThrottled || sink->bytesToWrite() > kSinkLowWater) {
+        return;
+    }
+    sourceThrottled = false;
+#ifdef Q_OS_UNIX
+    if (!suspended) {
+        signalGroup(process, SIGCONT);
+    }
+#endif
+    onSourceData();
+}
+
+void ProcessWorker::finishStream() {
+    if (!sourceResult || !sinkResult) {
+        return;
+    }
+    const auto [sourceCode, sourceStatus] = sourceResult.value();
+    const auto [sinkCode, sinkStatus] = sinkResult.value();
+    if (sourceStatus != QProcess::NormalExit || sourceCode != 0) {
+        emit downloadFinished(sourceCode, sourceStatus);
+    } else {
+        emit downloadFinished(sinkCode, sinkStatus);
+    }
+}
+
+void ProcessWorker::onReadyRead() {
+    const QByteArray chunk = process->readAllStandardOutput();
+    if (mode == Mode::Analysis) {
+        analysisRaw += chunk;
+    }
+    QStringList logOut;
+    consume(chunk, logOut);
+    if (!logOut.isEmpty()) {
+        emit logLines(logOut);
+    }
+}
+
+void ProcessWorker::consume(const QByteArray &chunk, QStringList &logOut) {
+    qsizetype start = 0;
+    const qsizetype size = chunk.size();
+    while (start < size) {
+        qsizetype end = start;
+        while (end < size && !isLineBreak(chunk.at(end))) {
+            ++end;
+        }
+        if (!skippingPayload) {
+            lineBuffer.append(chunk.constData() + start, end - start);
+            if (mode == Mode::Analysis && lineBuffer.startsWith('{')) {
+                skippingPayload = true;
+                lineBuffer.clear();
+            }
+        }
+        if (end == size) {
+            break;
+        }
+        flushLine(logOut);
+        start = end + 1;
+    }
+}
+
+void ProcessWorker::flushLine(QStringList &logOut) {
+    if (!skippingPayload && !lineBuffer.isEmpty()) {
+        const QString line = QString::fromUtf8(lineBuffer).trimmed();
+        if (!line.isEmpty()) {
+            switch (mode) {
+            case Mode::Analysis:
+                handleAnalysisLine(line, logOut);
+                break;
+            case Mode::Ffmpeg:
+                handleFfmpegLine(line, logOut);
+                break;
+            case Mode::Stream:
+                handleStreamLine(line, logOut);
+                break;
+            default:
+                handleDownloadLine(line, logOut);
+                break;
+            }
+        }
+    }
+    lineBuffer.clear();
+    skippingPayload = false;
+}
+
+void ProcessWorker::handleAnalysisLine(const QString &line, QStringList &logOut) {
+    const QString upper = line.toUpper();
+    if (upper.contains(QStringLiteral("ERROR")) || upper.contains(QStringLiteral("WARNING"))) {
+        logOut.append(line);
+    }
+}
+
+void ProcessWorker::handleFfmpegLine(const QString &line, QStringList &logOut) {
+    static const QRegularExpression keyValueRe(QStringLiteral("^[a-z0-9_]+=\\S*$"));
+    if (line.startsWith(QStringLiteral("out_time_us="))) {
+        bool ok = false;
+        const double micros = line.mid(12).toDouble(&ok);
+        if (ok && durationHint > 0.0) {
+            postProgress(ProgressEvent{std::clamp(micros / 1e6 / durationHint * 100.0, 0.0, 100.0), QString()});
+        }
+        return;
+    }
+    if (line == QStringLiteral("progress=end")) {
+        postProgress(ProgressEvent{100.0, QString()});
+        return;
+    }
+    if (keyValueRe.match(line).hasMatch()) {
+        return;
+    }
+    logOut.append(line);
+}
+
+void ProcessWorker::handleStreamLine(const QString &line, QStringList &logOut) {
+    updatePhase(line);
+    const std::optional<QString> normalized = parser.normalizeProgressLine(line);
+    if (normalized.has_value()) {
+        if (parser.percentOf(normalized.value()).has_value()) {
+            lastSourceLine = normalized.value();
+        } else {
+            logOut.append(normalized.value());
+        }
+        return;
+    }
+    if (!parser.shouldSkipPlainLine(line)) {
+        logOut.append(line);
+    }
+}
+
+void ProcessWorker::handleDownloadLine(const QString &line, QStringList &logOut) {
+    updatePhase(line);
+
+    // Section downloads run through ffmpeg, which reports the output position instead of a percentage.
+    if (durationHint > 0.0) {
+        if (const std::optional<double> elapsed = parser.elapsedOf(line)) {
+            postDownloadProgress(std::clamp(elapsed.value() / durationHint * 100.0, 0.0, 100.0), line, line);
+            return;
+        }
+    }
+
+    const std::optional<QString> normalized = parser.normalizeProgressLine(line);
+    if (normalized.has_value()) {
+        const std::optional<double> pct = parser.percentOf(normalized.value());
+        if (pct.has_value()) {
+            postDownloadProgress(pct.value(), normalized.value(), normalized.value());
+        } else {
+            logOut.append(normalized.value());
+        }
+        return;
+    }
+
+    if (parser.shouldSkipPlainLine(line)) {
+        return;
+    }
+
+    logOut.append(line);
+    const std::optional<double> pct = parser.percentOf(line);
+    if (pct.has_value()) {
+        postDownloadProgress(pct.value(), line, QString());
+    }
+}
+
+void ProcessWorker::postDownloadProgress(double percent, const QString &text, const QString &line) {
+    ProgressEvent event{percent, line};
+    event.stream = streamIndex;
+    if (const std::optional<double> speed = parser.speedOf(text)) {
+        event.bytesPerSecond = speed.value();
+    }
+    if (const std::optional<std::pair<int, int>> frags = parser.fragmentsOf(text)) {
+        event.fragment = frags->first;
+        event.fragmentCount = frags->second;
+        fragmentPercent = std::max(fragmentPercent, 100.0 * frags->first / frags->second);
+        event.percent = fragmentPercent;
+    }
+    postProgress(std::move(event));
+}
+
+void ProcessWorker::updatePhase(const QString &line) {
+    Phase next = phase;
+    if (line.startsWith(QStringLiteral("[download] Destination:"))) {
+        next = Phase::Downloading;
+        fragmentPercent = 0.0;
+        ++streamIndex;
+    } else if (line.startsWith(QStringLiteral("[download] ")) && line.endsWith(QStringLiteral("has already been downloaded"))) {
+        ++streamIndex;
+        postDownloadProgress(100.0, QString(), QString());
+    } else if (line.startsWith(QStringLiteral("[Merger]"))) {
+        next = Phase::Merging;
+    } else if (line.startsWith(QStringLiteral("[ExtractAudio]")) || line.startsWith(QStringLiteral("[VideoRemuxer]"))
+               || line.startsWith(QStringLiteral("[VideoConvertor]")) || line.startsWith(QStringLiteral("[EmbedThumbnail]"))
+               || line.startsWith(QStringLiteral("[Metadata]")) || line.startsWith(QStringLiteral("[Fixup"))) {
+        next = Phase::PostProcessing;
+    } else if (phase == Phase::Starting && line.startsWith(QLatin1Char('['))) {
+        next = Phase::Extracting;
+    }
+    if (next != phase) {
+        phase = next;
+        emit phaseChanged(phase);
+    }
+}
+
+void ProcessWorker::postProgress(ProgressEvent event) {
+    QMutexLocker locker(&progressMutex);
+    latestProgress = std::move(event);
+    if (progressPosted) {
+        return;
+    }
+    progressPosted = true;
+    locker.unlock();
+    emit progressAvailable();
+}
+
+void ProcessWorker::onFinished(int exitCode, QProcess::ExitStatus status) {
+    if (mode == Mode::Stream) {
+        sourceThrottled = false;
+        onSourceData();
+        QStringList logOut;
+        consume(process->readAllStandardError(), logOut);
+        flushLine(logOut);
+        if (!logOut.isEmpty()) {
+            emit logLines(logOut);
+        }
+        sourceResult = std::make_pair(exitCode, status);
+        if (sink && sink->state() != QProcess::NotRunning) {
+            sink->closeWriteChannel();
+        } else {
+            finishStream();
+        }
+        return;
+    }
+
+    QStringList logOut;
+    consume(process->readAllStandardOutput(), logOut);
+    flushLine(logOut);
+    if (!logOut.isEmpty()) {
+        emit logLines(logOut);
+    }
+
+    if (mode != Mode::Analysis) {
+        emit downloadFinished(exitCode, status);
+        return;
+    }
+
+    QJsonObject data;
+    bool parsed = false;
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    const qsizetype first = analysisRaw.indexOf('{');
+    const qsizetype last = analysisRaw.lastIndexOf('}');
+    if (first != -1 && last != -1 && last > first) {
+        QJsonParseError err{};
+        const QJsonDocument doc = QJsonDocument::fromJson(analysisRaw.mid(first, last - first + 1), &err);
+        if (err.error == QJsonParseError::NoError && doc.isObject()) {
+            data = doc.object();
+            parsed = true;
+        }
+    }
+    const qint64 parseMicros = parseTimer.nsecsElapsed() / 1000;
+    const qint64 payloadBytes = analysisRaw.size();
+    const QString raw = parsed ? QString() : QString::fromUtf8(analysisRaw).trimmed();
+    analysisRaw.clear();
+    analysisRaw.squeeze();
+    emit analysisFinished(exitCode, status, data, parsed, raw, payloadBytes, parseMicros);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QStringList>
+
+struct ProgressEvent {
+    double percent = -1.0;
+    QString line;
+    double bytesPerSecond = -1.0;
+    int fragment = -1;
+    int fragmentCount = -1;
+    int stream = -1;
+    double etaSeconds = -1.0;
+};
+
+struct ProcessPriority {
+    enum class Io { Default, BestEffort, Idle };
+
+    int niceness = 0;
+    Io io = Io::Default;
+    int ioLevel = 4;
+    quint64 cpuMask = 0;
+};
+
+std::optional<quint64> parseCpuList(const QString &text);
+
+struct SinkCommand {
+    QString program;
+    QStringList args;
+    qint64 expectedBytes = 0;
+};
+
+class OutputParser {
+public:
+    OutputParser();
+
+    std::optional<QString> normalizeProgressLine(const QString &text) const;
+    bool shouldSkipPlainLine(const QString &text) const;
+    std::optional<double> percentOf(const QString &text) const;
+    std::optional<double> speedOf(const QString &text) const;
+    std::optional<std::pair<int, int>> fragmentsOf(const QString &text) const;
+    std::optional<double> elapsedOf(const QString &text) const;
+
+private:
+    QRegularExpression percentRe;
+    QRegularExpression ariaProgressRe;
+    QRegularExpression speedRe;
+    QRegularExpression fragmentRe;
+    QRegularExpression elapsedRe;
+    QRegularExpression whitespaceRe;
+};
+
+class ProcessWorker : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Mode { Download, Analysis, Ffmpeg, Stream };
+    enum class Phase { Starting, Extracting, Downloading, Merging, PostProcessing };
+    Q_ENUM(Phase)
+
+    explicit ProcessWorker(Mode mode);
+    ~ProcessWorker() override;
+
+    static bool supportsSuspend();
+
+    void setDurationHint(double seconds);
+    void setSink(const SinkCommand &command);
+    void setPriority(const ProcessPriority &value);
+
+    std::optional<ProgressEvent> takeProgress();
+
+public slots:
+    void start(const QString &program, const QStringList &args);
+    void kill();
+    void suspend();
+    void resume();
+    void applyPriority(const ProcessPriority &value);
+
+signals:
+    void progressAvailable();
+    void logLines(const QStringList &lines);
+    void phaseChanged(ProcessWorker::Phase phase);
+    void downloadFinished(int exitCode, QProcess::ExitStatus status);
+    void analysisFinished(int exitCode, QProcess::ExitStatus status, const QJsonObject &data, bool parsed, const QString &raw,
+                          qint64 payloadBytes, qint64 parseMicros);
+
+private slots:
+    void onReadyRead();
+    void onFinished(int exitCode, QProcess::ExitStatus status);
+    void onErrorOccurred(QProcess::ProcessError error);
+    void onSourceData();
+    void onSourceErrors();
+    void onSinkFinished(int exitCode, QProcess::ExitStatus status);
+    void onSinkError(QProcess::ProcessError error);
+    void onSinkWritten();
+
+private:
+    void consume(const QByteArray &chunk, QStringList &logOut);
+    void flushLine(QStringList &logOut);
+    void handleDownloadLine(const QString &line, QStringList &logOut);
+    void handleAnalysisLine(const QString &line, QStringList &logOut);
+    void handleFfmpegLine(const QString &line, QStringList &logOut);
+    void handleStreamLine(const QString &line, QStringList &logOut);
+    void finishStream();
+    void updatePhase(const QString &line);
+    void postProgress(ProgressEvent event);
+    void signalGroup(QProcess *target, int signo);
+    void isolate(QProcess *target);
+    void postDownloadProgress(double percent, const QString &text, const QString &line);
+
+    const Mode mode;
+    QProcess *process;
+    OutputParser parser;
+    QByteArray lineBuffer;
+    bool skippingPayload;
+    QByteArray analysisRaw;
+    Phase phase;
+    double durationHint;
+    ProcessPriority priority;
+    double fragmentPercent;
+    int streamIndex;
+
+    QProcess *sink;
+    SinkCommand sinkCommand;
+    qint64 relayedBytes;
+    bool sourceThrottled;
+    bool suspended;
+    QString lastSourceLine;
+    std::optional<std::pair<int, QProcess::ExitStatus>> sourceResult;
+    std::optional<std::pair<int, QProcess::ExitStatus>> sinkResult;
+
+    QMutex progressMutex;
+    std::optional<ProgressEvent> latestProgress;
+    bool progressPosted;
+};
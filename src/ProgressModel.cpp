@@ -0,0 +1,111 @@
+#include "ProgressModel.h"
+
+#include <cmath>
+
+#include <algorithm>
+
+namespace {
+constexpr double kSmoothingSeconds = 5.0;
+constexpr qint64 kMinRateIntervalMs = 250;
+
+double blend(double current, double sample, qint64 elapsedMs) {
+    if (current < 0.0) {
+        return sample;
+    }
+    const double alpha = 1.0 - std::exp(-static_cast<double>(elapsedMs) / 1000.0 / kSmoothingSeconds);
+    return current + alpha * (sample - current);
+}
+}
+
+void ProgressModel::plan(const QList<qint64> &streamBytes, double postWeight, double splitWeight) {
+    postShare = std::clamp(postWeight, 0.0, 0.9);
+    splitShare = std::clamp(splitWeight, 0.0, 0.9 - postShare);
+    shares.clear();
+
+    qint64 known = 0;
+    int knownCount = 0;
+    for (qint64 bytes : streamBytes) {
+        if (bytes > 0) {
+            known += bytes;
+            ++knownCount;
+        }
+    }
+    // Streams without a size count as the average known one, or all equal when nothing is known.
+    const double fallback = knownCount > 0 ? static_cast<double>(known) / knownCount : 1.0;
+    double total = 0.0;
+    for (qint64 bytes : streamBytes) {
+        shares.append(bytes > 0 ? static_cast<double>(bytes) : fallback);
+        total += shares.last();
+    }
+    if (shares.isEmpty()) {
+        shares.append(1.0);
+        total = 1.0;
+    }
+    for (double &share : shares) {
+        share = share / total * (1.0 - postShare - splitShare);
+    }
+}
+
+void ProgressModel::streamProgress(int stream, double percent, qint64 nowMs) {
+    if (shares.isEmpty()) {
+        plan({}, 0.0);
+    }
+    // yt-dlp can fetch more files than planned (subtitles); they count toward the last stream.
+    const qsizetype index = std::clamp<qsizetype>(stream, 0, shares.size() - 1);
+    double done = 0.0;
+    for (qsizetype i = 0; i < index; ++i) {
+        done += shares.at(i);
+    }
+    advance(done + shares.at(index) * std::clamp(percent, 0.0, 100.0) / 100.0, nowMs);
+}
+
+void ProgressModel::postProgress(double percent, qint64 nowMs) {
+    advance(1.0 - postShare - splitShare + postShare * std::clamp(percent, 0.0, 100.0) / 100.0, nowMs);
+}
+
+void ProgressModel::splitProgress(double percent, qint64 nowMs) {
+    advance(1.0 - splitShare + splitShare * std::clamp(percent, 0.0, 100.0) / 100.0, nowMs);
+}
+
+void ProgressModel::sampleSpeed(double bytesPerSecond, qint64 nowMs) {
+    if (bytesPerSecond <= 0.0) {
+        return;
+    }
+    speed = blend(speed, bytesPerSecond, speedSampleMs < 0 ? 0 : nowMs - speedSampleMs);
+    speedSampleMs = nowMs;
+}
+
+void ProgressModel::finish() {
+    overall = 1.0;
+}
+
+double ProgressModel::percent() const {
+    return overall * 100.0;
+}
+
+double ProgressModel::bytesPerSecond() const {
+    return speed;
+}
+
+double ProgressModel::etaSeconds() const {
+    if (rate <= 0.0 || overall >= 1.0) {
+        return -1.0;
+    }
+    return (1.0 - overall) / rate;
+}
+
+void ProgressModel::advance(double fraction, qint64 nowMs) {
+    overall = std::max(overall, std::min(fraction, 1.0));
+    if (rateSampleMs < 0) {
+        rateSampleMs = nowMs;
+        rateBase = overall;
+        return;
+    }
+    const qint64 elapsed = nowMs - rateSampleMs;
+    if (elapsed < kMinRateIntervalMs) {
+        return;
+    }
+    rate = blend(rate, (overall - rateBase) * 1000.0 / static_cast<double>(elapsed), elapsed);
+    rateSampleMs = nowMs;
+    rateBase = overall;
+}
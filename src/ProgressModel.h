@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QList>
+
+// Folds yt-dlp's per-stream 0-100% passes, the merge and a chapter split into one monotonic job percentage.
+class ProgressModel {
+public:
+    void plan(const QList<qint64> &streamBytes, double postWeight, double splitWeight = 0.0);
+    void streamProgress(int stream, double percent, qint64 nowMs);
+    void postProgress(double percent, qint64 nowMs);
+    void splitProgress(double percent, qint64 nowMs);
+    void sampleSpeed(double bytesPerSecond, qint64 nowMs);
+    void finish();
+
+    double percent() const;
+    double bytesPerSecond() const;
+    double etaSeconds() const;
+
+private:
+    void advance(double fraction, qint64 nowMs);
+
+    QList<double> shares;
+    double postShare = 0.0;
+    double splitShare = 0.0;
+    double overall = 0.0;
+    double rate = -1.0;
+    double rateBase = 0.0;
+    qint64 rateSampleMs = -1;
+    double speed = -1.0;
+    qint64 speedSampleMs = -1;
+};
@@ -0,0 +1,170 @@
+#include "RemuxPlanner.h"
+
+#include <QHash>
+#include <QSet>
+#include <cmath>
+
+#include "PostProcess.h"
+
+namespace {
+const QString kAuto = QStringLiteral("auto");
+const QString kCopyContainer = QStringLiteral("mkv");
+
+const QHash<QString, QString> kCodecFamilies = {
+    {QStringLiteral("avc1"), QStringLiteral("h264")},  {QStringLiteral("avc3"), QStringLiteral("h264")},
+    {QStringLiteral("h264"), QStringLiteral("h264")},  {QStringLiteral("hev1"), QStringLiteral("hevc")},
+    {QStringLiteral("hvc1"), QStringLiteral("hevc")},  {QStringLiteral("h265"), QStringLiteral("hevc")},
+    {QStringLiteral("hevc"), QStringLiteral("hevc")},  {QStringLiteral("vp09"), QStringLiteral("vp9")},
+    {QStringLiteral("vp9"), QStringLiteral("vp9")},    {QStringLiteral("vp8"), QStringLiteral("vp8")},
+    {QStringLiteral("av01"), QStringLiteral("av1")},   {QStringLiteral("av1"), QStringLiteral("av1")},
+    {QStringLiteral("mp4a"), QStringLiteral("aac")},   {QStringLiteral("aac"), QStringLiteral("aac")},
+    {QStringLiteral("ac-3"), QStringLiteral("ac3")},   {QStringLiteral("ac3"), QStringLiteral("ac3")},
+    {QStringLiteral("ec-3"), QStringLiteral("eac3")},  {QStringLiteral("eac3"), QStringLiteral("eac3")},
+};
+
+// Codecs each container takes with -c copy; mkv takes everything yt-dlp offers.
+const QHash<QString, QSet<QString>> kContainerCodecs = {
+    {QStringLiteral("mp4"), {QStringLiteral("h264"), QStringLiteral("hevc"), QStringLiteral("av1"), QStringLiteral("vp9"),
+                             QStringLiteral("aac"), QStringLiteral("mp3"), QStringLiteral("opus"), QStringLiteral("ac3"),
+                             QStringLiteral("eac3"), QStringLiteral("flac"), QStringLiteral("alac")}},
+    {QStringLiteral("webm"), {QStringLiteral("vp8"), QStringLiteral("vp9"), QStringLiteral("av1"), QStringLiteral("opus"),
+                              QStringLiteral("vorbis")}},
+};
+
+bool sameContainer(const QString &a, const QString &b) {
+    return a.compare(b, Qt::CaseInsensitive) == 0;
+}
+
+bool sameFps(const FormatRow &a, const FormatRow &b) {
+    if (!a.fps || !b.fps) {
+        return a.fps.has_value() == b.fps.has_value();
+    }
+    return std::abs(a.fps.value() - b.fps.value()) < 1.0;
+}
+
+int equivalentProgressive(const FormatStore &store, const FormatRow &video, const QString &container) {
+    const QString family = codecFamily(video.vcodec);
+    for (int index : store.videoOrder()) {
+        const FormatRow &row = store.at(index);
+        if (!row.isProgressive() || row.height != video.height || !sameFps(row, video) || codecFamily(row.vcodec) != family) {
+            continue;
+        }
+        if (container.isEmpty() || sameContainer(row.ext, container)
+            || (containerAccepts(container, row.vcodec) && containerAccepts(container, row.acodec))) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int compatibleAudio(const FormatStore &store, const QString &container) {
+    for (int index : store.audioOrder()) {
+        if (containerAccepts(container, store.at(index).acodec)) {
+            return index;
+        }
+    }
+    return -1;
+}
+}
+
+QString RemuxPlan::summary() const {
+    switch (cost) {
+    case PostCost::None:
+        return QStringLiteral("No post-processing");
+    case PostCost::StreamCopy:
+        return (merge ? QStringLiteral("Stream-copy merge → %1") : QStringLiteral("Stream-copy remux → %1")).arg(container);
+    case PostCost::Transcode:
+        return QStringLiteral("Transcode %1 → %2").arg(transcoded.join(QStringLiteral(" + ")), container);
+    }
+    return QString();
+}
+
+QString postCostName(PostCost cost) {
+    switch (cost) {
+    case PostCost::None:
+        return QStringLiteral("none");
+    case PostCost::StreamCopy:
+        return QStringLiteral("stream-copy");
+    case PostCost::Transcode:
+        return QStringLiteral("transcode");
+    }
+    return QString();
+}
+
+QString codecFamily(const QString &codec) {
+    const QString name = codec.section(QLatin1Char('.'), 0, 0).trimmed().toLower();
+    if (name.isEmpty() || name == QStringLiteral("none")) {
+        return QString();
+    }
+    return kCodecFamilies.value(name, name);
+}
+
+bool containerAccepts(const QString &container, const QString &codec) {
+    const QString family = codecFamily(codec);
+    const auto it = kContainerCodecs.constFind(container.toLower());
+    // Unknown codecs and containers are given the benefit of the doubt.
+    if (family.isEmpty() || it == kContainerCodecs.constEnd()) {
+        return true;
+    }
+    return it->contains(family);
+}
+
+RemuxPlan planRemux(const FormatStore &store, const FormatRow *video, const FormatRow *audio, const QString &container) {
+    RemuxPlan plan;
+    if (!video) {
+        return plan;
+    }
+    const bool automatic = container == kAuto;
+    const bool progressive = video->isProgressive();
+    if (progressive) {
+        plan.container = automatic ? video->ext : container;
+        if (sameContainer(plan.container, video->ext)) {
+            return plan;
+        }
+        plan.remux = true;
+    } else {
+        plan.merge = true;
+        plan.container = automatic ? pickMergeContainer(video->ext, audio ? audio->ext : QString()) : container;
+    }
+
+    const QString audioCodec = progressive ? video->acodec : (audio ? audio->acodec : QString());
+    if (!containerAccepts(plan.container, video->vcodec)) {
+        plan.transcoded << QStringLiteral("video");
+    }
+    if (!containerAccepts(plan.container, audioCodec)) {
+        plan.transcoded << QStringLiteral("audio");
+    }
+    plan.cost = plan.transcoded.isEmpty() ? PostCost::StreamCopy : PostCost::Transcode;
+    if (plan.cost == PostCost::Transcode && containerAccepts(kCopyContainer, video->vcodec) && containerAccepts(kCopyContainer, audioCodec)) {
+        plan.copyContainer = kCopyContainer;
+    }
+
+    if (plan.merge) {
+        plan.progressiveIndex = equivalentProgressive(store, *video, automatic ? QString() : container);
+        if (plan.transcoded == QStringList{QStringLiteral("audio")}) {
+            plan.audioIndex = compatibleAudio(store, plan.container);
+        }
+    }
+    return plan;
+}
+
+RemuxPlan planAudioConversion(const FormatRow *audio, const QString &format) {
+    RemuxPlan plan;
+    if (!audio || format == QStringLiteral("original")) {
+        plan.container = audio ? audio->ext : QString();
+        return plan;
+    }
+    plan.container = format;
+    const QString family = codecFamily(audio->acodec);
+    const bool copy = (format == QStringLiteral("m4a") && family == QStringLiteral("aac"))
+                      || (format == QStringLiteral("mp3") && family == QStringLiteral("mp3"))
+                      || (format == QStringLiteral("opus") && family == QStringLiteral("opus"));
+    if (copy) {
+        plan.cost = PostCost::StreamCopy;
+        plan.remux = true;
+    } else {
+        plan.cost = PostCost::Transcode;
+        plan.transcoded << QStringLiteral("audio");
+    }
+    return plan;
+}
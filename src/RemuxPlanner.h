@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include "FormatModel.h"
+
+enum class PostCost { None, StreamCopy, Transcode };
+
+struct RemuxPlan {
+    PostCost cost = PostCost::None;
+    QString container;
+    bool merge = false;
+    bool remux = false;
+    QStringList transcoded;
+    QString copyContainer;
+    int progressiveIndex = -1;
+    int audioIndex = -1;
+
+    QString summary() const;
+};
+
+QString postCostName(PostCost cost);
+QString codecFamily(const QString &codec);
+bool containerAccepts(const QString &container, const QString &codec);
+RemuxPlan planRemux(const FormatStore &store, const FormatRow *video, const FormatRow *audio, const QString &container);
+RemuxPlan planAudioConversion(const FormatRow *audio, const QString &format);
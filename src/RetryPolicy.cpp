@@ -0,0 +1,111 @@
+#include "RetryPolicy.h"
+
+#include <QRandomGenerator>
+#include <algorithm>
+
+namespace {
+constexpr qint64 kNetworkBaseDelayMs = 2000;
+constexpr qint64 kRateLimitBaseDelayMs = 15000;
+constexpr qint64 kMaxDelayMs = 5 * 60 * 1000;
+constexpr int kBreakerThreshold = 3;
+constexpr qint64 kBreakerBaseCooldownMs = 2 * 60 * 1000;
+constexpr qint64 kBreakerMaxCooldownMs = 30 * 60 * 1000;
+
+bool containsAny(const QString &text, std::initializer_list<const char *> needles) {
+    for (const char *needle : needles) {
+        if (text.contains(QLatin1String(needle))) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+QString failureKindName(FailureKind kind) {
+    switch (kind) {
+    case FailureKind::None:
+        return QStringLiteral("none");
+    case FailureKind::RateLimited:
+        return QStringLiteral("rate limited");
+    case FailureKind::Throttled:
+        return QStringLiteral("throttled");
+    case FailureKind::Auth:
+        return QStringLiteral("authentication/cookies");
+    case FailureKind::NotFound:
+        return QStringLiteral("not found");
+    case FailureKind::Network:
+        return QStringLiteral("network");
+    case FailureKind::Unknown:
+        return QStringLiteral("unknown");
+    }
+    return QString();
+}
+
+FailureKind classifyFailure(int exitCode, const QStringList &errorLines) {
+    if (exitCode == 0) {
+        return FailureKind::None;
+    }
+    if (exitCode < 0) {
+        return FailureKind::Unknown;
+    }
+    const QString text = errorLines.join(QLatin1Char('\n')).toLower();
+    if (containsAny(text, {"http error 429", "too many requests", "rate-limit", "rate limit"})) {
+        return FailureKind::RateLimited;
+    }
+    if (containsAny(text, {"sign in", "login required", "cookies", "members-only", "private video", "http error 401"})) {
+        return FailureKind::Auth;
+    }
+    if (containsAny(text, {"http error 404", "video unavailable", "not available", "does not exist", "has been removed",
+                           "unsupported url"})) {
+        return FailureKind::NotFound;
+    }
+    if (containsAny(text, {"http error 403", "throttl"})) {
+        return FailureKind::Throttled;
+    }
+    if (containsAny(text, {"timed out", "connection reset", "connection refused", "connection aborted", "incompleteread",
+                           "temporary failure in name resolution", "name or service not known", "network is unreachable",
+                           "http error 5", "remote end closed", "[ssl:", "sslerror", "ssleoferror", "_ssl.c"})) {
+        return FailureKind::Network;
+    }
+    return FailureKind::Unknown;
+}
+
+bool isTransientFailure(FailureKind kind) {
+    return kind == FailureKind::RateLimited || kind == FailureKind::Throttled || kind == FailureKind::Network;
+}
+
+qint64 retryDelayMs(FailureKind kind, int attempt) {
+    const qint64 base = kind == FailureKind::RateLimited ? kRateLimitBaseDelayMs : kNetworkBaseDelayMs;
+    const qint64 ceiling = std::min(kMaxDelayMs, base << std::clamp(attempt, 0, 16));
+    return ceiling / 2 + static_cast<qint64>(QRandomGenerator::global()->bounded(static_cast<double>(ceiling / 2 + 1)));
+}
+
+bool HostCircuitBreaker::isOpen(const QString &host, qint64 nowMs) const {
+    return remainingMs(host, nowMs) > 0;
+}
+
+qint64 HostCircuitBreaker::remainingMs(const QString &host, qint64 nowMs) const {
+    const auto it = hosts.constFind(host);
+    if (it == hosts.constEnd()) {
+        return 0;
+    }
+    return std::max<qint64>(0, it->openUntilMs - nowMs);
+}
+
+bool HostCircuitBreaker::recordRateLimit(const QString &host, qint64 nowMs) {
+    State &state = hosts[host];
+    if (state.openUntilMs > nowMs) {
+        return false;
+    }
+    if (++state.strikes < kBreakerThreshold) {
+        return false;
+    }
+    state.cooldownMs = state.cooldownMs == 0 ? kBreakerBaseCooldownMs : std::min(state.cooldownMs * 2, kBreakerMaxCooldownMs);
+    state.openUntilMs = nowMs + state.cooldownMs;
+    state.strikes = kBreakerThreshold - 1;
+    return true;
+}
+
+void HostCircuitBreaker::recordSuccess(const QString &host) {
+    hosts.remove(host);
+}
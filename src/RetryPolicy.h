@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+enum class FailureKind { None, RateLimited, Throttled, Auth, NotFound, Network, Unknown };
+
+QString failureKindName(FailureKind kind);
+FailureKind classifyFailure(int exitCode, const QStringList &errorLines);
+bool isTransientFailure(FailureKind kind);
+qint64 retryDelayMs(FailureKind kind, int attempt);
+
+class HostCircuitBreaker {
+public:
+    bool isOpen(const QString &host, qint64 nowMs) const;
+    qint64 remainingMs(const QString &host, qint64 nowMs) const;
+    bool recordRateLimit(const QString &host, qint64 nowMs);
+    void recordSuccess(const QString &host);
+
+private:
+    struct State {
+        int strikes = 0;
+        qint64 openUntilMs = 0;
+        qint64 cooldownMs = 0;
+    };
+
+    QHash<QString, State> hosts;
+};
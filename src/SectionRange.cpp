@@ -0,0 +1,94 @@
+#include "SectionRange.h"
+
+#include <cmath>
+
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+
+std::optional<double> parseTimestamp(const QString &text) {
+    const QStringList parts = text.trimmed().split(QLatin1Char(':'));
+    if (parts.isEmpty() || parts.size() > 3) {
+        return std::nullopt;
+    }
+    double seconds = 0.0;
+    for (qsizetype i = 0; i < parts.size(); ++i) {
+        bool ok = false;
+        const double value = parts.at(i).toDouble(&ok);
+        const bool last = i == parts.size() - 1;
+        if (!ok || value < 0.0 || (!last && value != std::floor(value)) || (i > 0 && value >= 60.0)) {
+            return std::nullopt;
+        }
+        seconds = seconds * 60.0 + value;
+    }
+    return seconds;
+}
+
+QString formatTimestamp(double seconds) {
+    const auto millis = static_cast<qint64>(std::llround(std::max(0.0, seconds) * 1000.0));
+    const qint64 whole = millis / 1000;
+    const QChar zero = QLatin1Char('0');
+    QString text = whole >= 3600 ? QStringLiteral("%1:%2:%3").arg(whole / 3600).arg(whole / 60 % 60, 2, 10, zero).arg(whole % 60, 2, 10, zero)
+                                 : QStringLiteral("%1:%2").arg(whole / 60).arg(whole % 60, 2, 10, zero);
+    if (millis % 1000 != 0) {
+        text += QStringLiteral(".%1").arg(millis % 1000, 3, 10, zero);
+    }
+    return text;
+}
+
+std::optional<SectionRange> parseSectionRange(const QString &text, double duration) {
+    const qsizetype dash = text.indexOf(QLatin1Char('-'));
+    if (dash < 0) {
+        return std::nullopt;
+    }
+    const QString startText = text.left(dash).trimmed();
+    const QString endText = text.mid(dash + 1).trimmed();
+
+    SectionRange range;
+    if (!startText.isEmpty()) {
+        const std::optional<double> start = parseTimestamp(startText);
+        if (!start) {
+            return std::nullopt;
+        }
+        range.start = start.value();
+    }
+    if (endText.isEmpty()) {
+        if (duration <= 0.0) {
+            return std::nullopt;
+        }
+        range.end = duration;
+    } else {
+        const std::optional<double> end = parseTimestamp(endText);
+        if (!end) {
+            return std::nullopt;
+        }
+        range.end = duration > 0.0 ? std::min(end.value(), duration) : end.value();
+    }
+    if (range.end <= range.start) {
+        return std::nullopt;
+    }
+    return range;
+}
+
+QString formatSectionRange(const SectionRange &range) {
+    return formatTimestamp(range.start) + QLatin1Char('-') + formatTimestamp(range.end);
+}
+
+QString sectionArgument(const SectionRange &range) {
+    return QStringLiteral("*%1-%2").arg(range.start, 0, 'f', 3).arg(range.end, 0, 'f', 3);
+}
+
+QList<SectionRange> chaptersFromInfo(const QJsonArray &chapters, double duration) {
+    QList<SectionRange> ranges;
+    for (const QJsonValue &value : chapters) {
+        const QJsonObject chapter = value.toObject();
+        SectionRange range;
+        range.start = chapter.value(QStringLiteral("start_time")).toDouble();
+        range.end = chapter.value(QStringLiteral("end_time")).toDouble(duration);
+        range.title = chapter.value(QStringLiteral("title")).toString();
+        if (range.end > range.start) {
+            ranges << range;
+        }
+    }
+    return ranges;
+}
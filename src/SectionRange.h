@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+
+#include <QJsonArray>
+#include <QList>
+#include <QString>
+
+struct SectionRange {
+    double start = 0.0;
+    double end = 0.0;
+    QString title;
+
+    double length() const { return end - start; }
+};
+
+std::optional<double> parseTimestamp(const QString &text);
+QString formatTimestamp(double seconds);
+std::optional<SectionRange> parseSectionRange(const QString &text, double duration);
+QString formatSectionRange(const SectionRange &range);
+QString sectionArgument(const SectionRange &range);
+QList<SectionRange> chaptersFromInfo(const QJsonArray &chapters, double duration);
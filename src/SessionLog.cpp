@@ -0,0 +1,623 @@
+#include "SessionLog.h"
+
+#include <QColor>
+#include <QDateTime>
+#include <QDir>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+constexpr quint32 kMaxFileBytes = 4 * 1024 * 1024;
+constexpr int kMaxFilesInView = 8;
+constexpr int kMaxRetainedFiles = 32;
+constexpr int kFlushDelayMs = 100;
+constexpr int kScanChunkLines = 2000;
+
+char severityCode(LogSeverity severity) {
+    switch (severity) {
+    case LogSeverity::Debug:
+        return 'D';
+    case LogSeverity::Warning:
+        return 'W';
+    case LogSeverity::Error:
+        return 'E';
+    default:
+        return 'I';
+    }
+}
+
+QString severityName(LogSeverity severity) {
+    switch (severity) {
+    case LogSeverity::Debug:
+        return QStringLiteral("debug");
+    case LogSeverity::Warning:
+        return QStringLiteral("warning");
+    case LogSeverity::Error:
+        return QStringLiteral("error");
+    default:
+        return QStringLiteral("info");
+    }
+}
+
+char asciiLower(char ch) {
+    return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+bool containsAsciiIgnoreCase(const char *hay, qsizetype hayLen, const QByteArray &lowerNeedle) {
+    const qsizetype n = lowerNeedle.size();
+    if (n == 0) {
+        return true;
+    }
+    for (qsizetype i = 0; i + n <= hayLen; ++i) {
+        qsizetype j = 0;
+        while (j < n && asciiLower(hay[i + j]) == lowerNeedle.at(j)) {
+            ++j;
+        }
+        if (j == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+qsizetype textOffset(const QByteArray &raw) {
+    qsizetype pos = -1;
+    for (int field = 0; field < 3; ++field) {
+        pos = raw.indexOf('\t', pos + 1);
+        if (pos == -1) {
+            return 0;
+        }
+    }
+    return pos + 1;
+}
+}
+
+SessionLogWriter::SessionLogWriter(const QString &directory, const QString &sessionName)
+    : QObject(nullptr),
+      directory(directory),
+      sessionName(sessionName),
+      openSeq(-1) {
+}
+
+void SessionLogWriter::write(int fileSeq, const QByteArray &bytes, qint64 linesWritten) {
+    if (fileSeq != openSeq) {
+        openFile(fileSeq);
+    }
+    if (file.isOpen()) {
+        file.write(bytes);
+        file.flush();
+    }
+    emit written(linesWritten);
+}
+
+void SessionLogWriter::openFile(int fileSeq) {
+    if (file.isOpen()) {
+        file.close();
+    }
+    file.setFileName(QDir(directory).filePath(SessionLog::fileName(sessionName, fileSeq)));
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+    openSeq = fileSeq;
+    pruneDirectory();
+}
+
+void SessionLogWriter::pruneDirectory() {
+    QDir dir(directory);
+    QStringList names = dir.entryList({QStringLiteral("session-*.log")}, QDir::Files, QDir::Name);
+    while (names.size() > kMaxRetainedFiles) {
+        dir.remove(names.takeFirst());
+    }
+}
+
+SessionLog::SessionLog(QObject *parent)
+    : QObject(parent),
+      writer(nullptr),
+      first(0),
+      currentSeq(0),
+      currentOffset(0),
+      outboxSeq(0),
+      flushScheduled(false),
+      unwrittenBase(0) {
+    logDir = QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath(QStringLiteral("logs"));
+    QDir().mkpath(logDir);
+    sessionName = QStringLiteral("session-") + QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-HHmmss"));
+
+    writer = new SessionLogWriter(logDir, sessionName);
+    writer->moveToThread(&writerThread);
+    connect(&writerThread, &QThread::finished, writer, &QObject::deleteLater);
+    connect(writer, &SessionLogWriter::written, this, &SessionLog::onWritten);
+    writerThread.setObjectName(QStringLiteral("session-log"));
+    writerThread.start();
+}
+
+SessionLog::~SessionLog() {
+    flushOutbox();
+    QMetaObject::invokeMethod(writer, []() {}, Qt::BlockingQueuedConnection);
+    writerThread.quit();
+    writerThread.wait();
+    for (auto it = maps.begin(); it != maps.end(); ++it) {
+        if (it->data) {
+            it->file->unmap(it->data);
+        }
+        delete it->file;
+    }
+}
+
+QString SessionLog::fileName(const QString &sessionName, int fileSeq) {
+    return QStringLiteral("%1-%2.log").arg(sessionName).arg(fileSeq, 4, 10, QLatin1Char('0'));
+}
+
+QString SessionLog::directory() const {
+    return logDir;
+}
+
+void SessionLog::append(const QString &text, LogSeverity severity, int jobId) {
+    const QByteArray prefix = QDateTime::currentDateTime().toString(Qt::ISODateWithMs).toLatin1()
+                              + '\t' + severityCode(severity) + '\t' + QByteArray::number(jobId) + '\t';
+    qint64 start = endLine();
+    qint64 added = 0;
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    for (QString line : lines) {
+        line.remove(QLatin1Char('\r'));
+        line.replace(QLatin1Char('\t'), QLatin1Char(' '));
+        if (line.trimmed().isEmpty()) {
+            continue;
+        }
+        QByteArray bytes = prefix + line.toUtf8() + '\n';
+        if (currentOffset > 0 && currentOffset + static_cast<quint32>(bytes.size()) > kMaxFileBytes) {
+            if (added > 0) {
+                emit linesAppended(start, added);
+            }
+            rotate();
+            start = endLine();
+            added = 0;
+        }
+        entries.append(Entry{currentOffset, static_cast<quint32>(bytes.size()), jobId, static_cast<quint16>(currentSeq), severity});
+        jobIndex[jobId].append(endLine() - 1);
+        if (severity >= LogSeverity::Warning) {
+            severityIndex[static_cast<std::size_t>(severity)].append(endLine() - 1);
+        }
+        currentOffset += static_cast<quint32>(bytes.size());
+        outboxSeq = currentSeq;
+        outbox += bytes;
+        unwritten.append(std::move(bytes));
+        ++added;
+    }
+    if (added > 0) {
+        emit linesAppended(start, added);
+        scheduleFlush();
+    }
+}
+
+void SessionLog::rotate() {
+    flushOutbox();
+    ++currentSeq;
+    currentOffset = 0;
+    outboxSeq = currentSeq;
+
+    const int oldestKept = currentSeq - kMaxFilesInView + 1;
+    qsizetype drop = 0;
+    while (drop < entries.size() && entries.at(drop).fileSeq < oldestKept) {
+        ++drop;
+    }
+    if (drop == 0) {
+        return;
+    }
+    for (int seq = entries.first().fileSeq; seq < oldestKept; ++seq) {
+        unmap(seq);
+    }
+    entries.remove(0, drop);
+    first += drop;
+    pruneIndex();
+    if (unwrittenBase < first) {
+        const qsizetype stale = std::min<qsizetype>(first - unwrittenBase, unwritten.size());
+        unwritten.remove(0, stale);
+        unwrittenBase += stale;
+    }
+    emit linesPruned(first);
+}
+
+void SessionLog::pruneIndex() {
+    const auto prune = [this](QList<qint64> &lines) {
+        lines.remove(0, std::lower_bound(lines.cbegin(), lines.cend(), first) - lines.cbegin());
+    };
+    for (QList<qint64> &lines : severityIndex) {
+        prune(lines);
+    }
+    for (auto it = jobIndex.begin(); it != jobIndex.end();) {
+        prune(*it);
+        it = it->isEmpty() ? jobIndex.erase(it) : std::next(it);
+    }
+}
+
+// The lines a job/severity filter can match, oldest first, or nothing when the filter has no index to use.
+std::optional<QList<qint64>> SessionLog::indexedLines(int jobId, LogSeverity minSeverity) const {
+    QList<qint64> lines;
+    if (jobId >= 0) {
+        const QList<qint64> ofJob = jobIndex.value(jobId);
+        for (qint64 line : ofJob) {
+            if (severityAt(line) >= minSeverity) {
+                lines.append(line);
+            }
+        }
+        return lines;
+    }
+    if (minSeverity < LogSeverity::Warning) {
+        return std::nullopt;
+    }
+    for (std::size_t severity = static_cast<std::size_t>(minSeverity); severity < severityIndex.size(); ++severity) {
+        const QList<qint64> &more = severityIndex[severity];
+        QList<qint64> merged;
+        merged.reserve(lines.size() + more.size());
+        std::merge(lines.cbegin(), lines.cend(), more.cbegin(), more.cend(), std::back_inserter(merged));
+        lines = std::move(merged);
+    }
+    return lines;
+}
+
+void SessionLog::scheduleFlush() {
+    if (flushScheduled) {
+        return;
+    }
+    flushScheduled = true;
+    QTimer::singleShot(kFlushDelayMs, this, [this]() {
+        flushScheduled = false;
+        flushOutbox();
+    });
+}
+
+void SessionLog::flushOutbox() {
+    if (outbox.isEmpty()) {
+        return;
+    }
+    const QByteArray bytes = outbox;
+    const int seq = outboxSeq;
+    const qint64 lines = endLine();
+    outbox.clear();
+    SessionLogWriter *target = writer;
+    QMetaObject::invokeMethod(target, [target, seq, bytes, lines]() {
+        target->write(seq, bytes, lines);
+    }, Qt::QueuedConnection);
+}
+
+void SessionLog::onWritten(qint64 linesWritten) {
+    const qsizetype drop = std::min<qsizetype>(std::max<qint64>(0, linesWritten - unwrittenBase), unwritten.size());
+    unwritten.remove(0, drop);
+    unwrittenBase += drop;
+}
+
+qint64 SessionLog::firstLine() const {
+    return first;
+}
+
+qint64 SessionLog::endLine() const {
+    return first + entries.size();
+}
+
+LogSeverity SessionLog::severityAt(qint64 line) const {
+    return entries.at(line - first).severity;
+}
+
+int SessionLog::jobAt(qint64 line) const {
+    return entries.at(line - first).jobId;
+}
+
+const uchar *SessionLog::mappedRange(int fileSeq, quint32 offset, quint32 length) {
+    MappedFile &mapped = maps[fileSeq];
+    if (!mapped.file) {
+        mapped.file = new QFile(QDir(logDir).filePath(fileName(sessionName, fileSeq)));
+        if (!mapped.file->open(QIODevice::ReadOnly)) {
+            delete mapped.file;
+            maps.remove(fileSeq);
+            return nullptr;
+        }
+    }
+    if (static_cast<qint64>(offset) + length > mapped.size) {
+        if (mapped.data) {
+            mapped.file->unmap(mapped.data);
+            mapped.data = nullptr;
+        }
+        mapped.size = mapped.file->size();
+        if (mapped.size > 0) {
+            mapped.data = mapped.file->map(0, mapped.size);
+        }
+        if (!mapped.data || static_cast<qint64>(offset) + length > mapped.size) {
+            mapped.size = 0;
+            return nullptr;
+        }
+    }
+    return mapped.data + offset;
+}
+
+void SessionLog::unmap(int fileSeq) {
+    const auto it = maps.find(fileSeq);
+    if (it == maps.end()) {
+        return;
+    }
+    if (it->data) {
+        it->file->unmap(it->data);
+    }
+    delete it->file;
+    maps.erase(it);
+}
+
+QByteArray SessionLog::rawAt(qint64 line) {
+    if (line < first || line >= endLine()) {
+        return QByteArray();
+    }
+    if (line >= unwrittenBase && line - unwrittenBase < unwritten.size()) {
+        return unwritten.at(line - unwrittenBase).chopped(1);
+    }
+    const Entry &entry = entries.at(line - first);
+    const uchar *data = mappedRange(entry.fileSeq, entry.offset, entry.length);
+    if (data) {
+        return QByteArray(reinterpret_cast<const char *>(data), entry.length - 1);
+    }
+    QFile fallback(QDir(logDir).filePath(fileName(sessionName, entry.fileSeq)));
+    if (!fallback.open(QIODevice::ReadOnly) || !fallback.seek(entry.offset)) {
+        return QByteArray();
+    }
+    return fallback.read(entry.length).chopped(1);
+}
+
+LogLine SessionLog::lineAt(qint64 line) {
+    LogLine out;
+    if (line < first || line >= endLine()) {
+        return out;
+    }
+    out.severity = severityAt(line);
+    out.jobId = jobAt(line);
+    const QByteArray raw = rawAt(line);
+    const qsizetype offset = textOffset(raw);
+    if (offset > 0) {
+        out.timestamp = QString::fromLatin1(raw.left(raw.indexOf('\t')));
+    }
+    out.text = QString::fromUtf8(raw.mid(offset));
+    return out;
+}
+
+SessionLogModel::SessionLogModel(SessionLog &log, QObject *parent)
+    : QAbstractListModel(parent),
+      log(log),
+      jobFilter(-1),
+      minSeverity(LogSeverity::Debug),
+      baseLine(log.firstLine()),
+      visibleEnd(log.endLine()),
+      scanPos(0),
+      scanFrom(visibleEnd) {
+    scanTimer.setSingleShot(true);
+    scanTimer.setInterval(0);
+    connect(&scanTimer, &QTimer::timeout, this, &SessionLogModel::scanStep);
+    connect(&log, &SessionLog::linesAppended, this, &SessionLogModel::onLinesAppended);
+    connect(&log, &SessionLog::linesPruned, this, &SessionLogModel::onLinesPruned);
+}
+
+bool SessionLogModel::isFiltering() const {
+    return jobFilter >= 0 || minSeverity > LogSeverity::Debug || !needle.isEmpty();
+}
+
+bool SessionLogModel::isScanning() const {
+    return scanPos < scanQueue.size() || scanFrom < visibleEnd;
+}
+
+int SessionLogModel::storedRows() const {
+    if (isFiltering()) {
+        return static_cast<int>(filtered.size());
+    }
+    return static_cast<int>(visibleEnd - baseLine);
+}
+
+qint64 SessionLogModel::lineForRow(int row) const {
+    return isFiltering() ? filtered.at(row) : baseLine + row;
+}
+
+int SessionLogModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) {
+        return 0;
+    }
+    return storedRows() + (liveLine.isEmpty() ? 0 : 1);
+}
+
+QVariant SessionLogModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() < 0 || index.row() >= rowCount()) {
+        return QVariant();
+    }
+    if (index.row() == storedRows()) {
+        return role == Qt::DisplayRole ? QVariant(liveLine) : QVariant();
+    }
+
+    const qint64 line = lineForRow(index.row());
+    switch (role) {
+    case Qt::DisplayRole: {
+        const LogLine entry = log.lineAt(line);
+        if (entry.jobId > 0) {
+            return QStringLiteral("#%1  %2").arg(entry.jobId).arg(entry.text);
+        }
+        return entry.text;
+    }
+    case Qt::ToolTipRole: {
+        const LogLine entry = log.lineAt(line);
+        return QStringLiteral("%1 • %2 • job %3").arg(entry.timestamp, severityName(entry.severity)).arg(entry.jobId);
+    }
+    case Qt::ForegroundRole:
+        switch (log.severityAt(line)) {
+        case LogSeverity::Error:
+            return QColor(220, 60, 60);
+        case LogSeverity::Warning:
+            return QColor(215, 140, 0);
+        case LogSeverity::Debug:
+            return QColor(Qt::gray);
+        default:
+            return QVariant();
+        }
+    default:
+        return QVariant();
+    }
+}
+
+bool SessionLogModel::matches(qint64 line) const {
+    if (log.severityAt(line) < minSeverity) {
+        return false;
+    }
+    if (jobFilter >= 0 && log.jobAt(line) != jobFilter) {
+        return false;
+    }
+    if (needle.isEmpty()) {
+        return true;
+    }
+    const QByteArray raw = log.rawAt(line);
+    const qsizetype offset = textOffset(raw);
+    if (!asciiNeedle.isEmpty()) {
+        return containsAsciiIgnoreCase(raw.constData() + offset, raw.size() - offset, asciiNeedle);
+    }
+    return QString::fromUtf8(raw.mid(offset)).contains(needle, Qt::CaseInsensitive);
+}
+
+void SessionLogModel::setFilter(int jobId, LogSeverity severity, const QString &text) {
+    beginResetModel();
+    jobFilter = jobId;
+    minSeverity = severity;
+    needle = text;
+    asciiNeedle.clear();
+    bool ascii = true;
+    for (const QChar ch : text) {
+        if (ch.unicode() > 0x7f) {
+            ascii = false;
+            break;
+        }
+    }
+    if (ascii) {
+        asciiNeedle = text.toLower().toLatin1();
+    }
+    baseLine = log.firstLine();
+    visibleEnd = log.endLine();
+    filtered.clear();
+    scanQueue.clear();
+    scanPos = 0;
+    scanFrom = visibleEnd;
+    if (isFiltering()) {
+        // Job and severity come from the log's index; only a text search has to read lines, and that runs in slices.
+        const std::optional<QList<qint64>> indexed = log.indexedLines(jobFilter, minSeverity);
+        if (!indexed) {
+            scanFrom = baseLine;
+        } else if (needle.isEmpty()) {
+            filtered = indexed.value();
+        } else {
+            scanQueue = indexed.value();
+        }
+    }
+    endResetModel();
+    if (isScanning()) {
+        scanTimer.start();
+    }
+}
+
+// Matches go in as they are found, so a search over a long log never holds up the event loop for long.
+void SessionLogModel::scanStep() {
+    QList<qint64> accepted;
+    int budget = kScanChunkLines;
+    while (budget > 0 && scanPos < scanQueue.size()) {
+        const qint64 line = scanQueue.at(scanPos++);
+        if (line >= baseLine && matches(line)) {
+            accepted.append(line);
+        }
+        --budget;
+    }
+    if (scanPos >= scanQueue.size()) {
+        scanQueue.clear();
+        scanPos = 0;
+    }
+    while (budget > 0 && scanQueue.isEmpty() && scanFrom < visibleEnd) {
+        if (matches(scanFrom)) {
+            accepted.append(scanFrom);
+        }
+        ++scanFrom;
+        --budget;
+    }
+    if (!accepted.isEmpty()) {
+        const int row = storedRows();
+        beginInsertRows(QModelIndex(), row, row + static_cast<int>(accepted.size()) - 1);
+        filtered.append(accepted);
+        endInsertRows();
+    }
+    if (isScanning()) {
+        scanTimer.start();
+    }
+}
+
+void SessionLogModel::setLiveLine(const QString &line) {
+    const bool had = !liveLine.isEmpty();
+    const bool has = !line.isEmpty();
+    const int row = storedRows();
+    if (had && has) {
+        liveLine = line;
+        emit dataChanged(index(row), index(row));
+    } else if (!had && has) {
+        beginInsertRows(QModelIndex(), row, row);
+        liveLine = line;
+        endInsertRows();
+    } else if (had && !has) {
+        beginRemoveRows(QModelIndex(), row, row);
+        liveLine.clear();
+        endRemoveRows();
+    }
+}
+
+void SessionLogModel::onLinesAppended(qint64 firstNew, qint64 count) {
+    if (!isFiltering()) {
+        const int row = storedRows();
+        beginInsertRows(QModelIndex(), row, row + static_cast<int>(count) - 1);
+        visibleEnd = firstNew + count;
+        scanFrom = visibleEnd;
+        endInsertRows();
+        return;
+    }
+    // New lines queue up behind a search that is still running, so rows stay in log order.
+    if (isScanning()) {
+        visibleEnd = firstNew + count;
+        return;
+    }
+    QList<qint64> accepted;
+    for (qint64 line = firstNew; line < firstNew + count; ++line) {
+        if (matches(line)) {
+            accepted.append(line);
+        }
+    }
+    visibleEnd = firstNew + count;
+    scanFrom = visibleEnd;
+    if (accepted.isEmpty()) {
+        return;
+    }
+    const int row = storedRows();
+    beginInsertRows(QModelIndex(), row, row + static_cast<int>(accepted.size()) - 1);
+    filtered.append(accepted);
+    endInsertRows();
+}
+
+void SessionLogModel::onLinesPruned(qint64 newFirstLine) {
+    if (!isFiltering()) {
+        const int drop = static_cast<int>(std::min(newFirstLine, visibleEnd) - baseLine);
+        if (drop > 0) {
+            beginRemoveRows(QModelIndex(), 0, drop - 1);
+            baseLine += drop;
+            endRemoveRows();
+        }
+        baseLine = std::max(baseLine, newFirstLine);
+        return;
+    }
+    baseLine = newFirstLine;
+    scanFrom = std::max(scanFrom, newFirstLine);
+    int drop = 0;
+    while (drop < filtered.size() && filtered.at(drop) < newFirstLine) {
+        ++drop;
+    }
+    if (drop > 0) {
+        beginRemoveRows(QModelIndex(), 0, drop - 1);
+        filtered.remove(0, drop);
+        endRemoveRows();
+    }
+}
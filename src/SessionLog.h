@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <optional>
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+
+enum class LogSeverity : quint8 { Debug, Info, Warning, Error };
+
+struct LogLine {
+    QString timestamp;
+    LogSeverity severity = LogSeverity::Info;
+    int jobId = 0;
+    QString text;
+};
+
+class SessionLogWriter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SessionLogWriter(const QString &directory, const QString &sessionName);
+
+public slots:
+    void write(int fileSeq, const QByteArray &bytes, qint64 linesWritten);
+
+signals:
+    void written(qint64 linesWritten);
+
+private:
+    void openFile(int fileSeq);
+    void pruneDirectory();
+
+    QString directory;
+    QString sessionName;
+    QFile file;
+    int openSeq;
+};
+
+class SessionLog : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SessionLog(QObject *parent = nullptr);
+    ~SessionLog() override;
+
+    void append(const QString &text, LogSeverity severity, int jobId);
+
+    qint64 firstLine() const;
+    qint64 endLine() const;
+    LogSeverity severityAt(qint64 line) const;
+    int jobAt(qint64 line) const;
+    QByteArray rawAt(qint64 line);
+    LogLine lineAt(qint64 line);
+    std::optional<QList<qint64>> indexedLines(int jobId, LogSeverity minSeverity) const;
+    QString directory() const;
+
+    static QString fileName(const QString &sessionName, int fileSeq);
+
+signals:
+    void linesAppended(qint64 first, qint64 count);
+    void linesPruned(qint64 newFirstLine);
+
+private slots:
+    void onWritten(qint64 linesWritten);
+
+private:
+    struct Entry {
+        quint32 offset;
+        quint32 length;
+        qint32 jobId;
+        quint16 fileSeq;
+        LogSeverity severity;
+    };
+
+    struct MappedFile {
+        QFile *file = nullptr;
+        uchar *data = nullptr;
+        qint64 size = 0;
+    };
+
+    void scheduleFlush();
+    void flushOutbox();
+    void rotate();
+    void pruneIndex();
+    const uchar *mappedRange(int fileSeq, quint32 offset, quint32 length);
+    void unmap(int fileSeq);
+
+    QString logDir;
+    QString sessionName;
+    QThread writerThread;
+    SessionLogWriter *writer;
+
+    QList<Entry> entries;
+    // Line numbers per job, and per severity for warnings and errors only; info lines are most of the log,
+    // and a filter that lets them through gains nothing from an index.
+    QHash<int, QList<qint64>> jobIndex;
+    std::array<QList<qint64>, 4> severityIndex;
+    qint64 first;
+    int currentSeq;
+    quint32 currentOffset;
+
+    QByteArray outbox;
+    int outboxSeq;
+    bool flushScheduled;
+    QList<QByteArray> unwritten;
+    qint64 unwrittenBase;
+
+    QHash<int, MappedFile> maps;
+};
+
+class SessionLogModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    explicit SessionLogModel(SessionLog &log, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void setFilter(int jobId, LogSeverity minSeverity, const QString &needle);
+    void setLiveLine(const QString &line);
+
+private slots:
+    void onLinesAppended(qint64 first, qint64 count);
+    void onLinesPruned(qint64 newFirstLine);
+
+private:
+    bool isFiltering() const;
+    bool isScanning() const;
+    bool matches(qint64 line) const;
+    void scanStep();
+    int storedRows() const;
+    qint64 lineForRow(int row) const;
+
+    SessionLog &log;
+    int jobFilter;
+    LogSeverity minSeverity;
+    qint64 baseLine;
+    qint64 visibleEnd;
+    QString needle;
+    QByteArray asciiNeedle;
+    QList<qint64> filtered;
+    QList<qint64> scanQueue;
+    qsizetype scanPos;
+    qint64 scanFrom;
+    QTimer scanTimer;
+    QString liveLine;
+};
@@ -0,0 +1,214 @@
+#include "StallWatchdog.h"
+
+#include <cmath>
+
+#include <QStringList>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <utility>
+
+#include "TraceRecorder.h"
+
+namespace {
+constexpr int kDefaultIntervalMs = 50;
+constexpr int kDefaultThresholdMs = 150;
+constexpr qint64 kTraceMinMicros = 200;
+constexpr qint64 kReportIntervalUs = 5 * 1000 * 1000;
+
+QString formatMicros(qint64 micros) {
+    if (micros >= 1000) {
+        return QString::number(static_cast<double>(micros) / 1000.0, 'f', 1) + QStringLiteral(" ms");
+    }
+    return QString::number(micros) + QStringLiteral(" us");
+}
+}
+
+int LatencyHistogram::bucketIndex(quint64 value) {
+    if (value < static_cast<quint64>(kSubBuckets)) {
+        return static_cast<int>(value);
+    }
+    const int msb = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+    const int shift = msb - (kSubBucketBits - 1);
+    const int sub = static_cast<int>(value >> shift);
+    return std::min(shift * kHalfBuckets + sub, kBucketCount - 1);
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<quint64>(index);
+    }
+    const int shift = index / kHalfBuckets - 1;
+    const quint64 sub = static_cast<quint64>(index - shift * kHalfBuckets);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 micros) {
+    const quint64 value = static_cast<quint64>(std::max<qint64>(micros, 0));
+    ++counts[static_cast<size_t>(bucketIndex(value))];
+    ++total;
+    maxSeen = std::max(maxSeen, static_cast<qint64>(value));
+}
+
+void LatencyHistogram::reset() {
+    counts.fill(0);
+    total = 0;
+    maxSeen = 0;
+}
+
+quint64 LatencyHistogram::count() const {
+    return total;
+}
+
+qint64 LatencyHistogram::maxValue() const {
+    return maxSeen;
+}
+
+qint64 LatencyHistogram::percentile(double pct) const {
+    if (total == 0) {
+        return 0;
+    }
+    const double clamped = std::clamp(pct, 0.0, 100.0);
+    const quint64 target = std::max<quint64>(1, static_cast<quint64>(std::ceil(clamped / 100.0 * static_cast<double>(total))));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += counts[static_cast<size_t>(i)];
+        if (seen >= target) {
+            return std::min(static_cast<qint64>(bucketUpperBound(i)), maxSeen);
+        }
+    }
+    return maxSeen;
+}
+
+QString LatencyHistogram::summary() const {
+    return QStringLiteral("n=%1 p50=%2 p90=%3 p99=%4 max=%5")
+        .arg(QString::number(total),
+             formatMicros(percentile(50.0)),
+             formatMicros(percentile(90.0)),
+             formatMicros(percentile(99.0)),
+             formatMicros(maxSeen));
+}
+
+StallWatchdog::Scope::Scope(StallWatchdog &watchdog, const char *handler)
+    : watchdog(watchdog),
+      previous(watchdog.current),
+      previousNested(watchdog.currentNested) {
+    watchdog.current = handler;
+    watchdog.currentNested = false;
+    timer.start();
+}
+
+StallWatchdog::Scope::~Scope() {
+    const char *handler = watchdog.current;
+    const bool nested = watchdog.currentNested;
+    watchdog.current = previous;
+    watchdog.currentNested = previousNested || nested;
+    if (!nested) {
+        watchdog.leaveScope(handler, timer.nsecsElapsed() / 1000);
+    }
+}
+
+StallWatchdog::StallWatchdog(QObject *parent)
+    : QObject(parent),
+      heartbeat(this),
+      lastBeatUs(0),
+      intervalMs(kDefaultIntervalMs),
+      thresholdMs(kDefaultThresholdMs),
+      enabled(false),
+      trace(nullptr),
+      current(nullptr),
+      currentNested(false),
+      longestSinceBeat(nullptr),
+      longestSinceBeatUs(0),
+      stallReportedSinceBeat(false),
+      lastReportUs(-kReportIntervalUs),
+      suppressedReports(0) {
+    clock.start();
+    heartbeat.setTimerType(Qt::PreciseTimer);
+    heartbeat.setInterval(intervalMs);
+    connect(&heartbeat, &QTimer::timeout, this, &StallWatchdog::onHeartbeat);
+}
+
+void StallWatchdog::setEnabled(bool on) {
+    enabled = on;
+    if (on) {
+        lastBeatUs = clock.nsecsElapsed() / 1000;
+        heartbeat.start();
+    } else {
+        heartbeat.stop();
+    }
+}
+
+bool StallWatchdog::isEnabled() const {
+    return enabled;
+}
+
+void StallWatchdog::setStallThreshold(int millis) {
+    thresholdMs = std::max(1, millis);
+}
+
+void StallWatchdog::setTrace(TraceRecorder *recorder) {
+    trace = recorder;
+}
+
+void StallWatchdog::leaveScope(const char *handler, qint64 micros) {
+    if (trace && handler && micros >= kTraceMinMicros && trace->isRecording()) {
+        trace->complete(TraceRecorder::kGuiTrack, QString::fromLatin1(handler), QStringLiteral("gui"), trace->nowUs() - micros, micros);
+    }
+    if (!enabled || !handler) {
+        return;
+    }
+    const QString name = QString::fromLatin1(handler);
+    handlerHistograms[name].record(micros);
+    if (micros > longestSinceBeatUs) {
+        longestSinceBeat = handler;
+        longestSinceBeatUs = micros;
+    }
+    if (micros >= static_cast<qint64>(thresholdMs) * 1000) {
+        stallReportedSinceBeat = true;
+        noteStall(name, micros / 1000);
+    }
+}
+
+// A GUI thread that keeps stalling would otherwise spend even more of its time logging about it.
+void StallWatchdog::noteStall(const QString &handler, qint64 millis) {
+    const qint64 now = clock.nsecsElapsed() / 1000;
+    if (now - lastReportUs < kReportIntervalUs) {
+        ++suppressedReports;
+        return;
+    }
+    lastReportUs = now;
+    emit stallDetected(handler, millis, std::exchange(suppressedReports, 0));
+}
+
+void StallWatchdog::onHeartbeat() {
+    if (current) {
+        currentNested = true;
+    }
+
+    const qint64 now = clock.nsecsElapsed() / 1000;
+    const qint64 lag = std::max<qint64>(0, now - lastBeatUs - static_cast<qint64>(intervalMs) * 1000);
+    lastBeatUs = now;
+    lagHistogram.record(lag);
+
+    if (lag >= static_cast<qint64>(thresholdMs) * 1000 && !stallReportedSinceBeat) {
+        const QString handler = current ? QString::fromLatin1(current)
+                                : longestSinceBeat ? QString::fromLatin1(longestSinceBeat)
+                                                   : QStringLiteral("unscoped");
+        noteStall(handler, lag / 1000);
+    }
+
+    longestSinceBeat = nullptr;
+    longestSinceBeatUs = 0;
+    stallReportedSinceBeat = false;
+}
+
+QString StallWatchdog::report() const {
+    QStringList lines;
+    lines << QStringLiteral("Event-loop lag: %1").arg(lagHistogram.summary());
+    QStringList names = handlerHistograms.keys();
+    names.sort();
+    for (const QString &name : std::as_const(names)) {
+        lines << QStringLiteral("  %1: %2").arg(name, handlerHistograms.value(name).summary());
+    }
+    return lines.join(QLatin1Char('\n'));
+}
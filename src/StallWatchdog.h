@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class TraceRecorder;
+
+class LatencyHistogram {
+public:
+    void record(qint64 micros);
+    void reset();
+    quint64 count() const;
+    qint64 maxValue() const;
+    qint64 percentile(double pct) const;
+    QString summary() const;
+
+private:
+    static constexpr int kSubBucketBits = 5;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kHalfBuckets = kSubBuckets / 2;
+    static constexpr int kMaxMagnitude = 40;
+    static constexpr int kBucketCount = (kMaxMagnitude - kSubBucketBits + 3) * kHalfBuckets;
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketUpperBound(int index);
+
+    std::array<quint64, kBucketCount> counts{};
+    quint64 total = 0;
+    qint64 maxSeen = 0;
+};
+
+class StallWatchdog : public QObject {
+    Q_OBJECT
+
+public:
+    class Scope {
+    public:
+        Scope(StallWatchdog &watchdog, const char *handler);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        StallWatchdog &watchdog;
+        const char *previous;
+        bool previousNested;
+        QElapsedTimer timer;
+    };
+
+    explicit StallWatchdog(QObject *parent = nullptr);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setStallThreshold(int millis);
+    void setTrace(TraceRecorder *recorder);
+    QString report() const;
+
+signals:
+    void stallDetected(const QString &handler, qint64 millis, int suppressed);
+
+private slots:
+    void onHeartbeat();
+
+private:
+    void leaveScope(const char *handler, qint64 micros);
+    void noteStall(const QString &handler, qint64 millis);
+
+    QTimer heartbeat;
+    QElapsedTimer clock;
+    qint64 lastBeatUs;
+    int intervalMs;
+    int thresholdMs;
+    bool enabled;
+    TraceRecorder *trace;
+
+    const char *current;
+    bool currentNested;
+    const char *longestSinceBeat;
+    qint64 longestSinceBeatUs;
+    bool stallReportedSinceBeat;
+    qint64 lastReportUs;
+    int suppressedReports;
+
+    LatencyHistogram lagHistogram;
+    QHash<QString, LatencyHistogram> handlerHistograms;
+};
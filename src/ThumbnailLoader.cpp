@@ -0,0 +1,176 @@
+#include "ThumbnailLoader.h"
+
+#include <QBuffer>
+#include <QImageReader>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kDecodeThreads = 2;
+constexpr int kDefaultConcurrent = 6;
+constexpr qint64 kDefaultMaxBytes = 2 * 1024 * 1024;
+constexpr qsizetype kCacheBytes = 16 * 1024 * 1024;
+}
+
+ThumbnailLoader::ThumbnailLoader(QNetworkAccessManager *manager, const QSize &tileSize, QObject *parent)
+    : QObject(parent),
+      manager(manager),
+      stopping(false),
+      tileSize(tileSize),
+      maxConcurrent(kDefaultConcurrent),
+      maxBytes(kDefaultMaxBytes),
+      tiles(kCacheBytes) {
+    pool.setMaxThreadCount(kDecodeThreads);
+    pool.setObjectName(QStringLiteral("thumbnail-decode"));
+}
+
+ThumbnailLoader::~ThumbnailLoader() {
+    stopping = true;
+    for (QNetworkReply *reply : std::as_const(inFlight)) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+    inFlight.clear();
+    pool.waitForDone();
+}
+
+void ThumbnailLoader::setMaxConcurrent(int count) {
+    maxConcurrent = std::max(1, count);
+    pump();
+}
+
+void ThumbnailLoader::setMaxBytes(qint64 bytes) {
+    maxBytes = bytes;
+}
+
+void ThumbnailLoader::add(int key, const QUrl &url) {
+    const QString scheme = url.scheme().toLower();
+    if (!url.isValid() || (scheme != QStringLiteral("http") && scheme != QStringLiteral("https"))) {
+        return;
+    }
+    urls.insert(key, url);
+}
+
+void ThumbnailLoader::remove(int key) {
+    if (QNetworkReply *reply = inFlight.take(key)) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+    urls.remove(key);
+    failed.remove(key);
+    wanted.removeAll(key);
+    tiles.remove(key);
+    pump();
+}
+
+void ThumbnailLoader::setVisible(const QList<int> &keys) {
+    wanted.clear();
+    for (int key : keys) {
+        if (urls.contains(key) && !failed.contains(key) && !tiles.contains(key)) {
+            wanted.append(key);
+        }
+    }
+    // Entries scrolled out of view give their slot to the ones now on screen.
+    const QSet<int> keep(wanted.cbegin(), wanted.cend());
+    for (auto it = inFlight.begin(); it != inFlight.end();) {
+        if (keep.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        QNetworkReply *reply = it.value();
+        it = inFlight.erase(it);
+        disconnect(reply, nullptr, this, nullptr);
+        reply->abort();
+        reply->deleteLater();
+    }
+    pump();
+}
+
+QImage ThumbnailLoader::tile(int key) const {
+    const QImage *image = tiles.object(key);
+    return image ? *image : QImage();
+}
+
+void ThumbnailLoader::pump() {
+    for (int key : std::as_const(wanted)) {
+        if (inFlight.size() >= maxConcurrent) {
+            return;
+        }
+        if (inFlight.contains(key) || decoding.contains(key)) {
+            continue;
+        }
+        QNetworkRequest request(urls.value(key));
+        request.setRawHeader("User-Agent", "Mozilla/5.0");
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+        QNetworkReply *reply = manager->get(request);
+        inFlight.insert(key, reply);
+        connect(reply, &QNetworkReply::downloadProgress, this, [this, key, reply](qint64 received, qint64 total) {
+            if (received > maxBytes || total > maxBytes) {
+                failed.insert(key);
+                reply->abort();
+            }
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, key, reply]() { onReplyFinished(key, reply); });
+    }
+}
+
+void ThumbnailLoader::onReplyFinished(int key, QNetworkReply *reply) {
+    reply->deleteLater();
+    if (inFlight.value(key) != reply) {
+        return;
+    }
+    inFlight.remove(key);
+    if (reply->error() != QNetworkReply::NoError || failed.contains(key)) {
+        failed.insert(key);
+        wanted.removeAll(key);
+        pump();
+        return;
+    }
+    decoding.insert(key);
+    decode(key, reply->readAll());
+    pump();
+}
+
+void ThumbnailLoader::decode(int key, const QByteArray &data) {
+    pool.start([this, key, data]() {
+        if (stopping.load()) {
+            return;
+        }
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        // Letting the reader scale lets JPEG decode straight to a fraction of the full size.
+        const QSize source = reader.size();
+        if (source.isValid()) {
+            reader.setScaledSize(source.scaled(tileSize, Qt::KeepAspectRatio));
+        }
+        QImage image = reader.read();
+        if (!image.isNull() && (image.width() > tileSize.width() || image.height() > tileSize.height())) {
+            image = image.scaled(tileSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        if (!image.isNull()) {
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        }
+        QMetaObject::invokeMethod(this, [this, key, image]() { onDecoded(key, image); }, Qt::QueuedConnection);
+    });
+}
+
+void ThumbnailLoader::onDecoded(int key, const QImage &image) {
+    decoding.remove(key);
+    wanted.removeAll(key);
+    if (!urls.contains(key)) {
+        return;
+    }
+    if (image.isNull()) {
+        failed.insert(key);
+        return;
+    }
+    tiles.insert(key, new QImage(image), std::max<qsizetype>(1, image.sizeInBytes()));
+    emit tileReady(key, image);
+}
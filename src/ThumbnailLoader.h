@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Fetches small preview tiles for list entries. Only entries the view reports as visible are
+// fetched, a bounded number at a time, and decoding happens on a worker pool. The network
+// manager is borrowed so tiles share connections with the rest of the window.
+class ThumbnailLoader : public QObject {
+    Q_OBJECT
+
+public:
+    ThumbnailLoader(QNetworkAccessManager *manager, const QSize &tileSize, QObject *parent = nullptr);
+    ~ThumbnailLoader() override;
+
+    void setMaxConcurrent(int count);
+    void setMaxBytes(qint64 bytes);
+    void add(int key, const QUrl &url);
+    void remove(int key);
+    void setVisible(const QList<int> &keys);
+    QImage tile(int key) const;
+
+signals:
+    void tileReady(int key, const QImage &tile);
+
+private:
+    void pump();
+    void onReplyFinished(int key, QNetworkReply *reply);
+    void decode(int key, const QByteArray &data);
+    void onDecoded(int key, const QImage &image);
+
+    QNetworkAccessManager *manager;
+    QThreadPool pool;
+    std::atomic_bool stopping;
+    QSize tileSize;
+    int maxConcurrent;
+    qint64 maxBytes;
+    QHash<int, QUrl> urls;
+    QSet<int> failed;
+    QList<int> wanted;
+    QHash<int, QNetworkReply *> inFlight;
+    QSet<int> decoding;
+    QCache<int, QImage> tiles;
+};
@@ -0,0 +1,172 @@
+#include "TraceRecorder.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kJobTrackBase = 100;
+constexpr qsizetype kMaxEvents = 200000;
+
+QJsonObject metadataEvent(const QString &name, qint64 pid, int track, const QJsonObject &args) {
+    return {{QStringLiteral("name"), name},
+            {QStringLiteral("ph"), QStringLiteral("M")},
+            {QStringLiteral("pid"), pid},
+            {QStringLiteral("tid"), track},
+            {QStringLiteral("args"), args}};
+}
+}
+
+int TraceRecorder::jobTrack(int jobId) {
+    return kJobTrackBase + jobId;
+}
+
+TraceRecorder::TraceRecorder()
+    : recording(false),
+      dropped(0) {
+    clock.start();
+}
+
+void TraceRecorder::start() {
+    events.clear();
+    open.clear();
+    dropped = 0;
+    clock.restart();
+    recording = true;
+}
+
+void TraceRecorder::stop() {
+    const QList<int> tracks = open.keys();
+    for (int track : tracks) {
+        endSpan(track);
+    }
+    recording = false;
+}
+
+bool TraceRecorder::isRecording() const {
+    return recording;
+}
+
+qint64 TraceRecorder::nowUs() const {
+    return clock.nsecsElapsed() / 1000;
+}
+
+void TraceRecorder::nameTrack(int track, const QString &name) {
+    trackNames.insert(track, name);
+}
+
+void TraceRecorder::setSpan(int track, const QString &name, const QString &category) {
+    if (!recording) {
+        return;
+    }
+    const auto it = open.constFind(track);
+    if (it != open.constEnd() && it->name == name) {
+        return;
+    }
+    endSpan(track);
+    open.insert(track, Event{name, category, track, nowUs(), -1});
+}
+
+void TraceRecorder::endSpan(int track) {
+    const auto it = open.find(track);
+    if (it == open.end()) {
+        return;
+    }
+    Event event = std::move(*it);
+    open.erase(it);
+    event.durationUs = std::max<qint64>(0, nowUs() - event.startUs);
+    append(std::move(event));
+}
+
+QString TraceRecorder::openSpan(int track) const {
+    const auto it = open.constFind(track);
+    return it == open.constEnd() ? QString() : it->name;
+}
+
+void TraceRecorder::complete(int track, const QString &name, const QString &category, qint64 startUs, qint64 durationUs) {
+    if (recording) {
+        append(Event{name, category, track, startUs, durationUs});
+    }
+}
+
+void TraceRecorder::instant(int track, const QString &name, const QString &category) {
+    if (recording) {
+        append(Event{name, category, track, nowUs(), -1});
+    }
+}
+
+void TraceRecorder::append(Event event) {
+    if (events.size() >= kMaxEvents) {
+        ++dropped;
+        return;
+    }
+    events.append(std::move(event));
+}
+
+bool TraceRecorder::write(const QString &path, QString *error) const {
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray out;
+    out.append(metadataEvent(QStringLiteral("process_name"), pid, 0, {{QStringLiteral("name"), QCoreApplication::applicationName()}}));
+    QHash<int, QString> names = trackNames;
+    names.insert(kGuiTrack, QStringLiteral("GUI thread"));
+    names.insert(kAnalysisTrack, QStringLiteral("Analysis"));
+    for (auto it = names.constBegin(); it != names.constEnd(); ++it) {
+        out.append(metadataEvent(QStringLiteral("thread_name"), pid, it.key(), {{QStringLiteral("name"), it.value()}}));
+        out.append(metadataEvent(QStringLiteral("thread_sort_index"), pid, it.key(), {{QStringLiteral("sort_index"), it.key()}}));
+    }
+
+    const qint64 now = nowUs();
+    auto encode = [&](const Event &event, bool unfinished) {
+        QJsonObject object{{QStringLiteral("name"), event.name},
+                           {QStringLiteral("cat"), event.category},
+                           {QStringLiteral("pid"), pid},
+                           {QStringLiteral("tid"), event.track},
+                           {QStringLiteral("ts"), event.startUs}};
+        if (unfinished) {
+            object.insert(QStringLiteral("ph"), QStringLiteral("X"));
+            object.insert(QStringLiteral("dur"), std::max<qint64>(0, now - event.startUs));
+            object.insert(QStringLiteral("args"), QJsonObject{{QStringLiteral("unfinished"), true}});
+        } else if (event.durationUs < 0) {
+            object.insert(QStringLiteral("ph"), QStringLiteral("i"));
+            object.insert(QStringLiteral("s"), QStringLiteral("t"));
+        } else {
+            object.insert(QStringLiteral("ph"), QStringLiteral("X"));
+            object.insert(QStringLiteral("dur"), event.durationUs);
+        }
+        out.append(object);
+    };
+    for (const Event &event : events) {
+        encode(event, false);
+    }
+    for (const Event &event : open) {
+        encode(event, true);
+    }
+
+    QJsonObject root{{QStringLiteral("traceEvents"), out}, {QStringLiteral("displayTimeUnit"), QStringLiteral("ms")}};
+    if (dropped > 0) {
+        root.insert(QStringLiteral("otherData"), QJsonObject{{QStringLiteral("droppedEvents"), dropped}});
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+// Collects spans for a Chrome trace-event file (chrome://tracing, ui.perfetto.dev).
+// Each track holds at most one open span; starting another one closes it.
+class TraceRecorder {
+public:
+    static constexpr int kGuiTrack = 1;
+    static constexpr int kAnalysisTrack = 2;
+    static int jobTrack(int jobId);
+
+    TraceRecorder();
+
+    void start();
+    void stop();
+    bool isRecording() const;
+    qint64 nowUs() const;
+
+    void nameTrack(int track, const QString &name);
+    void setSpan(int track, const QString &name, const QString &category);
+    void endSpan(int track);
+    QString openSpan(int track) const;
+    void complete(int track, const QString &name, const QString &category, qint64 startUs, qint64 durationUs);
+    void instant(int track, const QString &name, const QString &category);
+
+    bool write(const QString &path, QString *error) const;
+
+private:
+    struct Event {
+        QString name;
+        QString category;
+        int track = 0;
+        qint64 startUs = 0;
+        qint64 durationUs = -1;
+    };
+
+    void append(Event event);
+
+    QElapsedTimer clock;
+    bool recording;
+    QList<Event> events;
+    QHash<int, Event> open;
+    QHash<int, QString> trackNames;
+    qint64 dropped;
+};
@@ -1,10 +1,22 @@
 #include "MainWindow.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+
+#include "ControlServer.h"
 
 int main(int argc, char *argv[]) {
+    {
+        // Handing the URLs to a running instance needs no platform plugin, display connection or fonts.
+        const QCoreApplication probe(argc, argv);
+        if (ControlServer::forward(probe.arguments())) {
+            return 0;
+        }
+    }
     QApplication app(argc, argv);
+    const QList<QJsonObject> requests = ControlServer::requestsFromArguments(app.arguments());
     MainWindow window;
     window.show();
+    window.runControlRequests(requests);
     return app.exec();
 }
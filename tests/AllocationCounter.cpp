@@ -0,0 +1,204 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::atomic<std::uint64_t> allocationCount{0};
+std::atomic<std::int64_t> liveBytes{0};
+std::atomic<std::int64_t> peakLiveBytes{0};
+
+void noteAlloc(std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    const std::int64_t live = liveBytes.fetch_add(static_cast<std::int64_t>(size), std::memory_order_relaxed) + static_cast<std::int64_t>(size);
+    std::int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void noteFree(std::size_t size) noexcept {
+    liveBytes.fetch_sub(static_cast<std::int64_t>(size), std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+void *counted(void *p) noexcept {
+    if (p) {
+        noteAlloc(malloc_usable_size(p));
+    }
+    return p;
+}
+#endif
+}
+
+AllocationStats allocationStats() {
+    AllocationStats stats;
+    stats.allocations = allocationCount.load(std::memory_order_relaxed);
+    stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    stats.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void resetAllocationPeak() {
+    peakLiveBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+
+bool mallocCounted() {
+    return true;
+}
+
+// Defining the malloc family in the executable interposes it for the shared libraries as well;
+// glibc's own entry points do the work. Sizes are the usable sizes, so a free subtracts exactly
+// what its allocation added. The default operator new calls malloc and needs no replacing.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *p, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *p);
+
+void *malloc(std::size_t size) noexcept {
+    return counted(__libc_malloc(size));
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept {
+    return counted(__libc_calloc(count, size));
+}
+
+void *realloc(void *p, std::size_t size) noexcept {
+    const std::size_t old = p ? malloc_usable_size(p) : 0;
+    void *q = __libc_realloc(p, size);
+    if (q) {
+        noteFree(old);
+        counted(q);
+    } else if (p && size == 0) {
+        noteFree(old);
+    }
+    return q;
+}
+
+void free(void *p) noexcept {
+    if (p) {
+        noteFree(malloc_usable_size(p));
+    }
+    __libc_free(p);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) noexcept {
+    return counted(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    return counted(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size) noexcept {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *p = counted(__libc_memalign(alignment, size));
+    if (!p) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void *valloc(std::size_t size) noexcept {
+    return counted(__libc_memalign(static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)), size));
+}
+
+void *pvalloc(std::size_t size) noexcept {
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return counted(__libc_memalign(page, (size + page - 1) / page * page));
+}
+}
+
+#else
+
+bool mallocCounted() {
+    return false;
+}
+
+namespace {
+// Each block carries its size in front of the pointer handed out, so frees can be accounted for.
+constexpr std::size_t kHeader = alignof(std::max_align_t);
+
+void *countedAlloc(std::size_t size) noexcept {
+    void *block = std::malloc(size + kHeader);
+    if (!block) {
+        return nullptr;
+    }
+    *static_cast<std::size_t *>(block) = size;
+    noteAlloc(size);
+    return static_cast<char *>(block) + kHeader;
+}
+
+void *countedAllocOrThrow(std::size_t size) {
+    if (void *p = countedAlloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void countedFree(void *p) noexcept {
+    if (!p) {
+        return;
+    }
+    char *block = static_cast<char *>(p) - kHeader;
+    noteFree(*reinterpret_cast<std::size_t *>(block));
+    std::free(block);
+}
+}
+
+// The aligned (std::align_val_t) forms are left to the runtime; they pair with their own deletes.
+void *operator new(std::size_t size) {
+    return countedAllocOrThrow(size);
+}
+
+void *operator new[](std::size_t size) {
+    return countedAllocOrThrow(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *p) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void *p) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    countedFree(p);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations made by the test binary and every library it loads. With glibc the
+// malloc family itself is interposed, so Qt's QString, QByteArray and container buffers are
+// seen. Elsewhere only the global operator new is replaced, which misses everything Qt
+// allocates with malloc; mallocCounted() is false then and those figures are not comparable.
+struct AllocationStats {
+    std::uint64_t allocations = 0;
+    std::int64_t liveBytes = 0;
+    std::int64_t peakLiveBytes = 0;
+};
+
+AllocationStats allocationStats();
+void resetAllocationPeak();
+bool mallocCounted();
@@ -0,0 +1,115 @@
+#include <QtTest>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include "JobQueue.h"
+
+class JobQueueTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void hostKey_data();
+    void hostKey();
+    void hostKeyIgnoresIdnaForm();
+    void servesHostsInTurn();
+
+private:
+    JobSpec spec(const QString &url, JobPriority priority = JobPriority::Normal) const;
+
+    QTemporaryDir outputDir;
+    QTemporaryDir emptyPath;
+    QByteArray savedPath;
+    QThread ioThread;
+};
+
+void JobQueueTest::initTestCase() {
+    QVERIFY(outputDir.isValid());
+    QVERIFY(emptyPath.isValid());
+    // Scheduling is decided before any process runs; keep a real yt-dlp from being found and started.
+    savedPath = qgetenv("PATH");
+    qputenv("PATH", QFile::encodeName(emptyPath.path()));
+    ioThread.start();
+}
+
+void JobQueueTest::cleanupTestCase() {
+    ioThread.quit();
+    ioThread.wait();
+    qputenv("PATH", savedPath);
+}
+
+JobSpec JobQueueTest::spec(const QString &url, JobPriority priority) const {
+    JobSpec spec;
+    spec.url = url;
+    spec.label = url;
+    spec.priority = priority;
+    spec.outputDir = outputDir.path();
+    spec.outputTemplate = QStringLiteral("%(title)s.%(ext)s");
+    return spec;
+}
+
+void JobQueueTest::hostKey_data() {
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<QString>("key");
+
+    QTest::newRow("www") << QStringLiteral("https://www.youtube.com/watch?v=x") << QStringLiteral("youtube.com");
+    QTest::newRow("cdn subdomain") << QStringLiteral("https://rr3---sn-abc.googlevideo.com/videoplayback") << QStringLiteral("googlevideo.com");
+    QTest::newRow("case and port") << QStringLiteral("https://Media.Example.COM:8443/a") << QStringLiteral("example.com");
+    QTest::newRow("second level") << QStringLiteral("https://news.bbc.co.uk/a") << QStringLiteral("bbc.co.uk");
+    QTest::newRow("bare second level") << QStringLiteral("https://foo.co.jp/") << QStringLiteral("foo.co.jp");
+    QTest::newRow("plain country code") << QStringLiteral("https://a.b.example.jp/") << QStringLiteral("example.jp");
+    QTest::newRow("single label") << QStringLiteral("http://localhost:8080/v") << QStringLiteral("localhost");
+    QTest::newRow("ipv4") << QStringLiteral("http://192.168.1.10:8000/v") << QStringLiteral("192.168.1.10");
+    QTest::newRow("ipv6") << QStringLiteral("http://[2001:db8::1]:8080/v") << QStringLiteral("2001:db8::1");
+}
+
+void JobQueueTest::hostKey() {
+    QFETCH(QString, url);
+    QFETCH(QString, key);
+
+    QCOMPARE(hostKeyOf(url), key);
+}
+
+void JobQueueTest::hostKeyIgnoresIdnaForm() {
+    const QString key = hostKeyOf(QStringLiteral("https://www.bücher.de/a"));
+    QVERIFY(!key.isEmpty());
+    QCOMPARE(hostKeyOf(QStringLiteral("https://cdn.xn--bcher-kva.de/b")), key);
+    QCOMPARE(hostKeyOf(QStringLiteral("https://WWW.BÜCHER.DE/c")), key);
+}
+
+// Each extra slot goes to the host served longest ago, unless a higher priority is waiting.
+void JobQueueTest::servesHostsInTurn() {
+    JobQueue queue(&ioThread);
+    queue.setDiskAware(false);
+    queue.setMaxDownloads(1);
+    queue.setDefaultHostLimits({2, 16});
+
+    const int a1 = queue.enqueue(spec(QStringLiteral("https://www.a.example/1")));
+    const int a2 = queue.enqueue(spec(QStringLiteral("https://cdn.a.example/2")));
+    const int b1 = queue.enqueue(spec(QStringLiteral("https://b.example/1")));
+    QCOMPARE(queue.job(a1)->state, JobState::Downloading);
+    QCOMPARE(queue.job(a2)->state, JobState::Queued);
+    QCOMPARE(queue.job(b1)->state, JobState::Queued);
+
+    queue.setMaxDownloads(2);
+    QCOMPARE(queue.job(b1)->state, JobState::Downloading);
+    QCOMPARE(queue.job(a2)->state, JobState::Queued);
+
+    const int b2 = queue.enqueue(spec(QStringLiteral("https://b.example/2")));
+    const int a3 = queue.enqueue(spec(QStringLiteral("https://a.example/3"), JobPriority::High));
+    queue.setMaxDownloads(3);
+    QCOMPARE(queue.job(a3)->state, JobState::Downloading);
+    QCOMPARE(queue.job(a2)->state, JobState::Queued);
+    QCOMPARE(queue.job(b2)->state, JobState::Queued);
+
+    // Host a is at its two-job limit, so the older a2 waits and b2 goes.
+    queue.setMaxDownloads(4);
+    QCOMPARE(queue.job(b2)->state, JobState::Downloading);
+    QCOMPARE(queue.job(a2)->state, JobState::Queued);
+}
+
+QTEST_GUILESS_MAIN(JobQueueTest)
+#include "JobQueueTest.moc"
@@ -0,0 +1,303 @@
+// Replays analysis payloads and a long progress stream through ProcessWorker, FormatStore,
+// ProgressModel and SessionLog, and compares allocation counts and memory against
+// memory-budgets.json. The payloads come from this executable itself (--emit <fixture>),
+// so the worker reads them from a real child process exactly as it reads yt-dlp.
+
+#include <cstdio>
+#include <functional>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <utility>
+
+#include "AllocationCounter.h"
+#include "FormatModel.h"
+#include "MemoryProbe.h"
+#include "ProcessWorker.h"
+#include "ProgressModel.h"
+#include "SectionRange.h"
+#include "SessionLog.h"
+
+namespace {
+constexpr int kLadderFormats = 300;
+constexpr int kPlaylistEntries = 5000;
+constexpr int kProgressLines = 50000;
+constexpr int kFragments = 3000;
+
+struct Measurement {
+    qint64 allocations = -1;
+    qint64 peakLiveKB = -1;
+    qint64 retainedKB = -1;
+    qint64 heapRetainedKB = -1;
+    qint64 peakRssMB = -1;
+};
+
+QJsonObject formatObject(int index, bool video) {
+    QJsonArray fragments;
+    for (int i = 0; i < 8; ++i) {
+        fragments.append(QJsonObject{{QStringLiteral("url"), QStringLiteral("https://cdn.example.com/f%1/seg-%2.m4s").arg(index).arg(i)},
+                                     {QStringLiteral("duration"), 6.0}});
+    }
+    return {{QStringLiteral("format_id"), QString::number(100 + index)},
+            {QStringLiteral("ext"), video ? QStringLiteral("mp4") : QStringLiteral("m4a")},
+            {QStringLiteral("vcodec"), video ? QStringLiteral("avc1.64001F") : QStringLiteral("none")},
+            {QStringLiteral("acodec"), video ? QStringLiteral("none") : QStringLiteral("mp4a.40.2")},
+            {QStringLiteral("height"), video ? 144 + (index % 12) * 90 : QJsonValue()},
+            {QStringLiteral("fps"), video ? 30.0 : QJsonValue()},
+            {QStringLiteral("tbr"), 128.0 + index},
+            {QStringLiteral("format_note"), QStringLiteral("%1p").arg(144 + (index % 12) * 90)},
+            {QStringLiteral("protocol"), QStringLiteral("http_dash_segments")},
+            {QStringLiteral("filesize"), 1000000.0 * (index + 1)},
+            {QStringLiteral("url"), QStringLiteral("https://cdn.example.com/videoplayback?itag=%1&expire=1900000000&sig=%2")
+                                        .arg(index)
+                                        .arg(QString(64, QLatin1Char('a' + index % 26)))},
+            {QStringLiteral("http_headers"), QJsonObject{{QStringLiteral("User-Agent"), QStringLiteral("Mozilla/5.0")},
+                                                         {QStringLiteral("Accept"), QStringLiteral("*/*")}}},
+            {QStringLiteral("fragments"), fragments}};
+}
+
+QJsonObject videoInfo(const QString &id, int formatCount) {
+    QJsonArray formats;
+    for (int i = 0; i < formatCount; ++i) {
+        formats.append(formatObject(i, i % 3 != 0));
+    }
+    QJsonArray chapters;
+    for (int i = 0; i < 40; ++i) {
+        chapters.append(QJsonObject{{QStringLiteral("start_time"), i * 90.0},
+                                    {QStringLiteral("end_time"), (i + 1) * 90.0},
+                                    {QStringLiteral("title"), QStringLiteral("Chapter %1").arg(i + 1)}});
+    }
+    return {{QStringLiteral("id"), id},
+            {QStringLiteral("title"), QStringLiteral("Fixture video %1").arg(id)},
+            {QStringLiteral("duration"), 3600.0},
+            {QStringLiteral("thumbnail"), QStringLiteral("https://i.example.com/vi/%1/maxresdefault.jpg").arg(id)},
+            {QStringLiteral("description"), QString(2000, QLatin1Char('d'))},
+            {QStringLiteral("chapters"), chapters},
+            {QStringLiteral("formats"), formats}};
+}
+
+QJsonObject playlistInfo() {
+    QJsonArray entries;
+    for (int i = 0; i < kPlaylistEntries; ++i) {
+        const QString id = QStringLiteral("entry%1").arg(i, 5, 10, QLatin1Char('0'));
+        QJsonArray thumbnails;
+        for (int size : {120, 320, 480}) {
+            thumbnails.append(QJsonObject{{QStringLiteral("url"), QStringLiteral("https://i.example.com/vi/%1/%2.jpg").arg(id).arg(size)},
+                                          {QStringLiteral("width"), size}});
+        }
+        entries.append(QJsonObject{{QStringLiteral("id"), id},
+                                   {QStringLiteral("title"), QStringLiteral("Playlist entry %1").arg(i)},
+                                   {QStringLiteral("url"), QStringLiteral("https://www.example.com/watch?v=%1").arg(id)},
+                                   {QStringLiteral("duration"), 60.0 + i},
+                                   {QStringLiteral("thumbnails"), thumbnails}});
+    }
+    return {{QStringLiteral("_type"), QStringLiteral("playlist")},
+            {QStringLiteral("id"), QStringLiteral("PLfixture")},
+            {QStringLiteral("title"), QStringLiteral("Fixture playlist")},
+            {QStringLiteral("entries"), entries}};
+}
+
+void writeOut(const QByteArray &bytes) {
+    std::fwrite(bytes.constData(), 1, static_cast<size_t>(bytes.size()), stdout);
+}
+
+// Mirrors yt-dlp's --newline output for a fragmented video+audio download and its merge.
+void emitProgress() {
+    writeOut("[youtube] fixture: Downloading webpage\n[info] fixture: Downloading 1 format(s): 137+140\n");
+    const int half = kProgressLines / 2;
+    for (int stream = 0; stream < 2; ++stream) {
+        writeOut(QStringLiteral("[download] Destination: /tmp/fixture.f%1.mp4\n").arg(stream == 0 ? 137 : 140).toUtf8());
+        for (int i = 1; i <= half; ++i) {
+            const double percent = 100.0 * i / half;
+            const int fragment = std::max(1, kFragments * i / half);
+            writeOut(QStringLiteral("[download] %1% of ~  1.00GiB at    %2MiB/s ETA 00:%3 (frag %4/%5)\n")
+                         .arg(percent, 5, 'f', 1)
+                         .arg(2.0 + (i % 7) * 0.25, 0, 'f', 2)
+                         .arg((half - i) % 60, 2, 10, QLatin1Char('0'))
+                         .arg(fragment)
+                         .arg(kFragments)
+                         .toUtf8());
+        }
+    }
+    writeOut("[Merger] Merging formats into \"/tmp/fixture.mp4\"\n");
+}
+
+int emitFixture(const QString &kind) {
+    if (kind == QStringLiteral("single")) {
+        writeOut(QJsonDocument(videoInfo(QStringLiteral("single"), 25)).toJson(QJsonDocument::Compact));
+    } else if (kind == QStringLiteral("ladder")) {
+        writeOut(QJsonDocument(videoInfo(QStringLiteral("ladder"), kLadderFormats)).toJson(QJsonDocument::Compact));
+    } else if (kind == QStringLiteral("playlist")) {
+        writeOut(QJsonDocument(playlistInfo()).toJson(QJsonDocument::Compact));
+    } else if (kind == QStringLiteral("progress")) {
+        emitProgress();
+    } else {
+        return 2;
+    }
+    writeOut("\n");
+    std::fflush(stdout);
+    return 0;
+}
+
+QStringList emitArgs(const QString &kind) {
+    return {QStringLiteral("--emit"), kind};
+}
+
+bool runAnalysis(const QString &kind) {
+    FormatStore store;
+    bool parsed = false;
+    {
+        ProcessWorker worker(ProcessWorker::Mode::Analysis);
+        QEventLoop loop;
+        QObject::connect(&worker, &ProcessWorker::analysisFinished, &loop,
+                         [&](int exitCode, QProcess::ExitStatus, const QJsonObject &data, bool ok, const QString &, qint64, qint64) {
+                             parsed = ok && exitCode == 0;
+                             if (parsed) {
+                                 store.populate(data.value(QStringLiteral("formats")).toArray());
+                                 const QList<SectionRange> chapters =
+                                     chaptersFromInfo(data.value(QStringLiteral("chapters")).toArray(), data.value(QStringLiteral("duration")).toDouble());
+                                 parsed = kind == QStringLiteral("playlist") ? data.value(QStringLiteral("entries")).toArray().size() == kPlaylistEntries
+                                                                             : store.size() > 0 && !chapters.isEmpty();
+                             }
+                             loop.quit();
+                         });
+        worker.start(QCoreApplication::applicationFilePath(), emitArgs(kind));
+        loop.exec();
+    }
+    return parsed;
+}
+
+bool runProgress(SessionLog &log) {
+    ProcessWorker worker(ProcessWorker::Mode::Download);
+    ProgressModel progress;
+    progress.plan({1073741824, 134217728}, 0.05);
+    QElapsedTimer clock;
+    clock.start();
+    qint64 events = 0;
+    bool ok = false;
+    QEventLoop loop;
+    QObject::connect(&worker, &ProcessWorker::progressAvailable, &loop, [&]() {
+        if (const std::optional<ProgressEvent> event = worker.takeProgress()) {
+            ++events;
+            if (event->bytesPerSecond > 0.0) {
+                progress.sampleSpeed(event->bytesPerSecond, clock.elapsed());
+            }
+            if (event->percent >= 0.0) {
+                progress.streamProgress(event->stream, event->percent, clock.elapsed());
+            }
+        }
+    });
+    QObject::connect(&worker, &ProcessWorker::logLines, &loop, [&](const QStringList &lines) {
+        for (const QString &line : lines) {
+            log.append(line, LogSeverity::Info, 1);
+        }
+    });
+    QObject::connect(&worker, &ProcessWorker::downloadFinished, &loop, [&](int exitCode, QProcess::ExitStatus status) {
+        ok = status == QProcess::NormalExit && exitCode == 0 && events > 0 && progress.percent() > 90.0;
+        loop.quit();
+    });
+    worker.start(QCoreApplication::applicationFilePath(), emitArgs(QStringLiteral("progress")));
+    loop.exec();
+    return ok;
+}
+
+Measurement measure(const std::function<bool()> &scenario, bool *ok) {
+    releaseFreeHeap();
+    const bool peakReset = resetPeakResident();
+    resetAllocationPeak();
+    const MemorySample before = sampleMemory();
+    const AllocationStats start = allocationStats();
+
+    *ok = scenario();
+    QCoreApplication::processEvents();
+
+    const AllocationStats end = allocationStats();
+    const MemorySample peak = sampleMemory();
+    releaseFreeHeap();
+    const MemorySample after = sampleMemory();
+
+    Measurement m;
+    // Counting only operator new would miss the string, JSON and log buffers these scenarios are about.
+    if (mallocCounted()) {
+        m.allocations = static_cast<qint64>(end.allocations - start.allocations);
+        m.peakLiveKB = (end.peakLiveBytes - start.liveBytes) / 1024;
+        m.retainedKB = (end.liveBytes - start.liveBytes) / 1024;
+    }
+    if (before.heapInUseBytes >= 0 && after.heapInUseBytes >= 0) {
+        m.heapRetainedKB = (after.heapInUseBytes - before.heapInUseBytes) / 1024;
+    }
+    if (peakReset && peak.peakResidentBytes >= 0) {
+        m.peakRssMB = peak.peakResidentBytes / (1024 * 1024);
+    }
+    return m;
+}
+
+// A budget of -1 or a metric the platform cannot measure is skipped.
+bool withinBudget(QTextStream &out, const QString &name, const QString &metric, qint64 value, const QJsonObject &budget) {
+    const qint64 limit = budget.value(metric).toInteger(-1);
+    const bool checked = limit >= 0 && value >= 0;
+    const bool ok = !checked || value <= limit;
+    out << QStringLiteral("  %1 %2: %3").arg(name, metric).arg(value);
+    if (checked) {
+        out << QStringLiteral(" / %1%2").arg(limit).arg(ok ? QString() : QStringLiteral("  OVER BUDGET"));
+    }
+    out << Qt::endl;
+    return ok;
+}
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && qstrcmp(argv[1], "--emit") == 0) {
+        return emitFixture(QString::fromLocal8Bit(argv[2]));
+    }
+
+    QCoreApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    QTextStream out(stdout);
+    const QStringList args = app.arguments();
+    if (args.size() < 2) {
+        out << "usage: memory-regression <memory-budgets.json>" << Qt::endl;
+        return 2;
+    }
+    QFile budgetFile(args.at(1));
+    if (!budgetFile.open(QIODevice::ReadOnly)) {
+        out << "cannot read " << args.at(1) << Qt::endl;
+        return 2;
+    }
+    const QJsonObject budgets = QJsonDocument::fromJson(budgetFile.readAll()).object();
+
+    SessionLog log;
+    // Metatype registration, regex compilation and plugin loading happen once; keep them out of the numbers.
+    runAnalysis(QStringLiteral("single"));
+
+    const QList<std::pair<QString, std::function<bool()>>> scenarios = {
+        {QStringLiteral("single-video"), []() { return runAnalysis(QStringLiteral("single")); }},
+        {QStringLiteral("format-ladder"), []() { return runAnalysis(QStringLiteral("ladder")); }},
+        {QStringLiteral("playlist"), []() { return runAnalysis(QStringLiteral("playlist")); }},
+        {QStringLiteral("progress-stream"), [&log]() { return runProgress(log); }},
+    };
+
+    bool pass = true;
+    for (const auto &[name, scenario] : scenarios) {
+        bool ok = false;
+        const Measurement m = measure(scenario, &ok);
+        const QJsonObject budget = budgets.value(name).toObject();
+        out << name << (ok ? "" : "  FAILED TO RUN") << Qt::endl;
+        pass = ok && pass;
+        pass = withinBudget(out, name, QStringLiteral("allocations"), m.allocations, budget) && pass;
+        pass = withinBudget(out, name, QStringLiteral("peakLiveKB"), m.peakLiveKB, budget) && pass;
+        pass = withinBudget(out, name, QStringLiteral("retainedKB"), m.retainedKB, budget) && pass;
+        pass = withinBudget(out, name, QStringLiteral("heapRetainedKB"), m.heapRetainedKB, budget) && pass;
+        pass = withinBudget(out, name, QStringLiteral("peakRssMB"), m.peakRssMB, budget) && pass;
+    }
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <QtTest>
+
+#include "ProcessWorker.h"
+
+class OutputParserTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void speedUnits_data();
+    void speedUnits();
+    void speedMissing();
+    void percentAndFragments();
+    void ffmpegElapsed();
+};
+
+void OutputParserTest::speedUnits_data() {
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<double>("bytesPerSecond");
+
+    QTest::newRow("bytes") << QStringLiteral("[download]  12.0% of 10.00MiB at 123B/s ETA 00:10") << 123.0;
+    QTest::newRow("decimal kilo") << QStringLiteral("[download]  12.0% of 10.00MiB at 2.5KB/s ETA 00:10") << 2500.0;
+    QTest::newRow("binary kilo") << QStringLiteral("[download]  12.0% of 10.00MiB at 2.00KiB/s ETA 00:10") << 2048.0;
+    QTest::newRow("binary mega") << QStringLiteral("[download]  12.0% of 10.00MiB at  1.50MiB/s ETA 00:10") << 1572864.0;
+    QTest::newRow("estimated") << QStringLiteral("[download]  12.0% of ~10.00MiB at ~ 3.00GiB/s ETA 00:10") << 3221225472.0;
+}
+
+void OutputParserTest::speedUnits() {
+    QFETCH(QString, line);
+    QFETCH(double, bytesPerSecond);
+
+    const OutputParser parser;
+    const std::optional<double> speed = parser.speedOf(line);
+    QVERIFY(speed.has_value());
+    QCOMPARE(speed.value(), bytesPerSecond);
+}
+
+void OutputParserTest::speedMissing() {
+    const OutputParser parser;
+    QVERIFY(!parser.speedOf(QStringLiteral("[download]  12.0% of 10.00MiB at Unknown B/s ETA Unknown")).has_value());
+    QVERIFY(!parser.speedOf(QStringLiteral("[download] Destination: video.mp4")).has_value());
+}
+
+void OutputParserTest::percentAndFragments() {
+    const OutputParser parser;
+    const QString line = QStringLiteral("[download]  42.5% of ~ 1.00GiB at 2.00MiB/s ETA 00:30 (frag 17/40)");
+    QCOMPARE(parser.percentOf(line).value_or(-1.0), 42.5);
+    const std::optional<std::pair<int, int>> frags = parser.fragmentsOf(line);
+    QVERIFY(frags.has_value());
+    QCOMPARE(frags->first, 17);
+    QCOMPARE(frags->second, 40);
+    QVERIFY(!parser.percentOf(QStringLiteral("[download] 250% of 1.00MiB")).has_value());
+}
+
+void OutputParserTest::ffmpegElapsed() {
+    const OutputParser parser;
+    const QString line = QStringLiteral("frame=  100 fps= 25 q=-1.0 size=    1024kB time=01:02:03.50 bitrate= 512.0kbits/s speed=2.0x");
+    QCOMPARE(parser.elapsedOf(line).value_or(-1.0), 3723.5);
+}
+
+QTEST_APPLESS_MAIN(OutputParserTest)
+#include "OutputParserTest.moc"
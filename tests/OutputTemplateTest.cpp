@@ -0,0 +1,78 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include "OutputTemplate.h"
+
+class OutputTemplateTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void evaluate_data();
+    void evaluate();
+    void reportsUnresolvedFields();
+    void listsTopLevelFields();
+    void sanitizesSeparators();
+};
+
+void OutputTemplateTest::evaluate_data() {
+    QTest::addColumn<QString>("outputTemplate");
+    QTest::addColumn<QJsonObject>("info");
+    QTest::addColumn<QString>("expected");
+
+    const QJsonObject clip{{QStringLiteral("title"), QStringLiteral("Clip")},
+                           {QStringLiteral("id"), QStringLiteral("abc")},
+                           {QStringLiteral("ext"), QStringLiteral("mp4")}};
+
+    QTest::newRow("plain") << QStringLiteral("%(title)s [%(id)s].%(ext)s") << clip << QStringLiteral("Clip [abc].mp4");
+    QTest::newRow("escaped percent") << QStringLiteral("%%(title)s") << clip << QStringLiteral("%(title)s");
+    QTest::newRow("missing") << QStringLiteral("%(artist)s") << QJsonObject() << QStringLiteral("NA");
+    QTest::newRow("fallback") << QStringLiteral("%(artist|Unknown)s") << QJsonObject() << QStringLiteral("Unknown");
+    QTest::newRow("alternatives") << QStringLiteral("%(uploader,channel)s") << QJsonObject{{QStringLiteral("channel"), QStringLiteral("Chan")}}
+                                  << QStringLiteral("Chan");
+    QTest::newRow("zero padded") << QStringLiteral("%(playlist_index)03d") << QJsonObject{{QStringLiteral("playlist_index"), 7}}
+                                 << QStringLiteral("007");
+    QTest::newRow("date") << QStringLiteral("%(upload_date>%Y-%m-%d)s") << QJsonObject{{QStringLiteral("upload_date"), QStringLiteral("20240131")}}
+                          << QStringLiteral("2024-01-31");
+    QTest::newRow("replacement") << QStringLiteral("%(series&{} - |)s%(title)s")
+                                 << QJsonObject{{QStringLiteral("series"), QStringLiteral("S")}, {QStringLiteral("title"), QStringLiteral("Clip")}}
+                                 << QStringLiteral("S - Clip");
+    QTest::newRow("replacement unset") << QStringLiteral("%(series&{} - |)s%(title)s") << clip << QStringLiteral("Clip");
+    QTest::newRow("negative index")
+        << QStringLiteral("%(formats.-1.format_id)s")
+        << QJsonObject{{QStringLiteral("formats"), QJsonArray{QJsonObject{{QStringLiteral("format_id"), QStringLiteral("a")}},
+                                                              QJsonObject{{QStringLiteral("format_id"), QStringLiteral("b")}}}}}
+        << QStringLiteral("b");
+    QTest::newRow("byte precision") << QStringLiteral("%(title).5B") << QJsonObject{{QStringLiteral("title"), QStringLiteral("ééé")}}
+                                    << QStringLiteral("éé");
+}
+
+void OutputTemplateTest::evaluate() {
+    QFETCH(QString, outputTemplate);
+    QFETCH(QJsonObject, info);
+    QFETCH(QString, expected);
+
+    QCOMPARE(evaluateOutputTemplate(outputTemplate, info), expected);
+}
+
+void OutputTemplateTest::reportsUnresolvedFields() {
+    QStringList unresolved;
+    const QJsonObject info{{QStringLiteral("title"), QStringLiteral("Clip")}};
+    evaluateOutputTemplate(QStringLiteral("%(title)s %(chapters.0.title)s %(artist|x)s"), info, &unresolved);
+    QCOMPARE(unresolved, (QStringList{QStringLiteral("chapters"), QStringLiteral("artist")}));
+}
+
+void OutputTemplateTest::listsTopLevelFields() {
+    QCOMPARE(outputTemplateFields(QStringLiteral("%(title)s-%(formats.0.height)d %%(skip)s")),
+             (QStringList{QStringLiteral("title"), QStringLiteral("formats")}));
+}
+
+void OutputTemplateTest::sanitizesSeparators() {
+    const QJsonObject info{{QStringLiteral("title"), QStringLiteral("a/b: c?")}};
+    QCOMPARE(evaluateOutputTemplate(QStringLiteral("%(title)s"), info), QStringLiteral("a⧸b： c？"));
+    QCOMPARE(sanitizeFilenameField(QStringLiteral("x\\y\nz")), QStringLiteral("x⧹y z"));
+}
+
+QTEST_APPLESS_MAIN(OutputTemplateTest)
+#include "OutputTemplateTest.moc"
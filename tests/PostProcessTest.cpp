@@ -0,0 +1,152 @@
+#include <QtTest>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <memory>
+
+#include "PostProcess.h"
+
+namespace {
+const QStringList kPreamble{QStringLiteral("-hide_banner"), QStringLiteral("-nostdin"), QStringLiteral("-y"),
+                            QStringLiteral("-loglevel"),    QStringLiteral("error"),    QStringLiteral("-progress"),
+                            QStringLiteral("pipe:1"),       QStringLiteral("-nostats")};
+
+void touch(const QTemporaryDir &dir, const QString &name) {
+    QFile file(dir.filePath(name));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+}
+
+PostPlan mergePlan(const QString &container = QStringLiteral("auto")) {
+    PostPlan plan;
+    plan.enabled = true;
+    plan.videoId = QStringLiteral("137");
+    plan.audioId = QStringLiteral("140");
+    plan.container = container;
+    return plan;
+}
+}
+
+class PostProcessTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void mergesStreams();
+    void remuxesVideoOnly();
+    void missingStreamFails();
+    void embedsThumbnailAsPicture();
+    void attachesThumbnailToMkv();
+    void skipsThumbnailElsewhere();
+    void picksMergeContainer();
+    void stagingTemplateTagsFormat();
+
+private:
+    std::unique_ptr<QTemporaryDir> staging;
+};
+
+void PostProcessTest::init() {
+    staging = std::make_unique<QTemporaryDir>();
+    QVERIFY(staging->isValid());
+    touch(*staging, QStringLiteral("Title.f137.mp4"));
+    touch(*staging, QStringLiteral("Title.f140.m4a"));
+    touch(*staging, QStringLiteral("Title.f137.mp4.part"));
+    touch(*staging, QStringLiteral("Title.info.json"));
+}
+
+void PostProcessTest::mergesStreams() {
+    const QString outputDir = staging->filePath(QStringLiteral("out"));
+    QString error;
+    const std::optional<PostCommand> command = buildMergeCommand(mergePlan(), staging->path(), outputDir, &error);
+    QVERIFY2(command, qPrintable(error));
+
+    const QString temp = staging->filePath(QStringLiteral("Title.merged.mp4"));
+    QCOMPARE(command->finalOutput, QDir(outputDir).filePath(QStringLiteral("Title.mp4")));
+    QCOMPARE(command->tempOutput, temp);
+    const QStringList expected = kPreamble
+                                 + QStringList{QStringLiteral("-i"), staging->filePath(QStringLiteral("Title.f137.mp4")),
+                                               QStringLiteral("-i"), staging->filePath(QStringLiteral("Title.f140.m4a")),
+                                               QStringLiteral("-map"), QStringLiteral("0:v:0"), QStringLiteral("-map"),
+                                               QStringLiteral("1:a:0"), QStringLiteral("-c"), QStringLiteral("copy"), temp};
+    QCOMPARE(command->args, expected);
+    QCOMPARE(command->description, QStringLiteral("merge → mp4"));
+}
+
+void PostProcessTest::remuxesVideoOnly() {
+    PostPlan plan = mergePlan(QStringLiteral("mkv"));
+    plan.audioId.clear();
+    const std::optional<PostCommand> command = buildMergeCommand(plan, staging->path(), staging->path(), nullptr);
+    QVERIFY(command);
+
+    const QString temp = staging->filePath(QStringLiteral("Title.merged.mkv"));
+    const QStringList expected = kPreamble
+                                 + QStringList{QStringLiteral("-i"), staging->filePath(QStringLiteral("Title.f137.mp4")),
+                                               QStringLiteral("-map"), QStringLiteral("0"), QStringLiteral("-c"), QStringLiteral("copy"), temp};
+    QCOMPARE(command->args, expected);
+    QCOMPARE(command->description, QStringLiteral("remux → mkv"));
+}
+
+void PostProcessTest::missingStreamFails() {
+    PostPlan plan = mergePlan();
+    plan.audioId = QStringLiteral("251");
+    QString error;
+    QVERIFY(!buildMergeCommand(plan, staging->path(), staging->path(), &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void PostProcessTest::embedsThumbnailAsPicture() {
+    touch(*staging, QStringLiteral("Title.jpg"));
+    PostPlan plan = mergePlan();
+    plan.embedThumbnail = true;
+    const std::optional<PostCommand> command = buildMergeCommand(plan, staging->path(), staging->path(), nullptr);
+    QVERIFY(command);
+
+    const QStringList &args = command->args;
+    QCOMPARE(args.count(QStringLiteral("-i")), 3);
+    QCOMPARE(args.at(args.lastIndexOf(QStringLiteral("-i")) + 1), staging->filePath(QStringLiteral("Title.jpg")));
+    QCOMPARE(args.at(args.indexOf(QStringLiteral("-disposition:v:1")) + 1), QStringLiteral("attached_pic"));
+    QVERIFY(args.contains(QStringLiteral("2:0")));
+    QCOMPARE(args.last(), command->tempOutput);
+    QCOMPARE(command->description, QStringLiteral("merge → mp4, embed thumbnail"));
+}
+
+void PostProcessTest::attachesThumbnailToMkv() {
+    touch(*staging, QStringLiteral("Title.jpg"));
+    PostPlan plan = mergePlan(QStringLiteral("mkv"));
+    plan.embedThumbnail = true;
+    const std::optional<PostCommand> command = buildMergeCommand(plan, staging->path(), staging->path(), nullptr);
+    QVERIFY(command);
+
+    const QStringList &args = command->args;
+    QCOMPARE(args.count(QStringLiteral("-i")), 2);
+    QCOMPARE(args.at(args.indexOf(QStringLiteral("-attach")) + 1), staging->filePath(QStringLiteral("Title.jpg")));
+    QVERIFY(!args.contains(QStringLiteral("-disposition:v:1")));
+    QCOMPARE(args.last(), command->tempOutput);
+}
+
+void PostProcessTest::skipsThumbnailElsewhere() {
+    touch(*staging, QStringLiteral("Title.jpg"));
+    PostPlan plan = mergePlan(QStringLiteral("webm"));
+    plan.embedThumbnail = true;
+    const std::optional<PostCommand> command = buildMergeCommand(plan, staging->path(), staging->path(), nullptr);
+    QVERIFY(command);
+    QCOMPARE(command->args.count(QStringLiteral("-i")), 2);
+    QVERIFY(!command->args.contains(QStringLiteral("-attach")));
+    QCOMPARE(command->description, QStringLiteral("merge → webm, thumbnail not embeddable in webm"));
+}
+
+void PostProcessTest::picksMergeContainer() {
+    QCOMPARE(pickMergeContainer(QStringLiteral("mp4"), QStringLiteral("m4a")), QStringLiteral("mp4"));
+    QCOMPARE(pickMergeContainer(QStringLiteral("webm"), QStringLiteral("opus")), QStringLiteral("webm"));
+    QCOMPARE(pickMergeContainer(QStringLiteral("mp4"), QStringLiteral("webm")), QStringLiteral("mkv"));
+    QCOMPARE(pickMergeContainer(QStringLiteral("mp4"), QString()), QStringLiteral("mp4"));
+    QCOMPARE(pickMergeContainer(QString(), QString()), QStringLiteral("mkv"));
+}
+
+void PostProcessTest::stagingTemplateTagsFormat() {
+    QCOMPARE(stagingTemplate(QStringLiteral("%(title)s.%(ext)s")), QStringLiteral("%(title)s.f%(format_id)s.%(ext)s"));
+    QCOMPARE(stagingTemplate(QStringLiteral("%(title)s")), QStringLiteral("%(title)s.f%(format_id)s.%(ext)s"));
+}
+
+QTEST_APPLESS_MAIN(PostProcessTest)
+#include "PostProcessTest.moc"
@@ -0,0 +1,57 @@
+#include <QtTest>
+
+#include "ProgressModel.h"
+
+class ProgressModelTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void streamsWeighByBytes();
+    void neverMovesBackwards();
+    void postAndSplitFillTheTail();
+    void freshModelStartsOver();
+};
+
+void ProgressModelTest::streamsWeighByBytes() {
+    ProgressModel model;
+    model.plan({300, 100}, 0.0);
+    model.streamProgress(0, 50.0, 0);
+    QCOMPARE(model.percent(), 37.5);
+    model.streamProgress(1, 50.0, 1000);
+    QCOMPARE(model.percent(), 87.5);
+}
+
+void ProgressModelTest::neverMovesBackwards() {
+    ProgressModel model;
+    model.plan({100, 100}, 0.0);
+    model.streamProgress(0, 80.0, 0);
+    model.streamProgress(0, 10.0, 500);
+    QCOMPARE(model.percent(), 40.0);
+}
+
+void ProgressModelTest::postAndSplitFillTheTail() {
+    ProgressModel model;
+    model.plan({100}, 0.1, 0.1);
+    model.streamProgress(0, 100.0, 0);
+    QCOMPARE(model.percent(), 80.0);
+    model.postProgress(100.0, 1000);
+    QCOMPARE(model.percent(), 90.0);
+    model.splitProgress(50.0, 2000);
+    QCOMPARE(model.percent(), 95.0);
+    model.finish();
+    QCOMPARE(model.percent(), 100.0);
+}
+
+void ProgressModelTest::freshModelStartsOver() {
+    ProgressModel model;
+    model.plan({100}, 0.0);
+    model.streamProgress(0, 90.0, 0);
+    model = ProgressModel();
+    model.plan({100}, 0.0);
+    model.streamProgress(0, 20.0, 1000);
+    QCOMPARE(model.percent(), 20.0);
+    QCOMPARE(model.etaSeconds(), -1.0);
+}
+
+QTEST_APPLESS_MAIN(ProgressModelTest)
+#include "ProgressModelTest.moc"
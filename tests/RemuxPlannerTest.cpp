@@ -0,0 +1,136 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include "RemuxPlanner.h"
+
+namespace {
+QJsonObject format(const QString &fid, const QString &ext, const QString &vcodec, const QString &acodec, int height, double tbr) {
+    QJsonObject f{{QStringLiteral("format_id"), fid},
+                  {QStringLiteral("ext"), ext},
+                  {QStringLiteral("vcodec"), vcodec},
+                  {QStringLiteral("acodec"), acodec},
+                  {QStringLiteral("tbr"), tbr}};
+    if (height > 0) {
+        f.insert(QStringLiteral("height"), height);
+    }
+    return f;
+}
+}
+
+class RemuxPlannerTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void codecFamilies();
+    void containerCodecs();
+    void mergeStreamCopy();
+    void mergeTranscodesVideo();
+    void mergeSuggestsCompatibleAudio();
+    void mergeFindsProgressive();
+    void progressiveNeedsNothing();
+    void progressiveRemux();
+    void audioConversion();
+
+private:
+    const FormatRow *row(const QString &fid) const { return &store.at(store.indexOf(fid)); }
+
+    FormatStore store;
+};
+
+void RemuxPlannerTest::initTestCase() {
+    store.populate(QJsonArray{
+        format(QStringLiteral("137"), QStringLiteral("mp4"), QStringLiteral("avc1.640028"), QStringLiteral("none"), 1080, 4000),
+        format(QStringLiteral("248"), QStringLiteral("webm"), QStringLiteral("vp9"), QStringLiteral("none"), 1080, 3000),
+        format(QStringLiteral("136"), QStringLiteral("mp4"), QStringLiteral("avc1.4d401f"), QStringLiteral("none"), 720, 1500),
+        format(QStringLiteral("22"), QStringLiteral("mp4"), QStringLiteral("avc1.64001F"), QStringLiteral("mp4a.40.2"), 720, 1200),
+        format(QStringLiteral("18"), QStringLiteral("mp4"), QStringLiteral("avc1.42001E"), QStringLiteral("mp4a.40.2"), 360, 500),
+        format(QStringLiteral("140"), QStringLiteral("m4a"), QStringLiteral("none"), QStringLiteral("mp4a.40.2"), 0, 129),
+        format(QStringLiteral("251"), QStringLiteral("webm"), QStringLiteral("none"), QStringLiteral("opus"), 0, 160),
+    });
+    QCOMPARE(store.size(), 7);
+}
+
+void RemuxPlannerTest::codecFamilies() {
+    QCOMPARE(codecFamily(QStringLiteral("avc1.64001F")), QStringLiteral("h264"));
+    QCOMPARE(codecFamily(QStringLiteral("vp09.00.40.08")), QStringLiteral("vp9"));
+    QCOMPARE(codecFamily(QStringLiteral("mp4a.40.2")), QStringLiteral("aac"));
+    QCOMPARE(codecFamily(QStringLiteral("opus")), QStringLiteral("opus"));
+    QCOMPARE(codecFamily(QStringLiteral("none")), QString());
+}
+
+void RemuxPlannerTest::containerCodecs() {
+    QVERIFY(containerAccepts(QStringLiteral("mp4"), QStringLiteral("opus")));
+    QVERIFY(containerAccepts(QStringLiteral("MP4"), QStringLiteral("avc1.64001F")));
+    QVERIFY(!containerAccepts(QStringLiteral("webm"), QStringLiteral("avc1.64001F")));
+    QVERIFY(!containerAccepts(QStringLiteral("webm"), QStringLiteral("mp4a.40.2")));
+    QVERIFY(containerAccepts(QStringLiteral("mkv"), QStringLiteral("avc1.64001F")));
+    QVERIFY(containerAccepts(QStringLiteral("webm"), QStringLiteral("none")));
+}
+
+void RemuxPlannerTest::mergeStreamCopy() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("137")), row(QStringLiteral("140")), QStringLiteral("auto"));
+    QCOMPARE(plan.cost, PostCost::StreamCopy);
+    QVERIFY(plan.merge);
+    QVERIFY(!plan.remux);
+    QCOMPARE(plan.container, QStringLiteral("mp4"));
+    QVERIFY(plan.transcoded.isEmpty());
+    QCOMPARE(plan.progressiveIndex, -1);
+}
+
+void RemuxPlannerTest::mergeTranscodesVideo() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("137")), row(QStringLiteral("251")), QStringLiteral("webm"));
+    QCOMPARE(plan.cost, PostCost::Transcode);
+    QCOMPARE(plan.container, QStringLiteral("webm"));
+    QCOMPARE(plan.transcoded, QStringList{QStringLiteral("video")});
+    QCOMPARE(plan.copyContainer, QStringLiteral("mkv"));
+    QCOMPARE(plan.audioIndex, -1);
+}
+
+void RemuxPlannerTest::mergeSuggestsCompatibleAudio() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("248")), row(QStringLiteral("140")), QStringLiteral("webm"));
+    QCOMPARE(plan.cost, PostCost::Transcode);
+    QCOMPARE(plan.transcoded, QStringList{QStringLiteral("audio")});
+    QCOMPARE(plan.audioIndex, store.indexOf(QStringLiteral("251")));
+}
+
+void RemuxPlannerTest::mergeFindsProgressive() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("136")), row(QStringLiteral("140")), QStringLiteral("auto"));
+    QCOMPARE(plan.cost, PostCost::StreamCopy);
+    QCOMPARE(plan.progressiveIndex, store.indexOf(QStringLiteral("22")));
+}
+
+void RemuxPlannerTest::progressiveNeedsNothing() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("18")), nullptr, QStringLiteral("auto"));
+    QCOMPARE(plan.cost, PostCost::None);
+    QCOMPARE(plan.container, QStringLiteral("mp4"));
+    QVERIFY(!plan.merge);
+    QVERIFY(!plan.remux);
+}
+
+void RemuxPlannerTest::progressiveRemux() {
+    const RemuxPlan plan = planRemux(store, row(QStringLiteral("18")), nullptr, QStringLiteral("mkv"));
+    QCOMPARE(plan.cost, PostCost::StreamCopy);
+    QVERIFY(plan.remux);
+    QVERIFY(!plan.merge);
+    QCOMPARE(plan.container, QStringLiteral("mkv"));
+}
+
+void RemuxPlannerTest::audioConversion() {
+    const RemuxPlan copy = planAudioConversion(row(QStringLiteral("140")), QStringLiteral("m4a"));
+    QCOMPARE(copy.cost, PostCost::StreamCopy);
+    QVERIFY(copy.remux);
+
+    const RemuxPlan transcode = planAudioConversion(row(QStringLiteral("251")), QStringLiteral("mp3"));
+    QCOMPARE(transcode.cost, PostCost::Transcode);
+    QCOMPARE(transcode.transcoded, QStringList{QStringLiteral("audio")});
+
+    const RemuxPlan original = planAudioConversion(row(QStringLiteral("251")), QStringLiteral("original"));
+    QCOMPARE(original.cost, PostCost::None);
+    QCOMPARE(original.container, QStringLiteral("webm"));
+}
+
+QTEST_APPLESS_MAIN(RemuxPlannerTest)
+#include "RemuxPlannerTest.moc"
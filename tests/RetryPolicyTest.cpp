@@ -0,0 +1,47 @@
+#include <QtTest>
+
+#include "RetryPolicy.h"
+
+Q_DECLARE_METATYPE(FailureKind)
+
+class RetryPolicyTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void classify_data();
+    void classify();
+    void delayStaysBounded();
+};
+
+void RetryPolicyTest::classify_data() {
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<FailureKind>("kind");
+
+    QTest::newRow("429") << QStringLiteral("ERROR: unable to download video data: HTTP Error 429: Too Many Requests") << FailureKind::RateLimited;
+    QTest::newRow("403") << QStringLiteral("ERROR: unable to download video data: HTTP Error 403: Forbidden") << FailureKind::Throttled;
+    QTest::newRow("ssl eof")
+        << QStringLiteral("ERROR: [SSL: UNEXPECTED_EOF_WHILE_READING] EOF occurred in violation of protocol (_ssl.c:1006)")
+        << FailureKind::Network;
+    QTest::newRow("ssl error") << QStringLiteral("ERROR: Unable to download webpage: SSLError(SSLZeroReturnError(6))") << FailureKind::Network;
+    QTest::newRow("ssl in title") << QStringLiteral("ERROR: Postprocessing: Conversion failed for Tussle at the Castle.mp4")
+                                  << FailureKind::Unknown;
+    QTest::newRow("ssl in id") << QStringLiteral("ERROR: [generic] Unable to extract: https://example.com/assl/clip") << FailureKind::Unknown;
+}
+
+void RetryPolicyTest::classify() {
+    QFETCH(QString, line);
+    QFETCH(FailureKind, kind);
+
+    QCOMPARE(classifyFailure(1, {line}), kind);
+}
+
+void RetryPolicyTest::delayStaysBounded() {
+    for (int attempt = 0; attempt < 40; ++attempt) {
+        const qint64 delay = retryDelayMs(FailureKind::RateLimited, attempt);
+        QVERIFY(delay > 0);
+        QVERIFY(delay <= 5 * 60 * 1000);
+    }
+}
+
+QTEST_APPLESS_MAIN(RetryPolicyTest)
+#include "RetryPolicyTest.moc"
@@ -0,0 +1,85 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include "SectionRange.h"
+
+class SectionRangeTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parse_data();
+    void parse();
+    void formatsTimestamps();
+    void buildsSectionArgument();
+    void readsChapters();
+};
+
+void SectionRangeTest::parse_data() {
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<double>("duration");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<double>("start");
+    QTest::addColumn<double>("end");
+
+    QTest::newRow("hours") << QStringLiteral("1:02:00-1:04:30") << 7200.0 << true << 3720.0 << 3870.0;
+    QTest::newRow("open start") << QStringLiteral("-1:00") << 300.0 << true << 0.0 << 60.0;
+    QTest::newRow("open end") << QStringLiteral("4:00-") << 300.0 << true << 240.0 << 300.0;
+    QTest::newRow("open end unknown duration") << QStringLiteral("4:00-") << 0.0 << false << 0.0 << 0.0;
+    QTest::newRow("end clamped") << QStringLiteral("2:00-9:00") << 300.0 << true << 120.0 << 300.0;
+    QTest::newRow("seconds") << QStringLiteral("90-95.5") << 0.0 << true << 90.0 << 95.5;
+    QTest::newRow("reversed") << QStringLiteral("3:00-2:00") << 300.0 << false << 0.0 << 0.0;
+    QTest::newRow("60 seconds") << QStringLiteral("1:60-2:00") << 300.0 << false << 0.0 << 0.0;
+    QTest::newRow("fractional minutes") << QStringLiteral("1.5:00-2:00") << 300.0 << false << 0.0 << 0.0;
+    QTest::newRow("past the end") << QStringLiteral("5:00-6:00") << 200.0 << false << 0.0 << 0.0;
+    QTest::newRow("no dash") << QStringLiteral("abc") << 300.0 << false << 0.0 << 0.0;
+}
+
+void SectionRangeTest::parse() {
+    QFETCH(QString, text);
+    QFETCH(double, duration);
+    QFETCH(bool, valid);
+    QFETCH(double, start);
+    QFETCH(double, end);
+
+    const std::optional<SectionRange> range = parseSectionRange(text, duration);
+    QCOMPARE(range.has_value(), valid);
+    if (range) {
+        QCOMPARE(range->start, start);
+        QCOMPARE(range->end, end);
+    }
+}
+
+void SectionRangeTest::formatsTimestamps() {
+    QCOMPARE(formatTimestamp(3725.5), QStringLiteral("1:02:05.500"));
+    QCOMPARE(formatTimestamp(65), QStringLiteral("1:05"));
+    QCOMPARE(formatTimestamp(-3), QStringLiteral("0:00"));
+    QCOMPARE(parseTimestamp(formatTimestamp(3725.5)).value_or(-1), 3725.5);
+}
+
+void SectionRangeTest::buildsSectionArgument() {
+    SectionRange range;
+    range.start = 1.5;
+    range.end = 10;
+    QCOMPARE(sectionArgument(range), QStringLiteral("*1.500-10.000"));
+    QCOMPARE(formatSectionRange(range), QStringLiteral("0:01.500-0:10"));
+}
+
+void SectionRangeTest::readsChapters() {
+    const QJsonArray chapters{
+        QJsonObject{{QStringLiteral("start_time"), 0}, {QStringLiteral("end_time"), 30}, {QStringLiteral("title"), QStringLiteral("Intro")}},
+        QJsonObject{{QStringLiteral("start_time"), 30}, {QStringLiteral("end_time"), 30}, {QStringLiteral("title"), QStringLiteral("Empty")}},
+        QJsonObject{{QStringLiteral("start_time"), 30}, {QStringLiteral("title"), QStringLiteral("Rest")}},
+    };
+    const QList<SectionRange> ranges = chaptersFromInfo(chapters, 100);
+    QCOMPARE(ranges.size(), 2);
+    QCOMPARE(ranges.at(0).title, QStringLiteral("Intro"));
+    QCOMPARE(ranges.at(0).end, 30.0);
+    QCOMPARE(ranges.at(1).title, QStringLiteral("Rest"));
+    QCOMPARE(ranges.at(1).start, 30.0);
+    QCOMPARE(ranges.at(1).end, 100.0);
+}
+
+QTEST_APPLESS_MAIN(SectionRangeTest)
+#include "SectionRangeTest.moc"
@@ -0,0 +1,191 @@
+#include <QtTest>
+
+#include <QBuffer>
+#include <QImage>
+#include <QNetworkAccessManager>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <algorithm>
+
+#include "ThumbnailLoader.h"
+
+namespace {
+constexpr QSize kTileSize(32, 18);
+}
+
+// Serves one PNG for any path. In hold mode requests stay open until release(), so the test
+// can see how many the loader has in flight and in which order it asked for them.
+class TileServer : public QObject {
+    Q_OBJECT
+
+public:
+    TileServer() {
+        QImage image(320, 180, QImage::Format_RGB32);
+        image.fill(Qt::darkCyan);
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        connect(&server, &QTcpServer::newConnection, this, &TileServer::onNewConnection);
+        server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url(int key) const {
+        return QUrl(QStringLiteral("http://127.0.0.1:%1/%2.png").arg(server.serverPort()).arg(key));
+    }
+
+    void release() {
+        const QList<QTcpSocket *> sockets = pending;
+        pending.clear();
+        for (QTcpSocket *socket : sockets) {
+            reply(socket);
+        }
+    }
+
+    bool hold = true;
+    QStringList requested;
+    int open = 0;
+    int maxOpen = 0;
+    int aborted = 0;
+
+private:
+    void onNewConnection() {
+        while (QTcpSocket *socket = server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                if (pending.removeAll(socket) > 0) {
+                    --open;
+                    ++aborted;
+                }
+                socket->deleteLater();
+            });
+        }
+    }
+
+    void onReadyRead(QTcpSocket *socket) {
+        QByteArray &header = headers[socket];
+        header += socket->readAll();
+        if (!header.contains("\r\n\r\n")) {
+            return;
+        }
+        requested << QString::fromLatin1(header.split(' ').value(1));
+        headers.remove(socket);
+        ++open;
+        maxOpen = std::max(maxOpen, open);
+        pending.append(socket);
+        if (!hold) {
+            release();
+        }
+    }
+
+    void reply(QTcpSocket *socket) {
+        --open;
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: image/png\r\nConnection: close\r\nContent-Length: "
+                      + QByteArray::number(png.size()) + "\r\n\r\n" + png);
+        socket->disconnectFromHost();
+    }
+
+    QByteArray png;
+    QHash<QTcpSocket *, QByteArray> headers;
+    QList<QTcpSocket *> pending;
+    // Last, so its sockets go away while the bookkeeping their handlers touch still exists.
+    QTcpServer server;
+};
+
+class ThumbnailLoaderTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void capsConcurrentRequests();
+    void fetchesInViewportOrder();
+    void abortsRowsScrolledAway();
+    void removeForgetsEntry();
+};
+
+void ThumbnailLoaderTest::capsConcurrentRequests() {
+    TileServer server;
+    QNetworkAccessManager manager;
+    ThumbnailLoader loader(&manager, kTileSize);
+    loader.setMaxConcurrent(2);
+    QList<int> keys;
+    for (int key = 0; key < 8; ++key) {
+        loader.add(key, server.url(key));
+        keys << key;
+    }
+    QSignalSpy ready(&loader, &ThumbnailLoader::tileReady);
+    loader.setVisible(keys);
+
+    QTRY_COMPARE(server.open, 2);
+    QTest::qWait(100);
+    QCOMPARE(server.requested.size(), 2);
+
+    server.hold = false;
+    server.release();
+    QTRY_COMPARE(ready.size(), 8);
+    QCOMPARE(server.maxOpen, 2);
+    const QImage tile = loader.tile(7);
+    QVERIFY(!tile.isNull());
+    QVERIFY(tile.width() <= kTileSize.width() && tile.height() <= kTileSize.height());
+}
+
+void ThumbnailLoaderTest::fetchesInViewportOrder() {
+    TileServer server;
+    server.hold = false;
+    QNetworkAccessManager manager;
+    ThumbnailLoader loader(&manager, kTileSize);
+    loader.setMaxConcurrent(1);
+    for (int key = 0; key < 5; ++key) {
+        loader.add(key, server.url(key));
+    }
+    QSignalSpy ready(&loader, &ThumbnailLoader::tileReady);
+    loader.setVisible({3, 1, 4, 0, 2});
+
+    QTRY_COMPARE(ready.size(), 5);
+    const QStringList expected{QStringLiteral("/3.png"), QStringLiteral("/1.png"), QStringLiteral("/4.png"), QStringLiteral("/0.png"),
+                               QStringLiteral("/2.png")};
+    QCOMPARE(server.requested, expected);
+}
+
+void ThumbnailLoaderTest::abortsRowsScrolledAway() {
+    TileServer server;
+    QNetworkAccessManager manager;
+    ThumbnailLoader loader(&manager, kTileSize);
+    loader.setMaxConcurrent(2);
+    for (int key = 0; key < 10; ++key) {
+        loader.add(key, server.url(key));
+    }
+    QSignalSpy ready(&loader, &ThumbnailLoader::tileReady);
+    loader.setVisible({0, 1, 2, 3});
+    QTRY_COMPARE(server.open, 2);
+
+    loader.setVisible({8, 9});
+    QTRY_COMPARE(server.aborted, 2);
+    QTRY_COMPARE(server.requested.size(), 4);
+    QCOMPARE(server.requested.mid(2), (QStringList{QStringLiteral("/8.png"), QStringLiteral("/9.png")}));
+
+    server.hold = false;
+    server.release();
+    QTRY_COMPARE(ready.size(), 2);
+    QVERIFY(loader.tile(0).isNull());
+    QVERIFY(!loader.tile(8).isNull());
+    QVERIFY(!loader.tile(9).isNull());
+}
+
+void ThumbnailLoaderTest::removeForgetsEntry() {
+    TileServer server;
+    server.hold = false;
+    QNetworkAccessManager manager;
+    ThumbnailLoader loader(&manager, kTileSize);
+    loader.add(1, server.url(1));
+    QSignalSpy ready(&loader, &ThumbnailLoader::tileReady);
+    loader.setVisible({1});
+    QTRY_COMPARE(ready.size(), 1);
+
+    loader.remove(1);
+    QVERIFY(loader.tile(1).isNull());
+    loader.setVisible({1});
+    QTest::qWait(100);
+    QCOMPARE(server.requested.size(), 1);
+}
+
+QTEST_GUILESS_MAIN(ThumbnailLoaderTest)
+#include "ThumbnailLoaderTest.moc"